@@ -1,19 +1,70 @@
-QT       += core gui widgets
+QT       += core gui widgets concurrent
 TARGET = FileMergerApp
 TEMPLATE = app
+CONFIG += c++20 # Coroutines, see src/asynctask.h
 
 SOURCES += \
     src/main.cpp \
     src/mainwindow.cpp \
     src/filemergerlogic.cpp \
     src/customfilemodel.cpp \
-    src/treeitem.cpp
+    src/treeitem.cpp \
+    src/contentsearch.cpp \
+    src/fileclassifier.cpp \
+    src/utf8.cpp \
+    src/trigramindex.cpp \
+    src/selectionprofiles.cpp \
+    src/mergeio.cpp \
+    src/blockcompression.cpp \
+    src/uringreader.cpp \
+    src/sourceencoding.cpp \
+    src/fileidentity.cpp \
+    src/contenthash.cpp \
+    src/mergecheckpoint.cpp \
+    src/mergemanifest.cpp \
+    src/selectionsnapshot.cpp \
+    src/bundleindex.cpp \
+    src/textstats.cpp \
+    src/transformchain.cpp \
+    src/redaction.cpp
 
 HEADERS  += \
     src/mainwindow.h \
     src/filemergerlogic.h \
     src/customfilemodel.h \
-    src/treeitem.h
+    src/treeitem.h \
+    src/contentsearch.h \
+    src/fileclassifier.h \
+    src/utf8.h \
+    src/trigramindex.h \
+    src/selectionprofiles.h \
+    src/mergeio.h \
+    src/blockcompression.h \
+    src/uringreader.h \
+    src/sourceencoding.h \
+    src/fileidentity.h \
+    src/contenthash.h \
+    src/mergecheckpoint.h \
+    src/mergemanifest.h \
+    src/selectionsnapshot.h \
+    src/asynctask.h \
+    src/bundleindex.h \
+    src/textstats.h \
+    src/transformchain.h \
+    src/redaction.h
+
+# Compressed output: zlib is required, zstd is optional and enabled when
+# pkg-config finds libzstd.
+CONFIG += link_pkgconfig
+packagesExist(zlib) {
+    PKGCONFIG += zlib
+} else {
+    LIBS += -lz
+}
+packagesExist(libzstd) {
+    PKGCONFIG += libzstd
+    DEFINES += FILEMERGER_HAVE_ZSTD
+}
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
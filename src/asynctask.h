@@ -0,0 +1,140 @@
+// asynctask.h
+// Coroutine tasks for chaining background steps (C++20).
+
+#ifndef ASYNCTASK_H
+#define ASYNCTASK_H
+
+#include <QThreadPool>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// The result of a coroutine that co_returns a T (not void). Nothing runs
+// until the task is awaited: awaiting it from another coroutine runs it on
+// the awaiting thread, and when it returns the awaiter continues right there
+// with the result moved out of it. A chain of tasks therefore costs neither
+// thread switches nor copies; only co_await resumeOn() moves to another
+// thread. Each task is awaited once.
+template <typename T>
+class Task
+{
+    static_assert(!std::is_void_v<T>, "Task<void> is not supported");
+
+public:
+    struct promise_type {
+        std::optional<T> result;
+        std::coroutine_handle<> continuation; // The awaiting coroutine
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        auto final_suspend() noexcept
+        {
+            struct ContinueAwaiter {
+                bool await_ready() noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+                {
+                    const std::coroutine_handle<> next = handle.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+            return ContinueAwaiter{};
+        }
+        template <typename U>
+        void return_value(U &&value) { result.emplace(std::forward<U>(value)); }
+        void unhandled_exception() { std::terminate(); } // Steps report errors in their result
+    };
+
+    Task(Task &&other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other) {
+            destroy();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    ~Task() { destroy(); }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        handle.promise().continuation = awaiter;
+        return handle; // Starts the task on this thread
+    }
+    T await_resume() { return std::move(*handle.promise().result); }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    void destroy()
+    {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+namespace AsyncTask {
+
+// Awaiter of resumeOn().
+class ResumeOn
+{
+public:
+    explicit ResumeOn(QThreadPool &pool) : pool(pool) {}
+
+    bool await_ready() const noexcept { return currentPool() == &pool; }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        QThreadPool *target = &pool;
+        pool.start([target, handle]() {
+            QThreadPool *const previous = std::exchange(currentPool(), target);
+            handle.resume(); // Up to the next switch or the end
+            currentPool() = previous;
+        });
+    }
+    void await_resume() const noexcept {}
+
+private:
+    static QThreadPool *&currentPool()
+    {
+        thread_local QThreadPool *running = nullptr;
+        return running;
+    }
+
+    QThreadPool &pool;
+};
+
+// co_await resumeOn(pool) continues the coroutine on a thread of pool. On a
+// thread where pool already runs a coroutine it continues without a switch,
+// so every step of a pipeline can ask for the pool and only the first one
+// actually moves.
+inline ResumeOn resumeOn(QThreadPool &pool)
+{
+    return ResumeOn(pool);
+}
+
+// A coroutine that starts at once and frees itself when it ends.
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// Runs task and calls done with its result on the thread that finishes it.
+template <typename T, typename Done>
+Detached start(Task<T> task, Done done)
+{
+    done(co_await std::move(task));
+}
+
+} // namespace AsyncTask
+
+#endif // ASYNCTASK_H
@@ -0,0 +1,108 @@
+// blockcompression.cpp
+
+#include "blockcompression.h"
+#include <QDebug>
+#include <zlib.h>
+
+#ifdef FILEMERGER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace BlockCompression {
+
+namespace {
+
+QByteArray gzipMember(const QByteArray &block, int level)
+{
+    z_stream stream = {};
+    // windowBits 15 + 16 asks deflate for a gzip header and trailer.
+    if (deflateInit2(&stream, level < 0 ? Z_DEFAULT_COMPRESSION : qMin(level, 9), Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        qWarning() << "BlockCompression: deflateInit2 failed";
+        return QByteArray();
+    }
+
+    QByteArray out(qsizetype(deflateBound(&stream, uLong(block.size()))), Qt::Uninitialized);
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(block.constData()));
+    stream.avail_in = uInt(block.size());
+    stream.next_out = reinterpret_cast<Bytef *>(out.data());
+    stream.avail_out = uInt(out.size());
+    const int ret = deflate(&stream, Z_FINISH);
+    const qsizetype written = qsizetype(stream.total_out);
+    deflateEnd(&stream);
+    if (ret != Z_STREAM_END) {
+        qWarning() << "BlockCompression: deflate failed:" << ret;
+        return QByteArray();
+    }
+    out.truncate(written);
+    return out;
+}
+
+#ifdef FILEMERGER_HAVE_ZSTD
+QByteArray zstdFrame(const QByteArray &block, int level)
+{
+    QByteArray out(qsizetype(ZSTD_compressBound(size_t(block.size()))), Qt::Uninitialized);
+    const size_t written = ZSTD_compress(out.data(), size_t(out.size()), block.constData(), size_t(block.size()),
+                                         level < 0 ? ZSTD_CLEVEL_DEFAULT : qMin(level, ZSTD_maxCLevel()));
+    if (ZSTD_isError(written)) {
+        qWarning() << "BlockCompression: ZSTD_compress failed:" << ZSTD_getErrorName(written);
+        return QByteArray();
+    }
+    out.truncate(qsizetype(written));
+    return out;
+}
+#endif
+
+} // namespace
+
+bool isAvailable(OutputCompression compression)
+{
+    switch (compression) {
+    case OutputCompression::None:
+    case OutputCompression::Gzip:
+        return true;
+    case OutputCompression::Zstd:
+#ifdef FILEMERGER_HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+qint64 blockSize(OutputCompression compression)
+{
+    return compression == OutputCompression::Zstd ? ZstdBlockSize : GzipBlockSize;
+}
+
+QString fileSuffix(OutputCompression compression)
+{
+    switch (compression) {
+    case OutputCompression::Gzip:
+        return QStringLiteral(".gz");
+    case OutputCompression::Zstd:
+        return QStringLiteral(".zst");
+    case OutputCompression::None:
+        break;
+    }
+    return QString();
+}
+
+QByteArray compress(const QByteArray &block, OutputCompression compression, int level)
+{
+    switch (compression) {
+    case OutputCompression::Gzip:
+        return gzipMember(block, level);
+    case OutputCompression::Zstd:
+#ifdef FILEMERGER_HAVE_ZSTD
+        return zstdFrame(block, level);
+#else
+        break;
+#endif
+    case OutputCompression::None:
+        return block;
+    }
+    return QByteArray();
+}
+
+} // namespace BlockCompression
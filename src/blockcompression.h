@@ -0,0 +1,34 @@
+// blockcompression.h
+// Independent compression of output blocks, so they can be compressed in parallel.
+
+#ifndef BLOCKCOMPRESSION_H
+#define BLOCKCOMPRESSION_H
+
+#include <QByteArray>
+#include <QString>
+
+enum class OutputCompression {
+    None,
+    Gzip, // zlib; always available
+    Zstd  // Only when built with libzstd (FILEMERGER_HAVE_ZSTD)
+};
+
+namespace BlockCompression {
+
+// Each block becomes a complete gzip member or zstd frame. Both formats allow
+// such units to be concatenated, so the blocks can be compressed on different
+// threads and simply appended to the file in order; gunzip and zstd -d read
+// the result as one stream.
+constexpr qint64 GzipBlockSize = 1024 * 1024;     // deflate's window is only 32 KiB anyway
+constexpr qint64 ZstdBlockSize = 4 * 1024 * 1024; // Larger blocks keep more of zstd's window
+
+bool isAvailable(OutputCompression compression);
+qint64 blockSize(OutputCompression compression);
+QString fileSuffix(OutputCompression compression); // ".gz", ".zst" or empty
+
+// level < 0 picks the library default. Returns an empty array on failure.
+QByteArray compress(const QByteArray &block, OutputCompression compression, int level = -1);
+
+} // namespace BlockCompression
+
+#endif // BLOCKCOMPRESSION_H
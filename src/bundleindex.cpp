@@ -0,0 +1,165 @@
+// bundleindex.cpp
+
+#include "bundleindex.h"
+#include "contenthash.h"
+#include <QCoreApplication> // For tr
+#include <QFileInfo>
+
+namespace {
+
+const QByteArray IndexHeading("\n========== FILEMERGER INDEX ==========\n");
+const QByteArray TrailerMagic("FMIDX1 ");
+
+// Only what would break the line format is escaped; decoded with fromPercentEncoding().
+QByteArray encodePath(const QString &path)
+{
+    QByteArray encoded;
+    const QByteArray utf8 = path.toUtf8();
+    encoded.reserve(utf8.size());
+    for (char c : utf8) {
+        switch (c) {
+        case '%':  encoded += "%25"; break;
+        case '\t': encoded += "%09"; break;
+        case '\n': encoded += "%0A"; break;
+        case '\r': encoded += "%0D"; break;
+        default:   encoded += c; break;
+        }
+    }
+    return encoded;
+}
+
+} // namespace
+
+namespace BundleIndex {
+
+QByteArray serialize(const QList<Entry> &entries, qint64 indexOffset)
+{
+    QByteArray footer = IndexHeading;
+    for (const Entry &entry : entries) {
+        footer += QByteArray::number(entry.offset) + '\t' + QByteArray::number(entry.length) + '\t'
+                + QByteArray::number(entry.hash, 16) + '\t' + encodePath(entry.path) + '\n';
+    }
+    const qint64 indexLength = footer.size();
+    footer += TrailerMagic + QByteArray::number(indexOffset, 16).rightJustified(16, '0') + ' '
+            + QByteArray::number(indexLength, 16).rightJustified(16, '0') + '\n';
+    return footer;
+}
+
+} // namespace BundleIndex
+
+// --- BundleReader Implementation ---
+bool BundleReader::open(const QString &path)
+{
+    sections.clear();
+    indexByPath.clear();
+    file.close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        lastError = file.errorString();
+        return false;
+    }
+
+    const QString noIndex = QCoreApplication::tr("文件没有索引尾部。 (The file has no index footer.)");
+    const qint64 size = file.size();
+    if (size < BundleIndex::TrailerSize || !file.seek(size - BundleIndex::TrailerSize)) {
+        lastError = noIndex;
+        return false;
+    }
+    const QByteArray trailer = file.read(BundleIndex::TrailerSize);
+    bool offsetOk = false;
+    bool lengthOk = false;
+    const qint64 indexOffset = trailer.mid(7, 16).toLongLong(&offsetOk, 16);
+    const qint64 indexLength = trailer.mid(24, 16).toLongLong(&lengthOk, 16);
+    if (!trailer.startsWith(TrailerMagic) || !offsetOk || !lengthOk || indexOffset < 0 || indexLength < 0
+        || indexOffset + indexLength != size - BundleIndex::TrailerSize || !file.seek(indexOffset)) {
+        lastError = noIndex;
+        return false;
+    }
+    const QByteArray index = file.read(indexLength);
+    if (!index.startsWith(IndexHeading) || !parseIndex(index.mid(IndexHeading.size()))) {
+        lastError = QCoreApplication::tr("索引已损坏。 (The index is damaged.)");
+        return false;
+    }
+    // Sections must lie in front of the index.
+    for (const BundleIndex::Entry &entry : sections) {
+        if (entry.offset < 0 || entry.length < 0 || entry.offset + entry.length > indexOffset) {
+            lastError = QCoreApplication::tr("索引已损坏。 (The index is damaged.)");
+            sections.clear();
+            indexByPath.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BundleReader::parseIndex(const QByteArray &index)
+{
+    const QList<QByteArray> lines = index.split('\n');
+    for (const QByteArray &line : lines) {
+        if (line.isEmpty()) {
+            continue; // After the last newline
+        }
+        const QList<QByteArray> fields = line.split('\t');
+        if (fields.count() != 4) {
+            return false;
+        }
+        BundleIndex::Entry entry;
+        bool ok[3] = {false, false, false};
+        entry.offset = fields.at(0).toLongLong(&ok[0]);
+        entry.length = fields.at(1).toLongLong(&ok[1]);
+        entry.hash = fields.at(2).toULongLong(&ok[2], 16);
+        entry.path = QString::fromUtf8(QByteArray::fromPercentEncoding(fields.at(3)));
+        if (!ok[0] || !ok[1] || !ok[2]) {
+            return false;
+        }
+        indexByPath.insert(entry.path, sections.size());
+        sections.append(entry);
+    }
+    return true;
+}
+
+const QList<BundleIndex::Entry> &BundleReader::entries() const
+{
+    return sections;
+}
+
+const BundleIndex::Entry *BundleReader::find(const QString &pathOrName) const
+{
+    const auto it = indexByPath.constFind(pathOrName);
+    if (it != indexByPath.constEnd()) {
+        return &sections.at(it.value());
+    }
+    const BundleIndex::Entry *match = nullptr;
+    for (const BundleIndex::Entry &entry : sections) {
+        if (QFileInfo(entry.path).fileName() == pathOrName) {
+            if (match) {
+                return nullptr; // Ambiguous
+            }
+            match = &entry;
+        }
+    }
+    return match;
+}
+
+bool BundleReader::extract(const BundleIndex::Entry &entry, QByteArray *content)
+{
+    if (!file.seek(entry.offset)) {
+        lastError = file.errorString();
+        return false;
+    }
+    *content = file.read(entry.length);
+    if (content->size() != entry.length) {
+        lastError = QCoreApplication::tr("文件被截断。 (The file is truncated.)");
+        return false;
+    }
+    if (ContentHash::xxh64(content->constData(), content->size()) != entry.hash) {
+        lastError = QCoreApplication::tr("校验和不匹配: (Checksum mismatch:) ") + entry.path;
+        return false;
+    }
+    return true;
+}
+
+QString BundleReader::errorString() const
+{
+    return lastError;
+}
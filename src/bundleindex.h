@@ -0,0 +1,64 @@
+// bundleindex.h
+// Index footer of a merged output, and random access to its sections.
+
+#ifndef BUNDLEINDEX_H
+#define BUNDLEINDEX_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+// With MergeOptions::indexFooter the output ends in
+//
+//   \n========== FILEMERGER INDEX ==========\n
+//   <offset>\t<length>\t<xxh64>\t<path>\n        one line per source
+//   FMIDX1 <index offset> <index length>\n       fixed-size trailer
+//
+// Offsets and lengths are decimal and address the content of each section
+// (the header is not included). The hash is XXH64 of exactly those bytes, in
+// hex. Paths are absolute, with '%', tab, CR and LF percent-encoded. The
+// trailer numbers are 16 hex digits each, so a reader finds the index with
+// one seek from the end of the file.
+namespace BundleIndex {
+
+struct Entry {
+    QString path;
+    qint64 offset = 0;
+    qint64 length = 0;
+    quint64 hash = 0;
+};
+
+constexpr qint64 TrailerSize = 41; // "FMIDX1 " + 16 + " " + 16 + "\n"
+
+// The footer to append when indexOffset bytes have been written.
+QByteArray serialize(const QList<Entry> &entries, qint64 indexOffset);
+
+} // namespace BundleIndex
+
+// Lists and extracts sections of a merged output through its index footer,
+// without scanning the sections themselves.
+class BundleReader
+{
+public:
+    bool open(const QString &path);
+
+    const QList<BundleIndex::Entry> &entries() const;
+    // By full path, or by file name when exactly one section has that name.
+    const BundleIndex::Entry *find(const QString &pathOrName) const;
+    // Reads a section and checks it against its hash.
+    bool extract(const BundleIndex::Entry &entry, QByteArray *content);
+
+    QString errorString() const;
+
+private:
+    bool parseIndex(const QByteArray &index);
+
+    QFile file;
+    QList<BundleIndex::Entry> sections;
+    QHash<QString, qsizetype> indexByPath;
+    QString lastError;
+};
+
+#endif // BUNDLEINDEX_H
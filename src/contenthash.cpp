@@ -0,0 +1,274 @@
+// contenthash.cpp
+
+#include "contenthash.h"
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <QDebug>
+#include <cstring> // For memcpy
+
+namespace ContentHash {
+
+namespace {
+
+constexpr quint64 Prime1 = 0x9E3779B185EBCA87ULL;
+constexpr quint64 Prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr quint64 Prime3 = 0x165667B19E3779F9ULL;
+constexpr quint64 Prime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr quint64 Prime5 = 0x27D4EB2F165667C5ULL;
+
+inline quint64 rotl(quint64 x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline quint64 read64(const uchar *p)
+{
+    quint64 v;
+    std::memcpy(&v, p, sizeof(v));
+    return qFromLittleEndian(v);
+}
+
+inline quint32 read32(const uchar *p)
+{
+    quint32 v;
+    std::memcpy(&v, p, sizeof(v));
+    return qFromLittleEndian(v);
+}
+
+inline quint64 round(quint64 acc, quint64 input)
+{
+    acc += input * Prime2;
+    acc = rotl(acc, 31);
+    return acc * Prime1;
+}
+
+inline quint64 mergeRound(quint64 acc, quint64 value)
+{
+    acc ^= round(0, value);
+    return acc * Prime1 + Prime4;
+}
+
+// Mixes in the last (size % 32) bytes and applies the final avalanche.
+quint64 finalize(quint64 h, const uchar *p, const uchar *end)
+{
+    for (; end - p >= 8; p += 8) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * Prime1 + Prime4;
+    }
+    if (end - p >= 4) {
+        h ^= quint64(read32(p)) * Prime1;
+        h = rotl(h, 23) * Prime2 + Prime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= quint64(*p) * Prime5;
+        h = rotl(h, 11) * Prime1;
+    }
+
+    // Final avalanche
+    h ^= h >> 33;
+    h *= Prime2;
+    h ^= h >> 29;
+    h *= Prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+// --- Cache ---
+constexpr quint32 CacheMagic = 0x464d4843; // "FMHC"
+constexpr quint32 CacheVersion = 1;
+constexpr qsizetype MaxCacheEntries = 1000000; // Start over rather than grow without bound
+
+QMutex cacheMutex;
+QHash<FileIdentity, quint64> hashCache;
+bool cacheLoaded = false;
+bool cacheDirty = false;
+
+QString cacheFilePath()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("content-hashes.bin");
+}
+
+// Called with cacheMutex held.
+void loadCacheLocked()
+{
+    if (cacheLoaded)
+        return;
+    cacheLoaded = true;
+
+    QFile file(cacheFilePath());
+    if (!file.open(QIODevice::ReadOnly))
+        return; // No cache yet
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    in >> magic >> version >> count;
+    if (magic != CacheMagic || version != CacheVersion || count > quint32(MaxCacheEntries)) {
+        qWarning() << "ContentHash: ignoring unrecognized cache file" << file.fileName();
+        return;
+    }
+    hashCache.reserve(count);
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        FileIdentity identity;
+        quint64 hash = 0;
+        in >> identity.device >> identity.inode >> identity.size >> identity.lastModified >> hash;
+        hashCache.insert(identity, hash);
+    }
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "ContentHash: cache file is truncated, starting over";
+        hashCache.clear();
+    }
+}
+
+} // namespace
+
+quint64 xxh64(const void *data, qint64 size, quint64 seed)
+{
+    const uchar *p = static_cast<const uchar *>(data);
+    const uchar *end = p + size;
+    quint64 h;
+
+    if (size >= 32) {
+        // Four independent lanes over 32-byte stripes.
+        quint64 v1 = seed + Prime1 + Prime2;
+        quint64 v2 = seed + Prime2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - Prime1;
+        const uchar *limit = end - 32;
+        do {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + Prime5;
+    }
+    h += quint64(size);
+    return finalize(h, p, end);
+}
+
+Xxh64::Xxh64(quint64 seed)
+    : seed(seed)
+{
+    lanes[0] = seed + Prime1 + Prime2;
+    lanes[1] = seed + Prime2;
+    lanes[2] = seed;
+    lanes[3] = seed - Prime1;
+}
+
+void Xxh64::add(const void *data, qint64 size)
+{
+    const uchar *p = static_cast<const uchar *>(data);
+    const uchar *end = p + size;
+    total += quint64(size);
+
+    if (buffered + size < 32) {
+        std::memcpy(buffer + buffered, p, size_t(size));
+        buffered += int(size);
+        return;
+    }
+    if (buffered > 0) {
+        const int fill = 32 - buffered;
+        std::memcpy(buffer + buffered, p, size_t(fill));
+        for (int lane = 0; lane < 4; ++lane)
+            lanes[lane] = round(lanes[lane], read64(buffer + lane * 8));
+        p += fill;
+        buffered = 0;
+    }
+    for (; end - p >= 32; p += 32) {
+        lanes[0] = round(lanes[0], read64(p));
+        lanes[1] = round(lanes[1], read64(p + 8));
+        lanes[2] = round(lanes[2], read64(p + 16));
+        lanes[3] = round(lanes[3], read64(p + 24));
+    }
+    buffered = int(end - p);
+    std::memcpy(buffer, p, size_t(buffered));
+}
+
+quint64 Xxh64::digest() const
+{
+    quint64 h;
+    if (total >= 32) {
+        h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+        for (quint64 lane : lanes)
+            h = mergeRound(h, lane);
+    } else {
+        h = seed + Prime5;
+    }
+    h += total;
+    return finalize(h, buffer, buffer + buffered);
+}
+
+bool cachedHash(const FileIdentity &identity, quint64 *hash)
+{
+    QMutexLocker locker(&cacheMutex);
+    loadCacheLocked();
+    const auto it = hashCache.constFind(identity);
+    if (it == hashCache.constEnd())
+        return false;
+    *hash = it.value();
+    return true;
+}
+
+void storeHash(const FileIdentity &identity, quint64 hash)
+{
+    QMutexLocker locker(&cacheMutex);
+    loadCacheLocked();
+    if (hashCache.size() >= MaxCacheEntries)
+        hashCache.clear();
+    hashCache.insert(identity, hash);
+    cacheDirty = true;
+}
+
+bool saveCache()
+{
+    QMutexLocker locker(&cacheMutex);
+    if (!cacheDirty)
+        return true;
+
+    const QString path = cacheFilePath();
+    QDir().mkpath(QFileInfo(path).path());
+    QSaveFile file(path); // Replaced atomically, so a crash never leaves half a cache
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "ContentHash: could not write cache" << path << file.errorString();
+        return false;
+    }
+    QDataStream out(&file);
+    out << CacheMagic << CacheVersion << quint32(hashCache.size());
+    for (auto it = hashCache.constBegin(); it != hashCache.constEnd(); ++it) {
+        const FileIdentity &identity = it.key();
+        out << identity.device << identity.inode << identity.size << identity.lastModified << it.value();
+    }
+    if (!file.commit()) {
+        qWarning() << "ContentHash: could not write cache" << path << file.errorString();
+        return false;
+    }
+    cacheDirty = false;
+    return true;
+}
+
+void clearCache()
+{
+    QMutexLocker locker(&cacheMutex);
+    hashCache.clear();
+    cacheLoaded = true;
+    cacheDirty = false;
+    QFile::remove(cacheFilePath());
+}
+
+} // namespace ContentHash
@@ -0,0 +1,44 @@
+// contenthash.h
+// Fast content hashing of merge sources, with a persistent per-file cache.
+
+#ifndef CONTENTHASH_H
+#define CONTENTHASH_H
+
+#include <QtGlobal>
+#include "fileidentity.h"
+
+namespace ContentHash {
+
+// XXH64 (https://github.com/Cyan4973/xxHash), a non-cryptographic 64-bit hash
+// running at several GB/s; enough to tell duplicate files apart, not to
+// defend against crafted collisions.
+quint64 xxh64(const void *data, qint64 size, quint64 seed = 0);
+
+// Incremental form of xxh64() for data that arrives in pieces; digest()
+// equals xxh64() over the concatenation of everything added so far.
+class Xxh64
+{
+public:
+    explicit Xxh64(quint64 seed = 0);
+    void add(const void *data, qint64 size);
+    quint64 digest() const;
+
+private:
+    quint64 lanes[4];
+    quint64 seed;
+    quint64 total = 0;
+    uchar buffer[32];
+    int buffered = 0;
+};
+
+// Process-wide cache of content hashes keyed by file identity. It is loaded
+// from the user's cache directory on first use and written back by
+// saveCache(), so later merges of unchanged files need not read them at all.
+bool cachedHash(const FileIdentity &identity, quint64 *hash);
+void storeHash(const FileIdentity &identity, quint64 hash);
+bool saveCache();
+void clearCache(); // In memory and on disk
+
+} // namespace ContentHash
+
+#endif // CONTENTHASH_H
@@ -0,0 +1,125 @@
+// contentsearch.cpp
+
+#include "contentsearch.h"
+#include <QFile>
+#include <QDebug>
+#include <QtAlgorithms> // For qCountTrailingZeroBits
+#include <cstring>      // For memchr, memcmp
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CONTENTSEARCH_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace ContentSearch {
+
+qsizetype find(const char *haystack, qsizetype haystackSize, const char *needle, qsizetype needleSize)
+{
+    if (needleSize <= 0)
+        return 0;
+    if (needleSize > haystackSize)
+        return -1;
+    if (needleSize == 1) {
+        const void *hit = std::memchr(haystack, needle[0], size_t(haystackSize));
+        return hit ? static_cast<const char *>(hit) - haystack : -1;
+    }
+
+    const qsizetype lastStart = haystackSize - needleSize; // Last offset a match can start at
+    qsizetype i = 0;
+
+#ifdef CONTENTSEARCH_HAVE_SSE2
+    // Compare 16 candidate start positions at once against the first and the
+    // last byte of the needle; only positions where both agree get a memcmp.
+    const __m128i firstByte = _mm_set1_epi8(needle[0]);
+    const __m128i lastByte = _mm_set1_epi8(needle[needleSize - 1]);
+    for (; i + 16 <= lastStart + 1; i += 16) {
+        const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(haystack + i));
+        const __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i *>(haystack + i + needleSize - 1));
+        const __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(firstByte, blockFirst), _mm_cmpeq_epi8(lastByte, blockLast));
+        quint32 mask = quint32(_mm_movemask_epi8(eq));
+        while (mask) {
+            const int bit = qCountTrailingZeroBits(mask);
+            if (std::memcmp(haystack + i + bit + 1, needle + 1, size_t(needleSize - 2)) == 0)
+                return i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    // Scalar path for the tail (or the whole buffer without SSE2).
+    while (i <= lastStart) {
+        const void *hit = std::memchr(haystack + i, needle[0], size_t(lastStart - i + 1));
+        if (!hit)
+            return -1;
+        i = static_cast<const char *>(hit) - haystack;
+        if (std::memcmp(haystack + i + 1, needle + 1, size_t(needleSize - 1)) == 0)
+            return i;
+        ++i;
+    }
+    return -1;
+}
+
+bool containsAny(const char *data, qsizetype size, const QList<QByteArray> &patterns)
+{
+    for (const QByteArray &pattern : patterns) {
+        if (!pattern.isEmpty() && find(data, size, pattern.constData(), pattern.size()) >= 0)
+            return true;
+    }
+    return false;
+}
+
+bool fileContainsAny(const QString &path, const QList<QByteArray> &patterns, const std::atomic_bool *cancelled)
+{
+    qsizetype longestPattern = 0;
+    for (const QByteArray &pattern : patterns)
+        longestPattern = qMax(longestPattern, pattern.size());
+    if (longestPattern == 0)
+        return false;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "ContentSearch: could not open" << path << file.errorString();
+        return false;
+    }
+
+    const qint64 fileSize = file.size();
+    const char *data = nullptr;
+    uchar *mapped = nullptr;
+    if (fileSize >= MapThreshold)
+        mapped = file.map(0, fileSize);
+
+    // Small files (and large ones that cannot be mapped) are read into a
+    // per-thread buffer that is reused across files.
+    thread_local QByteArray readBuffer;
+    if (mapped) {
+        data = reinterpret_cast<const char *>(mapped);
+    } else {
+        if (readBuffer.size() < fileSize)
+            readBuffer.resize(fileSize);
+        const qint64 bytesRead = file.read(readBuffer.data(), fileSize);
+        if (bytesRead != fileSize) {
+            qWarning() << "ContentSearch: short read on" << path;
+            return false;
+        }
+        data = readBuffer.constData();
+    }
+
+    // Scan window by window, overlapping by longestPattern - 1 bytes so no
+    // match straddling a window boundary is lost.
+    bool found = false;
+    for (qint64 offset = 0; offset < fileSize; offset += WindowSize) {
+        if (cancelled && cancelled->load(std::memory_order_relaxed))
+            break;
+        const qint64 windowEnd = qMin(fileSize, offset + WindowSize + longestPattern - 1);
+        if (containsAny(data + offset, windowEnd - offset, patterns)) {
+            found = true;
+            break;
+        }
+    }
+
+    if (mapped)
+        file.unmap(mapped);
+    return found;
+}
+
+} // namespace ContentSearch
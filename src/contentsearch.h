@@ -0,0 +1,35 @@
+// contentsearch.h
+// Byte-level literal search used by content-based selection.
+
+#ifndef CONTENTSEARCH_H
+#define CONTENTSEARCH_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <atomic>
+
+namespace ContentSearch {
+
+// Files at least this large are memory-mapped instead of read into a buffer.
+constexpr qint64 MapThreshold = 1024 * 1024;
+
+// Size of the window scanned per pattern before moving on, so that several
+// literals are matched against cache-resident data instead of re-streaming
+// the whole file once per literal.
+constexpr qsizetype WindowSize = 256 * 1024;
+
+// Returns the offset of the first occurrence of needle in haystack, or -1.
+// Uses an SSE2 first/last-byte filter where available.
+qsizetype find(const char *haystack, qsizetype haystackSize, const char *needle, qsizetype needleSize);
+
+// True if any of the patterns occurs in the buffer.
+bool containsAny(const char *data, qsizetype size, const QList<QByteArray> &patterns);
+
+// True if any of the patterns occurs in the file at path. Stops at the first
+// match and gives up early (returning false) once cancelled is set.
+bool fileContainsAny(const QString &path, const QList<QByteArray> &patterns, const std::atomic_bool *cancelled = nullptr);
+
+} // namespace ContentSearch
+
+#endif // CONTENTSEARCH_H
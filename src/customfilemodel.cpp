@@ -4,18 +4,41 @@
 #include <QDir>
 #include <QDebug>
 #include <functional>   // Required for std::function
+#include <limits>
 #include <QDirIterator>
 #include <QMimeDatabase>
 #include <QMimeType>
+#include <QMap>
+#include <QSet>
+#include <QBitArray>
+#include <QRegularExpression>
+#include <QtConcurrent>
+#include "contentsearch.h"
+#include "fileclassifier.h"
 
 CustomFileModel::CustomFileModel(const QString &rootPath, QObject *parent)
-    : QAbstractItemModel(parent)
+    : QAbstractItemModel(parent), modelRootPath(QDir::cleanPath(rootPath)), skipBinaries(false)
 {
     // The rootItem in QAbstractItemModel is conceptual (QModelIndex()).
     // We create our own TreeItem that acts as the invisible root for our data.
     // The actual displayed root items will be children of this conceptual rootItem.
     rootItem = new TreeItem(QStringLiteral("__InvisibleRoot__"), TreeItem::Folder, nullptr); // Use new constructor
     setupModelData(rootPath, rootItem);
+    checkedIds.resize(allItems.size());
+    pathTable.reserve(allItems.size());
+    sizeTable.reserve(allItems.size());
+    for (const TreeItem *item : std::as_const(allItems)) {
+        const bool isFile = item->type() == TreeItem::File;
+        pathTable.append(isFile ? item->path() : QString()); // Shares the item's string
+        sizeTable.append(isFile ? item->size() : 0);
+    }
+
+    connect(&contentSearchWatcher, &QFutureWatcherBase::progressValueChanged, this, [this](int scanned) {
+        emit contentSelectionProgress(scanned, contentSearchCandidates.size());
+    });
+    connect(&contentSearchWatcher, &QFutureWatcherBase::finished, this, &CustomFileModel::handleContentSelectionFinished);
+    connect(&classificationWatcher, &QFutureWatcherBase::finished, this, &CustomFileModel::handleContentClassificationFinished);
+    connect(&textStatsWatcher, &QFutureWatcherBase::finished, this, &CustomFileModel::handleTextStatisticsFinished);
 
     // Example: Filter for specific file types - adjust as needed
     // nameFilters << "*.txt" << "*.log"; // If you want to filter
@@ -24,6 +47,19 @@ CustomFileModel::CustomFileModel(const QString &rootPath, QObject *parent)
 
 CustomFileModel::~CustomFileModel()
 {
+    // A running content scan holds pointers into the tree; stop it first.
+    if (isContentSelectionRunning()) {
+        cancelContentSelection();
+        contentSearchWatcher.waitForFinished();
+    }
+    if (isContentClassificationRunning()) {
+        classificationWatcher.cancel();
+        classificationWatcher.waitForFinished();
+    }
+    if (isTextStatisticsRunning()) {
+        textStatsWatcher.cancel();
+        textStatsWatcher.waitForFinished();
+    }
     delete rootItem;
 }
 
@@ -50,7 +86,7 @@ QModelIndex CustomFileModel::index(int row, int column, const QModelIndex &paren
     else
         parentItem = static_cast<TreeItem*>(parent.internalPointer());
 
-    TreeItem *childItem = parentItem->child(row);
+    TreeItem *childItem = visibleChild(parentItem, row);
     if (childItem)
         return createIndex(row, column, childItem); // Create a QModelIndex for this child.
     return QModelIndex();
@@ -71,7 +107,7 @@ QModelIndex CustomFileModel::parent(const QModelIndex &index) const
 
     // Otherwise, create a QModelIndex for the parent.
     // The row of the parent is its position in its own parent's child list.
-    return createIndex(parentItem->row(), 0, parentItem);
+    return createIndex(visibleRow(parentItem), 0, parentItem);
 }
 
 int CustomFileModel::rowCount(const QModelIndex &parent) const
@@ -85,7 +121,7 @@ int CustomFileModel::rowCount(const QModelIndex &parent) const
     else
         parentItem = static_cast<TreeItem*>(parent.internalPointer());
 
-    return parentItem->childCount();
+    return visibleChildCount(parentItem);
 }
 
 int CustomFileModel::columnCount(const QModelIndex &parent) const
@@ -114,6 +150,18 @@ QVariant CustomFileModel::data(const QModelIndex &index, int role) const
         return item->path(); // Show full path as tooltip
     }
 
+    if (role == FileSizeRole && item->type() == TreeItem::File) {
+        return item->size();
+    }
+
+    if (role == LastModifiedRole && item->type() == TreeItem::File) {
+        return QDateTime::fromMSecsSinceEpoch(item->lastModified());
+    }
+
+    if (role == ContentKindRole && item->type() == TreeItem::File) {
+        return static_cast<int>(item->contentKind());
+    }
+
     return QVariant();
 }
 
@@ -157,7 +205,7 @@ bool CustomFileModel::setData(const QModelIndex &index, const QVariant &value, i
         // we might need to propagate to children if their states are inconsistent.
 
         if (item->type() == TreeItem::File) {
-            item->setCheckState(newState);
+            setItemCheckState(item, newState);
             emit dataChanged(index, index, {Qt::CheckStateRole});
             updateFolderCheckState(parent(index)); // Update parent folder state
             return true;
@@ -192,8 +240,14 @@ bool CustomFileModel::setData(const QModelIndex &index, const QVariant &value, i
             // After propagation, the folder's own state should align with what was set (Checked or Unchecked)
             // because all children were forced to that state.
             // If `newState` was `Qt::PartiallyChecked` and we made it `Qt::Checked`, this ensures consistency.
-            if (item->checkState() != targetChildState) {
-                 item->setCheckState(targetChildState); // Ensure it's not left partially checked from this operation
+            // Skipped binaries and children hidden by the name filter keep their
+            // state, so the folder may end up partial.
+            Qt::CheckState finalState = targetChildState;
+            if (propagationMayBeIncomplete(targetChildState) && item->childCount() > 0) {
+                finalState = folderStateFromChildren(item);
+            }
+            if (item->checkState() != finalState) {
+                 item->setCheckState(finalState); // Ensure it's not left partially checked from this operation
                  emit dataChanged(index, index, {Qt::CheckStateRole}); // Emit again if it changed from initial set
             }
 
@@ -231,6 +285,7 @@ void CustomFileModel::setupModelData(const QString &currentPath, TreeItem *paren
             TreeItem *folderItem = new TreeItem(entryInfo.fileName(), TreeItem::Folder, parent);
             folderItem->setPath(entryInfo.filePath());
             parent->appendChild(folderItem);
+            registerItem(folderItem);
             setupModelData(entryInfo.filePath(), folderItem); // Recurse into subdirectory
         } else if (entryInfo.isFile()) {
             // Apply name filters if they are set
@@ -250,7 +305,12 @@ void CustomFileModel::setupModelData(const QString &currentPath, TreeItem *paren
             if (passesFilter) {
                 TreeItem *fileItem = new TreeItem(entryInfo.fileName(), TreeItem::File, parent);
                 fileItem->setPath(entryInfo.filePath());
+                // entryInfoList() already stat'ed the entry; keep what it found so
+                // predicate queries never have to touch the file system again.
+                fileItem->setSize(entryInfo.size());
+                fileItem->setLastModified(entryInfo.lastModified().toMSecsSinceEpoch());
                 parent->appendChild(fileItem);
+                registerItem(fileItem);
             }
         }
     }
@@ -283,12 +343,25 @@ void CustomFileModel::toggleCheckState(const QModelIndex &index) {
 }
 
 void CustomFileModel::setAllCheckStates(Qt::CheckState state) {
+    if (isFiltered()) {
+        // Select/deselect all only touches what the name filter shows.
+        QList<TreeItem*> visibleFiles;
+        collectFilesRecursive(rootItem, visibleFiles);
+        applyFileCheckStates(visibleFiles, state);
+        return;
+    }
+
     beginResetModel();
-    for (int i = 0; i < rootItem->childCount(); ++i) {
-        setAllCheckStatesRecursiveInternal(rootItem->child(i), state);
+    if (state == Qt::Checked && skipBinaries) {
+        checkAllSkippingBinariesRecursive(rootItem);
+    } else {
+        for (int i = 0; i < rootItem->childCount(); ++i) {
+            setAllCheckStatesRecursiveInternal(rootItem->child(i), state);
+        }
     }
     // After setting all children, folder states are implicitly defined by their children.
     // No need to call updateFolderCheckState explicitly here as begin/endResetModel forces view refresh.
+    recomputeTotals(); // The recursive helper bypasses setItemCheckState()
     endResetModel();
 }
 
@@ -319,20 +392,45 @@ void CustomFileModel::setAllCheckStates(Qt::CheckState state) {
 // It seems `setAllCheckStates` is the main entry point and now uses `setAllCheckStatesRecursiveInternal`.
 
 
+// Select-all while binaries are skipped: binaries keep their state and each
+// folder's state is derived from its children instead of being forced.
+void CustomFileModel::checkAllSkippingBinariesRecursive(TreeItem *item) {
+    for (int i = 0; i < item->childCount(); ++i) {
+        TreeItem *child = item->child(i);
+        if (child->type() == TreeItem::File) {
+            if (!isSkippedBinary(child)) {
+                setItemCheckState(child, Qt::Checked);
+            }
+        } else {
+            checkAllSkippingBinariesRecursive(child);
+            child->setCheckState(child->childCount() > 0 ? folderStateFromChildren(child) : Qt::Checked);
+        }
+    }
+}
+
 QStringList CustomFileModel::getCheckedFilesPaths() const {
     QStringList paths;
     getCheckedFilesRecursive(rootItem, paths);
     return paths;
 }
 
-void CustomFileModel::getCheckedFilesRecursive(TreeItem *item, QStringList &paths) const {
+QStringList CustomFileModel::getCheckedFilesPaths(QList<qint64> *sizes) const {
+    QStringList paths;
+    getCheckedFilesRecursive(rootItem, paths, sizes);
+    return paths;
+}
+
+void CustomFileModel::getCheckedFilesRecursive(TreeItem *item, QStringList &paths, QList<qint64> *sizes) const {
     for (int i = 0; i < item->childCount(); ++i) {
         TreeItem *child = item->child(i);
         if (child->type() == TreeItem::File && child->checkState() == Qt::Checked) {
             paths.append(child->path());
+            if (sizes) {
+                sizes->append(child->size());
+            }
         }
         if (child->childCount() > 0) { // Recurse for folders
-            getCheckedFilesRecursive(child, paths);
+            getCheckedFilesRecursive(child, paths, sizes);
         }
     }
 }
@@ -365,60 +463,7 @@ void CustomFileModel::updateFolderCheckState(const QModelIndex &folderIndex)
         return;
     }
 
-    int childrenCheckedCount = 0;
-    int childrenUncheckedCount = 0;
-    int childrenPartialCount = 0;
-    int relevantChildCount = 0; // Count of files and sub-folders
-
-    for (int i = 0; i < folderItem->childCount(); ++i) {
-        TreeItem *childItem = folderItem->child(i);
-        if (!childItem) continue;
-
-        relevantChildCount++; // All children (files or folders) are relevant for parent state
-
-        if (childItem->type() == TreeItem::File) {
-            if (childItem->checkState() == Qt::Checked) {
-                childrenCheckedCount++;
-            } else { // Qt::Unchecked (files are not tristate)
-                childrenUncheckedCount++;
-            }
-        } else if (childItem->type() == TreeItem::Folder) {
-            Qt::CheckState childFolderState = childItem->checkState();
-            if (childFolderState == Qt::Checked) {
-                childrenCheckedCount++;
-            } else if (childFolderState == Qt::PartiallyChecked) {
-                childrenPartialCount++;
-            } else { // Qt::Unchecked
-                childrenUncheckedCount++;
-            }
-        }
-    }
-
-    Qt::CheckState newState;
-    if (relevantChildCount == 0) {
-        newState = Qt::Unchecked; // Or Qt::Checked, depending on desired default for empty folders
-    } else if (childrenPartialCount > 0) {
-        newState = Qt::PartiallyChecked;
-    } else if (childrenCheckedCount > 0 && childrenUncheckedCount > 0) {
-        newState = Qt::PartiallyChecked;
-    } else if (childrenCheckedCount == relevantChildCount) {
-        newState = Qt::Checked;
-    } else if (childrenUncheckedCount == relevantChildCount) {
-        newState = Qt::Unchecked;
-    } else {
-        // This case should ideally not be reached if logic is correct
-        // For example, if some children are checked and some are partial, it's partial.
-        // If all are checked, it's checked. If all are unchecked, it's unchecked.
-        // If a mix of checked and unchecked, it's partial.
-        // The conditions above should cover these.
-        // Defaulting to PartiallyChecked as a fallback if something is missed.
-        newState = Qt::PartiallyChecked;
-         qWarning() << "updateFolderCheckState: Unhandled state combination for folder" << folderItem->name()
-                   << "Checked:" << childrenCheckedCount
-                   << "Unchecked:" << childrenUncheckedCount
-                   << "Partial:" << childrenPartialCount
-                   << "TotalRelevant:" << relevantChildCount;
-    }
+    Qt::CheckState newState = folderStateFromChildren(folderItem);
 
     if (folderItem->checkState() != newState) {
         folderItem->setCheckState(newState);
@@ -442,8 +487,8 @@ void CustomFileModel::propagateFolderStateToChildren(TreeItem *folderItem, Qt::C
     childStateToSet = (state == Qt::Checked) ? Qt::Checked : Qt::Unchecked;
 
 
-    for (int i = 0; i < folderItem->childCount(); ++i) {
-        TreeItem* childItem = folderItem->child(i);
+    for (int i = 0; i < visibleChildCount(folderItem); ++i) {
+        TreeItem* childItem = visibleChild(folderItem, i);
         if (!childItem) continue;
 
         QModelIndex childIndex = index(i, 0, parentFolderIndex);
@@ -452,14 +497,26 @@ void CustomFileModel::propagateFolderStateToChildren(TreeItem *folderItem, Qt::C
             continue;
         }
 
+        if (childStateToSet == Qt::Checked && isSkippedBinary(childItem)) {
+            continue; // Checking a folder does not pull in binaries while skipping is on
+        }
+
         if (childItem->checkState() != childStateToSet) {
-            childItem->setCheckState(childStateToSet);
+            setItemCheckState(childItem, childStateToSet);
             emit dataChanged(childIndex, childIndex, {Qt::CheckStateRole});
         }
 
         if (childItem->type() == TreeItem::Folder) {
             // Recursive call to propagate to grandchildren
             propagateFolderStateToChildren(childItem, childStateToSet, childIndex);
+
+            if (propagationMayBeIncomplete(childStateToSet) && childItem->childCount() > 0) {
+                Qt::CheckState settledState = folderStateFromChildren(childItem);
+                if (childItem->checkState() != settledState) {
+                    childItem->setCheckState(settledState);
+                    emit dataChanged(childIndex, childIndex, {Qt::CheckStateRole});
+                }
+            }
         }
     }
 }
@@ -490,10 +547,10 @@ void CustomFileModel::selectFilesByExtension(const QModelIndex &folderIndex, con
 
     qDebug() << "selectFilesByExtension: Target Folder -" << (folderIndex.isValid() ? folderItem->name() : "Root") << "Extension -" << actualExtension;
 
-    for (int i = 0; i < folderItem->childCount(); ++i) {
-        TreeItem *childItem = folderItem->child(i);
+    for (int i = 0; i < visibleChildCount(folderItem); ++i) {
+        TreeItem *childItem = visibleChild(folderItem, i);
         if (childItem && childItem->type() == TreeItem::File) {
-            if (childItem->name().endsWith(actualExtension, Qt::CaseInsensitive)) {
+            if (childItem->name().endsWith(actualExtension, Qt::CaseInsensitive) && !isSkippedBinary(childItem)) {
                 if (childItem->checkState() != Qt::Checked) {
                     QModelIndex childIndex;
                     if (!folderIndex.isValid()){ 
@@ -571,7 +628,7 @@ void CustomFileModel::selectFilesByExtensionRecursiveHelper(const QModelIndex& c
         }
     }
 
-    for (int i = 0; i < parentItem->childCount(); ++i) {
+    for (int i = 0; i < rowCount(currentIndex); ++i) {
         QModelIndex childModelIndex = index(i, 0, currentIndex);
         if (!childModelIndex.isValid()) {
             continue;
@@ -583,7 +640,7 @@ void CustomFileModel::selectFilesByExtensionRecursiveHelper(const QModelIndex& c
         }
 
         if (childItem->type() == TreeItem::File) {
-            if (childItem->name().endsWith(normalizedExtension, Qt::CaseInsensitive)) {
+            if (childItem->name().endsWith(normalizedExtension, Qt::CaseInsensitive) && !isSkippedBinary(childItem)) {
                 if (childItem->checkState() != Qt::Checked) {
                     setData(childModelIndex, Qt::Checked, Qt::CheckStateRole);
                 }
@@ -592,4 +649,618 @@ void CustomFileModel::selectFilesByExtensionRecursiveHelper(const QModelIndex& c
             selectFilesByExtensionRecursiveHelper(childModelIndex, normalizedExtension); // Recurse into subfolder
         }
     }
-}
\ No newline at end of file
+}
+
+// Collects the files below item that are visible under the current name filter.
+void CustomFileModel::collectFilesRecursive(TreeItem *item, QList<TreeItem*> &files) const
+{
+    for (int i = 0; i < visibleChildCount(item); ++i) {
+        TreeItem *child = visibleChild(item, i);
+        if (child->type() == TreeItem::File) {
+            files.append(child);
+        } else {
+            collectFilesRecursive(child, files);
+        }
+    }
+}
+
+QModelIndex CustomFileModel::indexForItem(TreeItem *item) const
+{
+    if (!item || item == rootItem || !isItemVisible(item))
+        return QModelIndex();
+    return createIndex(visibleRow(item), 0, item);
+}
+
+Qt::CheckState CustomFileModel::folderStateFromChildren(TreeItem *folderItem) const
+{
+    int childrenCheckedCount = 0;
+    int childrenUncheckedCount = 0;
+    int childrenPartialCount = 0;
+    const int relevantChildCount = folderItem->childCount(); // All children (files or folders) are relevant
+
+    for (int i = 0; i < relevantChildCount; ++i) {
+        switch (folderItem->child(i)->checkState()) {
+        case Qt::Checked: childrenCheckedCount++; break;
+        case Qt::PartiallyChecked: childrenPartialCount++; break; // Only folders can be partial
+        default: childrenUncheckedCount++; break;
+        }
+    }
+
+    if (relevantChildCount == 0) {
+        return Qt::Unchecked; // Empty folders stay unchecked
+    } else if (childrenPartialCount > 0 || (childrenCheckedCount > 0 && childrenUncheckedCount > 0)) {
+        return Qt::PartiallyChecked;
+    } else if (childrenCheckedCount == relevantChildCount) {
+        return Qt::Checked;
+    }
+    return Qt::Unchecked;
+}
+
+void CustomFileModel::applyFileCheckStates(const QList<TreeItem*> &files, Qt::CheckState state)
+{
+    if (state == Qt::Checked) {
+        applyFileCheckStates(files, {}, true);
+    } else {
+        applyFileCheckStates({}, files, true);
+    }
+}
+
+// Batched counterpart of setData() for bulk selection operations: checks and
+// unchecks the given files, re-evaluates each affected folder exactly once
+// (deepest first) and emits a single dataChanged range per touched parent
+// instead of one signal per item and one upward walk per file.
+void CustomFileModel::applyFileCheckStates(const QList<TreeItem*> &checkFiles, const QList<TreeItem*> &uncheckFiles,
+                                           bool skipBinariesWhenChecking)
+{
+    QMap<int, QSet<TreeItem*>> dirtyFoldersByDepth;
+    QSet<TreeItem*> touchedParents; // Parents whose child rows changed
+
+    auto depthOf = [](TreeItem *item) {
+        int depth = 0;
+        for (TreeItem *p = item->parentItem(); p; p = p->parentItem())
+            ++depth;
+        return depth;
+    };
+    auto markTouched = [&](TreeItem *parentItem, int depth) {
+        if (!touchedParents.contains(parentItem)) {
+            touchedParents.insert(parentItem);
+            dirtyFoldersByDepth[depth].insert(parentItem);
+        }
+    };
+
+    auto setFileState = [&](TreeItem *file, Qt::CheckState state) {
+        if (!file || file->type() != TreeItem::File || file->checkState() == state)
+            return;
+        if (state == Qt::Checked && skipBinariesWhenChecking && isSkippedBinary(file))
+            return;
+        setItemCheckState(file, state);
+        if (!touchedParents.contains(file->parentItem()))
+            markTouched(file->parentItem(), depthOf(file->parentItem()));
+    };
+    for (TreeItem *file : uncheckFiles)
+        setFileState(file, Qt::Unchecked);
+    for (TreeItem *file : checkFiles)
+        setFileState(file, Qt::Checked);
+
+    while (!dirtyFoldersByDepth.isEmpty()) {
+        auto deepest = std::prev(dirtyFoldersByDepth.end());
+        const int depth = deepest.key();
+        const QSet<TreeItem*> folders = deepest.value();
+        dirtyFoldersByDepth.erase(deepest);
+
+        for (TreeItem *folder : folders) {
+            if (folder == rootItem)
+                continue;
+            const Qt::CheckState newState = folderStateFromChildren(folder);
+            if (folder->checkState() != newState) {
+                folder->setCheckState(newState);
+                markTouched(folder->parentItem(), depth - 1);
+            }
+        }
+    }
+
+    for (TreeItem *parentItem : touchedParents) {
+        const int count = visibleChildCount(parentItem);
+        if (count == 0 || !isItemVisible(parentItem))
+            continue;
+        const QModelIndex parentIndex = indexForItem(parentItem);
+        emit dataChanged(index(0, 0, parentIndex), index(count - 1, 0, parentIndex), {Qt::CheckStateRole});
+    }
+}
+
+int CustomFileModel::selectFilesByPredicate(const QModelIndex &startIndex, const FilePredicate &predicate)
+{
+    TreeItem *startItem = startIndex.isValid() ? static_cast<TreeItem*>(startIndex.internalPointer()) : rootItem;
+    if (!startItem || startItem->type() != TreeItem::Folder) {
+        qWarning() << "selectFilesByPredicate: Index does not point to a valid folder item or root.";
+        return 0;
+    }
+
+    // Convert the time bounds once instead of per file.
+    const qint64 modifiedAfterMs = predicate.modifiedAfter.isValid() ? predicate.modifiedAfter.toMSecsSinceEpoch()
+                                                                     : std::numeric_limits<qint64>::min();
+    const qint64 modifiedBeforeMs = predicate.modifiedBefore.isValid() ? predicate.modifiedBefore.toMSecsSinceEpoch()
+                                                                       : std::numeric_limits<qint64>::max();
+
+    QList<TreeItem*> matches;
+    collectFilesByPredicateRecursive(startItem, 1, predicate, modifiedAfterMs, modifiedBeforeMs, matches);
+    applyFileCheckStates(matches, Qt::Checked);
+
+    qDebug() << "selectFilesByPredicate: Selected" << matches.size() << "files.";
+    return matches.size();
+}
+
+void CustomFileModel::collectFilesByPredicateRecursive(TreeItem *item, int depth, const FilePredicate &predicate,
+                                                       qint64 modifiedAfterMs, qint64 modifiedBeforeMs, QList<TreeItem*> &files) const
+{
+    if (predicate.maxDepth >= 0 && depth > predicate.maxDepth)
+        return;
+
+    for (int i = 0; i < visibleChildCount(item); ++i) {
+        TreeItem *child = visibleChild(item, i);
+        if (child->type() == TreeItem::Folder) {
+            collectFilesByPredicateRecursive(child, depth + 1, predicate, modifiedAfterMs, modifiedBeforeMs, files);
+            continue;
+        }
+        if (predicate.minSize >= 0 && child->size() < predicate.minSize)
+            continue;
+        if (predicate.maxSize >= 0 && child->size() > predicate.maxSize)
+            continue;
+        if (child->lastModified() < modifiedAfterMs || child->lastModified() > modifiedBeforeMs)
+            continue;
+        files.append(child);
+    }
+}
+
+bool CustomFileModel::selectFilesByContent(const QModelIndex &startIndex, const QStringList &patterns)
+{
+    if (isContentSelectionRunning()) {
+        qWarning() << "selectFilesByContent: A content scan is already running.";
+        return false;
+    }
+
+    QList<QByteArray> literals;
+    for (const QString &pattern : patterns) {
+        if (!pattern.isEmpty())
+            literals.append(pattern.toUtf8());
+    }
+    if (literals.isEmpty()) {
+        qWarning() << "selectFilesByContent: No non-empty pattern given.";
+        return false;
+    }
+
+    TreeItem *startItem = startIndex.isValid() ? static_cast<TreeItem*>(startIndex.internalPointer()) : rootItem;
+    contentSearchCandidates.clear();
+    if (startItem->type() == TreeItem::File) {
+        contentSearchCandidates.append(startItem);
+    } else {
+        collectFilesRecursive(startItem, contentSearchCandidates);
+    }
+
+    // Workers only ever see copies of the paths, never the tree itself.
+    QStringList candidatePaths;
+    candidatePaths.reserve(contentSearchCandidates.size());
+    for (TreeItem *item : std::as_const(contentSearchCandidates))
+        candidatePaths.append(item->path());
+
+    qDebug() << "selectFilesByContent: Scanning" << candidatePaths.size() << "files for" << patterns;
+
+    contentSearchCancelled = std::make_shared<std::atomic_bool>(false);
+    std::shared_ptr<std::atomic_bool> cancelled = contentSearchCancelled;
+    contentSearchWatcher.setFuture(QtConcurrent::mapped(std::move(candidatePaths), [literals, cancelled](const QString &path) {
+        return ContentSearch::fileContainsAny(path, literals, cancelled.get());
+    }));
+    return true;
+}
+
+void CustomFileModel::cancelContentSelection()
+{
+    if (!isContentSelectionRunning())
+        return;
+    contentSearchCancelled->store(true);
+    contentSearchWatcher.cancel();
+}
+
+bool CustomFileModel::isContentSelectionRunning() const
+{
+    // Set when a scan starts, cleared once its results have been applied.
+    return contentSearchCancelled != nullptr;
+}
+
+void CustomFileModel::handleContentSelectionFinished()
+{
+    const bool cancelled = contentSearchWatcher.isCanceled() || (contentSearchCancelled && contentSearchCancelled->load());
+
+    QList<TreeItem*> matches;
+    if (!cancelled) {
+        const QFuture<bool> future = contentSearchWatcher.future();
+        for (int i = 0; i < contentSearchCandidates.size(); ++i) {
+            if (future.resultAt(i))
+                matches.append(contentSearchCandidates.at(i));
+        }
+        applyFileCheckStates(matches, Qt::Checked);
+    }
+
+    qDebug() << "selectFilesByContent: Finished. Matches:" << matches.size() << "Cancelled:" << cancelled;
+    contentSearchCandidates.clear();
+    contentSearchCancelled.reset();
+    emit contentSelectionFinished(matches.size(), cancelled);
+}
+
+void CustomFileModel::startContentClassification()
+{
+    if (isContentClassificationRunning()) {
+        qWarning() << "startContentClassification: Classification is already running.";
+        return;
+    }
+
+    // Classify every file, not just the ones the name filter currently shows.
+    classificationCandidates.clear();
+    for (TreeItem *item : std::as_const(allItems)) {
+        if (item->type() == TreeItem::File)
+            classificationCandidates.append(item);
+    }
+
+    QStringList candidatePaths;
+    candidatePaths.reserve(classificationCandidates.size());
+    for (TreeItem *item : std::as_const(classificationCandidates))
+        candidatePaths.append(item->path());
+
+    classificationWatcher.setFuture(QtConcurrent::mapped(std::move(candidatePaths), &FileClassifier::classifyFile));
+}
+
+void CustomFileModel::cancelContentClassification()
+{
+    classificationWatcher.cancel();
+}
+
+bool CustomFileModel::isContentClassificationRunning() const
+{
+    // Candidates are kept until the finished handler has consumed the results.
+    return classificationWatcher.isRunning() || !classificationCandidates.isEmpty();
+}
+
+void CustomFileModel::setSkipBinaryFiles(bool skip)
+{
+    skipBinaries = skip;
+}
+
+bool CustomFileModel::skipBinaryFiles() const
+{
+    return skipBinaries;
+}
+
+bool CustomFileModel::isSkippedBinary(TreeItem *item) const
+{
+    return skipBinaries && item->type() == TreeItem::File && item->contentKind() == FileClassifier::Binary;
+}
+
+void CustomFileModel::handleContentClassificationFinished()
+{
+    // Even a cancelled run keeps whatever it classified before stopping.
+    const QFuture<FileClassifier::Kind> future = classificationWatcher.future();
+    QSet<TreeItem*> touchedParents;
+    int binaryCount = 0;
+    for (int i = 0; i < classificationCandidates.size(); ++i) {
+        if (!future.isResultReadyAt(i))
+            continue;
+        TreeItem *item = classificationCandidates.at(i);
+        const FileClassifier::Kind kind = future.resultAt(i);
+        if (kind == FileClassifier::Binary)
+            ++binaryCount;
+        if (item->contentKind() != kind) {
+            item->setContentKind(kind);
+            touchedParents.insert(item->parentItem());
+        }
+    }
+
+    for (TreeItem *parentItem : std::as_const(touchedParents)) {
+        const int count = visibleChildCount(parentItem);
+        if (count == 0 || !isItemVisible(parentItem))
+            continue;
+        const QModelIndex parentIndex = indexForItem(parentItem);
+        emit dataChanged(index(0, 0, parentIndex), index(count - 1, 0, parentIndex), {ContentKindRole});
+    }
+
+    qDebug() << "Content classification finished." << classificationCandidates.size() << "files," << binaryCount << "binary.";
+    classificationCandidates.clear();
+    emit contentClassificationFinished(binaryCount);
+}
+
+// Every change of a file's check state goes through here (or is followed by
+// recomputeTotals()), which keeps the selection totals and checkedIds current.
+void CustomFileModel::setItemCheckState(TreeItem *item, Qt::CheckState state)
+{
+    if (item->type() == TreeItem::File && (item->checkState() == Qt::Checked) != (state == Qt::Checked)) {
+        addToTotals(item, state == Qt::Checked ? 1 : -1);
+        checkedIds.setBit(item->id(), state == Qt::Checked); // Detaches from any snapshot first
+    }
+    item->setCheckState(state);
+}
+
+void CustomFileModel::addToTotals(const TreeItem *file, int sign)
+{
+    totals.fileCount += sign;
+    totals.bytes += sign * file->size();
+    if (file->hasTextStats()) {
+        totals.countedFiles += sign;
+        totals.lines += sign * file->lineCount();
+        totals.tokens += sign * file->tokenCount();
+    }
+}
+
+void CustomFileModel::recomputeTotals()
+{
+    totals = SelectionTotals();
+    checkedIds.fill(false);
+    for (TreeItem *item : std::as_const(allItems)) {
+        if (item->type() == TreeItem::File && item->checkState() == Qt::Checked) {
+            addToTotals(item, 1);
+            checkedIds.setBit(item->id());
+        }
+    }
+}
+
+SelectionSnapshot CustomFileModel::selectionSnapshot() const
+{
+    return SelectionSnapshot(checkedIds, pathTable, sizeTable, totals.fileCount);
+}
+
+SelectionTotals CustomFileModel::selectionTotals() const
+{
+    return totals;
+}
+
+bool CustomFileModel::startTextStatistics()
+{
+    if (isTextStatisticsRunning())
+        return false;
+
+    QStringList candidatePaths;
+    for (TreeItem *item : std::as_const(allItems)) {
+        if (item->type() == TreeItem::File && item->checkState() == Qt::Checked && !item->hasTextStats()) {
+            textStatsCandidates.append(item);
+            candidatePaths.append(item->path());
+        }
+    }
+    if (textStatsCandidates.isEmpty())
+        return false;
+
+    // Each file is counted by one pool thread with a SIMD kernel; files run in parallel.
+    textStatsWatcher.setFuture(QtConcurrent::mapped(std::move(candidatePaths), &TextStats::countFile));
+    return true;
+}
+
+void CustomFileModel::cancelTextStatistics()
+{
+    textStatsWatcher.cancel();
+}
+
+bool CustomFileModel::isTextStatisticsRunning() const
+{
+    return textStatsWatcher.isRunning() || !textStatsCandidates.isEmpty();
+}
+
+void CustomFileModel::handleTextStatisticsFinished()
+{
+    const QFuture<TextCounts> future = textStatsWatcher.future();
+    for (int i = 0; i < textStatsCandidates.size(); ++i) {
+        if (!future.isResultReadyAt(i))
+            continue;
+        TreeItem *item = textStatsCandidates.at(i);
+        const TextCounts counts = future.resultAt(i);
+        const bool checked = item->checkState() == Qt::Checked; // May have changed meanwhile
+        if (checked)
+            addToTotals(item, -1);
+        // An unreadable file counts as empty rather than being retried forever.
+        item->setTextStats(counts.ok ? counts.lines : 0, counts.ok ? counts.estimatedTokens() : 0);
+        if (checked)
+            addToTotals(item, 1);
+    }
+    textStatsCandidates.clear();
+    emit textStatisticsFinished();
+}
+
+// Called for every node in scan (pre-)order: assigns its id and indexes its name.
+void CustomFileModel::registerItem(TreeItem *item)
+{
+    const quint32 id = quint32(allItems.size());
+    item->setId(id);
+    allItems.append(item);
+    nameIndex.addName(id, item->name());
+}
+
+void CustomFileModel::setNameFilter(const QString &text)
+{
+    const QString newFilter = text.trimmed();
+    if (newFilter == filterText)
+        return;
+
+    QList<quint32> matches;
+    auto consider = [&](quint32 id) {
+        if (allItems.at(id)->name().contains(newFilter, Qt::CaseInsensitive))
+            matches.append(id);
+    };
+
+    if (!newFilter.isEmpty()) {
+        if (isFiltered() && newFilter.contains(filterText, Qt::CaseInsensitive)) {
+            // Typing on only narrows: every new match is among the previous ones.
+            for (quint32 id : std::as_const(filterMatchIds))
+                consider(id);
+        } else if (TrigramIndex::canQuery(newFilter)) {
+            const QList<quint32> candidates = nameIndex.candidates(newFilter);
+            for (quint32 id : candidates)
+                consider(id);
+        } else {
+            for (quint32 id = 0; id < quint32(allItems.size()); ++id)
+                consider(id);
+        }
+    }
+
+    beginResetModel();
+    filterText = newFilter;
+    filterMatchIds = matches;
+    filteredChildren.clear();
+    filteredRows.clear();
+    if (isFiltered())
+        buildFilteredTree(filterMatchIds);
+    endResetModel();
+
+    qDebug() << "setNameFilter:" << filterText << "matches:" << filterMatchIds.size();
+}
+
+// Makes the matches and all their ancestors visible, keeping scan order among siblings.
+void CustomFileModel::buildFilteredTree(const QList<quint32> &matchIds)
+{
+    QBitArray visible(allItems.size());
+    QList<quint32> visibleIds;
+    for (quint32 id : matchIds) {
+        for (TreeItem *item = allItems.at(id); item && item != rootItem && !visible.testBit(item->id()); item = item->parentItem()) {
+            visible.setBit(item->id());
+            visibleIds.append(item->id());
+        }
+    }
+
+    // Ids are pre-order, so sorting them lists every parent before its children
+    // and siblings in their original order.
+    std::sort(visibleIds.begin(), visibleIds.end());
+    for (quint32 id : std::as_const(visibleIds)) {
+        TreeItem *item = allItems.at(id);
+        QList<TreeItem*> &siblings = filteredChildren[item->parentItem()];
+        filteredRows.insert(item, siblings.size());
+        siblings.append(item);
+    }
+}
+
+QString CustomFileModel::nameFilter() const
+{
+    return filterText;
+}
+
+bool CustomFileModel::isFiltered() const
+{
+    return !filterText.isEmpty();
+}
+
+int CustomFileModel::filterMatchCount() const
+{
+    return filterMatchIds.size();
+}
+
+int CustomFileModel::visibleChildCount(TreeItem *item) const
+{
+    if (!isFiltered())
+        return item->childCount();
+    auto it = filteredChildren.constFind(item);
+    return it == filteredChildren.constEnd() ? 0 : it.value().size();
+}
+
+TreeItem *CustomFileModel::visibleChild(TreeItem *item, int row) const
+{
+    if (!isFiltered())
+        return item->child(row);
+    auto it = filteredChildren.constFind(item);
+    if (it == filteredChildren.constEnd() || row < 0 || row >= it.value().size())
+        return nullptr;
+    return it.value().at(row);
+}
+
+int CustomFileModel::visibleRow(TreeItem *item) const
+{
+    if (!isFiltered())
+        return item->row();
+    return filteredRows.value(item, -1);
+}
+
+bool CustomFileModel::isItemVisible(TreeItem *item) const
+{
+    return !isFiltered() || item == rootItem || filteredRows.contains(item);
+}
+
+// True when checking/unchecking a folder may leave some of its children as they
+// were, so the folder's own state has to be derived from its children afterwards.
+bool CustomFileModel::propagationMayBeIncomplete(Qt::CheckState state) const
+{
+    return isFiltered() || (skipBinaries && state == Qt::Checked);
+}
+
+QString CustomFileModel::rootPath() const
+{
+    return modelRootPath;
+}
+
+QString CustomFileModel::relativePath(const TreeItem *item) const
+{
+    // Item paths are built by QDir from the root, so they always start with "<root>/".
+    const int prefixLength = modelRootPath.endsWith('/') ? modelRootPath.size() : modelRootPath.size() + 1;
+    return item->path().mid(prefixLength);
+}
+
+QStringList CustomFileModel::checkedRelativePaths() const
+{
+    QStringList paths;
+    for (const TreeItem *item : allItems) {
+        if (item->type() == TreeItem::File && item->checkState() == Qt::Checked)
+            paths.append(relativePath(item));
+    }
+    return paths;
+}
+
+int CustomFileModel::applySelection(const QStringList &relativePaths, const QStringList &patterns, int *missingCount)
+{
+    // The tree never changes after the scan, so the lookup table is built once.
+    if (relativePathIndex.isEmpty()) {
+        relativePathIndex.reserve(allItems.size());
+        for (TreeItem *item : std::as_const(allItems)) {
+            if (item->type() == TreeItem::File)
+                relativePathIndex.insert(relativePath(item), item);
+        }
+    }
+
+    QSet<TreeItem*> selected;
+    selected.reserve(relativePaths.size());
+    int missing = 0;
+    for (const QString &path : relativePaths) {
+        TreeItem *item = relativePathIndex.value(path);
+        if (item) {
+            selected.insert(item);
+        } else {
+            ++missing;
+        }
+    }
+
+    if (!patterns.isEmpty()) {
+        // Patterns containing a '/' are matched against the relative path, all
+        // others against the file name only (so "*.cpp" matches at any depth).
+        QList<QPair<QRegularExpression, bool>> expressions;
+        for (const QString &pattern : patterns) {
+            expressions.append({QRegularExpression(QRegularExpression::wildcardToRegularExpression(pattern),
+                                                   QRegularExpression::CaseInsensitiveOption),
+                                pattern.contains('/')});
+        }
+        for (auto it = relativePathIndex.cbegin(); it != relativePathIndex.cend(); ++it) {
+            for (const auto &expression : std::as_const(expressions)) {
+                const QString subject = expression.second ? it.key() : it.value()->name();
+                if (expression.first.match(subject).hasMatch()) {
+                    selected.insert(it.value());
+                    break;
+                }
+            }
+        }
+    }
+
+    // The profile describes the complete selection: everything else is unchecked,
+    // in the same batch.
+    QList<TreeItem*> checkFiles(selected.cbegin(), selected.cend());
+    QList<TreeItem*> uncheckFiles;
+    for (TreeItem *item : std::as_const(allItems)) {
+        if (item->type() == TreeItem::File && item->checkState() == Qt::Checked && !selected.contains(item))
+            uncheckFiles.append(item);
+    }
+    applyFileCheckStates(checkFiles, uncheckFiles, false);
+
+    if (missingCount)
+        *missingCount = missing;
+    qDebug() << "applySelection: Selected" << checkFiles.size() << "files," << missing << "paths not found.";
+    return checkFiles.size();
+}
@@ -7,14 +7,52 @@
 #include <QStringList>
 #include <QDir>
 #include <QCoreApplication> // For tr
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QBitArray>
+#include <memory>
+#include "fileclassifier.h"
+#include "trigramindex.h"
+#include "textstats.h"
+#include "selectionsnapshot.h"
+#include <atomic>
 
 class TreeItem; // Forward declaration
 
+// Criteria for CustomFileModel::selectFilesByPredicate(). Every bound is optional;
+// a file is selected when it satisfies all bounds that are set.
+struct FilePredicate
+{
+    qint64 minSize = -1;        // Bytes, -1 = no lower bound
+    qint64 maxSize = -1;        // Bytes, -1 = no upper bound
+    QDateTime modifiedAfter;    // Invalid = no bound
+    QDateTime modifiedBefore;   // Invalid = no bound
+    int maxDepth = -1;          // Relative to the start folder (its direct files are depth 1), -1 = unlimited
+};
+
+// What the checked files add up to. Kept up to date as check states change,
+// so reading it is O(1). Lines and tokens cover the countedFiles whose text
+// statistics are known so far.
+struct SelectionTotals
+{
+    int fileCount = 0;
+    qint64 bytes = 0;
+    int countedFiles = 0;
+    qint64 lines = 0;
+    qint64 tokens = 0;
+};
+
 class CustomFileModel : public QAbstractItemModel
 {
     Q_OBJECT
 
 public:
+    enum Roles {
+        FileSizeRole = Qt::UserRole + 1, // qint64 bytes, captured during the scan
+        LastModifiedRole,                // QDateTime, captured during the scan
+        ContentKindRole                  // int FileClassifier::Kind, Unknown until classified
+    };
+
     explicit CustomFileModel(const QString &rootPath, QObject *parent = nullptr);
     ~CustomFileModel();
 
@@ -39,22 +77,143 @@ public:
     void toggleCheckState(const QModelIndex &index);
     void setAllCheckStates(Qt::CheckState state);
     QStringList getCheckedFilesPaths() const;
+    // Same list, with the sizes recorded during the scan appended to sizes in the same order.
+    QStringList getCheckedFilesPaths(QList<qint64> *sizes) const;
+    // The same files as an immutable snapshot, taken in O(1); see SelectionSnapshot.
+    SelectionSnapshot selectionSnapshot() const;
     bool hasFiles() const;
     void selectFilesByExtension(const QModelIndex &folderIndex, const QString &extension);
     void selectFilesByExtensionRecursive(const QModelIndex& startIndex, const QString &extension);
 
+    // Checks every file below startIndex matching the predicate, using only the
+    // metadata captured during the scan (no file is stat'ed again). Returns the
+    // number of matching files.
+    int selectFilesByPredicate(const QModelIndex &startIndex, const FilePredicate &predicate);
+
+    // Content-based selection. Scans the files below startIndex on the global
+    // thread pool and checks every file containing any of the literal patterns
+    // (case-sensitive, matched as UTF-8 bytes). Results are applied in one batch
+    // when the scan completes. Returns false if a scan is already running.
+    bool selectFilesByContent(const QModelIndex &startIndex, const QStringList &patterns);
+    void cancelContentSelection();
+    bool isContentSelectionRunning() const;
+
+    // Background text/binary classification of every file in the tree. While
+    // skipping is enabled, bulk selections (select all, checking a folder,
+    // selection by extension/predicate/content) leave binary files unchecked;
+    // checking a binary file directly still works.
+    void startContentClassification();
+    void cancelContentClassification();
+    bool isContentClassificationRunning() const;
+    void setSkipBinaryFiles(bool skip);
+    bool skipBinaryFiles() const;
+
+    // Incremental name filter. Shows only nodes whose name contains text
+    // (case-insensitive) plus their ancestors; an empty text shows everything.
+    // Candidates come from a trigram index built during the scan. While a filter
+    // is active, check operations (select all, checking a folder, bulk selections)
+    // only affect the visible files.
+    void setNameFilter(const QString &text);
+    QString nameFilter() const;
+    bool isFiltered() const;
+    int filterMatchCount() const;
+
+    // Selection profiles. Paths are relative to the root with '/' separators.
+    // applySelection() makes the given files (plus every file whose relative path
+    // matches one of the wildcard patterns) the complete selection, resolving
+    // paths through a hash table and applying all changes in one batch. Returns
+    // the number of selected files; paths that do not exist are counted in
+    // missingCount.
+    QString rootPath() const;
+    QStringList checkedRelativePaths() const;
+    int applySelection(const QStringList &relativePaths, const QStringList &patterns = QStringList(), int *missingCount = nullptr);
+
+    // Size estimate of the current selection. startTextStatistics() counts
+    // lines and tokens of the checked files that have no counts yet on the
+    // global thread pool (results are cached per file, see TextStats) and
+    // emits textStatisticsFinished() when done. Returns false if a count is
+    // already running or nothing needs counting.
+    SelectionTotals selectionTotals() const;
+    bool startTextStatistics();
+    void cancelTextStatistics();
+    bool isTextStatisticsRunning() const;
+
+signals:
+    void contentSelectionProgress(int scannedCount, int totalCount);
+    void contentSelectionFinished(int matchedCount, bool cancelled);
+    void contentClassificationFinished(int binaryCount);
+    void textStatisticsFinished();
+
+private slots:
+    void handleContentSelectionFinished();
+    void handleContentClassificationFinished();
+    void handleTextStatisticsFinished();
+
 private:
     void setupModelData(const QString &rootPath, TreeItem *parent);
-    void getCheckedFilesRecursive(TreeItem *item, QStringList &paths) const;
+    void registerItem(TreeItem *item);
+    void buildFilteredTree(const QList<quint32> &matchIds);
+    int visibleChildCount(TreeItem *item) const;
+    TreeItem *visibleChild(TreeItem *item, int row) const;
+    int visibleRow(TreeItem *item) const;
+    bool isItemVisible(TreeItem *item) const;
+    bool propagationMayBeIncomplete(Qt::CheckState state) const;
+    void getCheckedFilesRecursive(TreeItem *item, QStringList &paths, QList<qint64> *sizes = nullptr) const;
     void setAllCheckStatesRecursive(TreeItem *item, Qt::CheckState state); // Removed changedIndices
     bool hasFilesRecursive(TreeItem* item) const;
     void updateFolderCheckState(const QModelIndex &folderIndex);
     void propagateFolderStateToChildren(TreeItem *folderItem, Qt::CheckState state, const QModelIndex &parentFolderIndex);
     void selectFilesByExtensionRecursiveHelper(const QModelIndex& currentIndex, const QString &normalizedExtension);
+    void collectFilesRecursive(TreeItem *item, QList<TreeItem*> &files) const;
+    void collectFilesByPredicateRecursive(TreeItem *item, int depth, const FilePredicate &predicate,
+                                          qint64 modifiedAfterMs, qint64 modifiedBeforeMs, QList<TreeItem*> &files) const;
+    QModelIndex indexForItem(TreeItem *item) const;
+    Qt::CheckState folderStateFromChildren(TreeItem *folderItem) const;
+    void applyFileCheckStates(const QList<TreeItem*> &files, Qt::CheckState state);
+    void applyFileCheckStates(const QList<TreeItem*> &checkFiles, const QList<TreeItem*> &uncheckFiles, bool skipBinariesWhenChecking);
+    QString relativePath(const TreeItem *item) const;
+    void checkAllSkippingBinariesRecursive(TreeItem *item);
+    bool isSkippedBinary(TreeItem *item) const;
+    void setItemCheckState(TreeItem *item, Qt::CheckState state);
+    void addToTotals(const TreeItem *file, int sign);
+    void recomputeTotals();
 
 
     TreeItem *rootItem;
+    QString modelRootPath;
     QStringList nameFilters; // e.g., "*.txt", "*.log" - currently allows all files/folders
+
+    // State of the running content scan (if any)
+    QFutureWatcher<bool> contentSearchWatcher;
+    QList<TreeItem*> contentSearchCandidates;
+    std::shared_ptr<std::atomic_bool> contentSearchCancelled;
+
+    // State of the background text/binary classification
+    QFutureWatcher<FileClassifier::Kind> classificationWatcher;
+    QList<TreeItem*> classificationCandidates;
+    bool skipBinaries;
+
+    // Selection totals and the running line/token count (if any)
+    SelectionTotals totals;
+    QFutureWatcher<TextCounts> textStatsWatcher;
+    QList<TreeItem*> textStatsCandidates;
+
+    // Pre-order table of all nodes (ids index into it) and the name index over it
+    QList<TreeItem*> allItems;
+    TrigramIndex nameIndex;
+    QHash<QString, TreeItem*> relativePathIndex; // Built on first applySelection()
+
+    // The selection by node id for selectionSnapshot(): the bits follow every
+    // file check state change, the tables are filled once after the scan.
+    QBitArray checkedIds;
+    QStringList pathTable;   // Empty for folders
+    QList<qint64> sizeTable;
+
+    // Name filter state; the hashes only hold visible nodes
+    QString filterText;
+    QList<quint32> filterMatchIds;
+    QHash<const TreeItem*, QList<TreeItem*>> filteredChildren;
+    QHash<const TreeItem*, int> filteredRows;
 };
 
 #endif // CUSTOMFILEMODEL_H 
\ No newline at end of file
@@ -0,0 +1,66 @@
+// fileclassifier.cpp
+
+#include "fileclassifier.h"
+#include "utf8.h"
+#include "fileidentity.h"
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QMimeDatabase>
+#include <QMimeType>
+#include <QDebug>
+#include <cstring> // For memchr
+
+namespace {
+
+QMutex cacheMutex;
+QHash<FileIdentity, FileClassifier::Kind> classificationCache;
+
+} // namespace
+
+FileClassifier::Kind FileClassifier::classifyData(const QString &fileName, const QByteArray &head)
+{
+    if (head.isEmpty())
+        return Text; // Empty files merge harmlessly
+
+    if (std::memchr(head.constData(), '\0', size_t(head.size())))
+        return Binary;
+
+    if (Utf8::isValid(head.constData(), head.size(), /*allowTruncatedTail=*/true))
+        return Text;
+
+    QMimeDatabase mimeDatabase;
+    const QMimeType mimeType = mimeDatabase.mimeTypeForFileNameAndData(fileName, head);
+    return mimeType.inherits(QStringLiteral("text/plain")) ? Text : Binary;
+}
+
+FileClassifier::Kind FileClassifier::classifyFile(const QString &path)
+{
+    FileIdentity key;
+    const bool haveKey = FileIdentity::forPath(path, key);
+    if (haveKey) {
+        QMutexLocker locker(&cacheMutex);
+        auto it = classificationCache.constFind(key);
+        if (it != classificationCache.constEnd())
+            return it.value();
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "FileClassifier: could not open" << path << file.errorString();
+        return Unknown;
+    }
+    const Kind kind = classifyData(path, file.read(SniffSize));
+
+    if (haveKey) {
+        QMutexLocker locker(&cacheMutex);
+        classificationCache.insert(key, kind);
+    }
+    return kind;
+}
+
+void FileClassifier::clearCache()
+{
+    QMutexLocker locker(&cacheMutex);
+    classificationCache.clear();
+}
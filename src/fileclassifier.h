@@ -0,0 +1,31 @@
+// fileclassifier.h
+// Cheap text/binary classification of files from their first few KB.
+
+#ifndef FILECLASSIFIER_H
+#define FILECLASSIFIER_H
+
+#include <QByteArray>
+#include <QString>
+
+class FileClassifier
+{
+public:
+    enum Kind : quint8 { Unknown, Text, Binary };
+
+    // Only this many bytes from the start of a file are ever read.
+    static constexpr qint64 SniffSize = 8 * 1024;
+
+    // Classifies a file from its leading bytes: a NUL byte means binary, valid
+    // UTF-8 means text, and only the remaining cases (e.g. Latin-1 text or
+    // formats without NULs in their header) fall back to a MIME lookup.
+    static Kind classifyData(const QString &fileName, const QByteArray &head);
+
+    // Reads at most SniffSize bytes of the file and classifies them. Results are
+    // cached process-wide by (device, inode, size, mtime), so a rescan of an
+    // unchanged tree does not read anything again.
+    static Kind classifyFile(const QString &path);
+
+    static void clearCache();
+};
+
+#endif // FILECLASSIFIER_H
@@ -0,0 +1,37 @@
+// fileidentity.cpp
+
+#include "fileidentity.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+bool FileIdentity::forPath(const QString &path, FileIdentity &identity)
+{
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) != 0)
+        return false;
+    identity.device = quint64(st.st_dev);
+    identity.inode = quint64(st.st_ino);
+    identity.size = qint64(st.st_size);
+#if defined(Q_OS_DARWIN)
+    identity.lastModified = qint64(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    identity.lastModified = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    return true;
+#else
+    QFileInfo info(path);
+    if (!info.exists())
+        return false;
+    identity.device = 0;
+    identity.inode = qHash(info.absoluteFilePath());
+    identity.size = info.size();
+    identity.lastModified = info.lastModified().toMSecsSinceEpoch();
+    return true;
+#endif
+}
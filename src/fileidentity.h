@@ -0,0 +1,35 @@
+// fileidentity.h
+// Identifies a file's current content by (device, inode, size, mtime).
+
+#ifndef FILEIDENTITY_H
+#define FILEIDENTITY_H
+
+#include <QHashFunctions>
+#include <QString>
+
+// Two equal identities mean the same file with (as far as the file system can
+// tell) unchanged content, so anything derived from the content can be cached
+// under it.
+struct FileIdentity
+{
+    quint64 device = 0;
+    quint64 inode = 0; // On platforms without inodes: a hash of the path
+    qint64 size = 0;
+    qint64 lastModified = 0; // Nanoseconds where the platform provides them
+
+    // Stats path; false if it does not exist or cannot be accessed.
+    static bool forPath(const QString &path, FileIdentity &identity);
+
+    bool operator==(const FileIdentity &other) const
+    {
+        return device == other.device && inode == other.inode
+               && size == other.size && lastModified == other.lastModified;
+    }
+};
+
+inline size_t qHash(const FileIdentity &identity, size_t seed = 0)
+{
+    return qHashMulti(seed, identity.device, identity.inode, identity.size, identity.lastModified);
+}
+
+#endif // FILEIDENTITY_H
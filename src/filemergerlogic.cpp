@@ -3,21 +3,141 @@
 #include "filemergerlogic.h"
 #include <QFile>
 #include <QFileInfo> // For QFileInfo
-#include <QTextStream>
 #include <QDateTime>
 #include <QThread>
 #include <QDir>
 #include <QDebug> // For logging
 #include <QCoreApplication> // For tr
+#include <QStorageInfo>
+#include <QMutex>
+#include <QSet>
+#include "uringreader.h"
+#include "sourceencoding.h"
+#include "contenthash.h"
+#include "fileclassifier.h"
+#include <QBitArray>
+#include <cerrno>
+#include <cstring> // For strerror
+
+namespace {
+
+// Length of data without a UTF-8 sequence cut off at its end.
+qint64 completeUtf8Prefix(const char *data, qint64 size) {
+    for (qint64 back = 1; back <= qMin<qint64>(size, 4); ++back) {
+        const uchar c = uchar(data[size - back]);
+        if ((c & 0xC0) == 0x80) {
+            continue; // Continuation byte
+        }
+        const qint64 length = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        return length > back ? size - back : size;
+    }
+    return size;
+}
+
+// Number of continuation bytes (at most three) data starts with.
+qint64 utf8ContinuationLength(const char *data, qint64 size) {
+    qint64 i = 0;
+    while (i < qMin<qint64>(size, 3) && (uchar(data[i]) & 0xC0) == 0x80) {
+        ++i;
+    }
+    return i;
+}
+
+// Base paths of the outputs this process is writing. Output names carry a
+// timestamp in seconds, so merges started within the same second (queued or
+// running side by side) would otherwise write the same file.
+QMutex outputClaimsMutex;
+QSet<QString> outputClaims;
+
+// Holds a base path in outputClaims for as long as a merge runs.
+class OutputClaim {
+public:
+    OutputClaim() = default;
+    Q_DISABLE_COPY(OutputClaim)
+    ~OutputClaim() {
+        if (!claimed.isEmpty()) {
+            QMutexLocker locker(&outputClaimsMutex);
+            outputClaims.remove(claimed);
+        }
+    }
+
+    // Claims basePath, or the first of basePath_2, basePath_3, ... that no
+    // other merge holds and that isTaken() does not report as written before.
+    QString claim(const QString &basePath, const std::function<bool(const QString &)> &isTaken) {
+        QMutexLocker locker(&outputClaimsMutex);
+        QString candidate = basePath;
+        for (int n = 2; outputClaims.contains(candidate) || isTaken(candidate); ++n) {
+            candidate = basePath + QString("_%1").arg(n);
+        }
+        outputClaims.insert(candidate);
+        claimed = candidate;
+        return candidate;
+    }
+
+    // Claims exactly basePath; false when another merge holds it.
+    bool claimExactly(const QString &basePath) {
+        QMutexLocker locker(&outputClaimsMutex);
+        if (outputClaims.contains(basePath)) {
+            return false;
+        }
+        outputClaims.insert(basePath);
+        claimed = basePath;
+        return true;
+    }
+
+    // True when a running merge writes outputPath (a base path plus suffixes).
+    static bool isHeld(const QString &outputPath) {
+        QMutexLocker locker(&outputClaimsMutex);
+        for (const QString &basePath : std::as_const(outputClaims)) {
+            if (outputPath.startsWith(basePath + '.')) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    QString claimed;
+};
+
+} // namespace
 
 // --- MergeWorker Implementation ---
-MergeWorker::MergeWorker(const QStringList &files, const QString &outputPath)
-    : filesToMerge(files), outputPathBase(outputPath) {}
+MergeWorker::MergeWorker(const QStringList &files, const QString &outputPath, const MergeOptions &options)
+    : filesToMerge(files), outputPathBase(outputPath), options(options), cancelFlag(nullptr), processedCount(0),
+      totalBytes(0), totalWeight(0), completedWeight(0), currentFileBytes(0), bytesDone(0),
+      lastProgressEmitMs(0), lastPercentage(0), lastContentHash(0),
+      hashSections(false), writeIndexFooter(false), sectionOffset(0), lastSectionHash(0),
+      contentChain(options.transforms), licensePending(false), sourceBytes(0), writeManifest(false),
+      writeCheckpoints(false), checkpointListHash(0), checkpointedCount(0), checkpointSaved(false) {}
 
 MergeWorker::~MergeWorker() {
     qDebug() << "MergeWorker destroyed";
 }
 
+void MergeWorker::setCancelFlag(const std::atomic_bool *flag) {
+    cancelFlag = flag;
+}
+
+bool MergeWorker::isCancelled() const {
+    return (cancelFlag && cancelFlag->load(std::memory_order_relaxed))
+           || QThread::currentThread()->isInterruptionRequested();
+}
+
+// xxh64 of a source, slice by slice so a cancel is not held up by a huge
+// mapped file that still has to come in from disk; the result of a
+// cancelled run is meaningless.
+quint64 MergeWorker::hashContent(const char *data, qint64 size) const {
+    if (size <= ProgressSliceBytes) {
+        return ContentHash::xxh64(data, size);
+    }
+    ContentHash::Xxh64 hash;
+    for (qint64 offset = 0; offset < size && !isCancelled(); offset += ProgressSliceBytes) {
+        hash.add(data + offset, qMin(ProgressSliceBytes, size - offset));
+    }
+    return hash.digest();
+}
+
 void MergeWorker::process() {
     if (filesToMerge.isEmpty()) {
         emit finished(false, QCoreApplication::tr("没有选择文件进行合并。 (No files selected for merging.)"));
@@ -25,162 +145,1256 @@ void MergeWorker::process() {
         return;
     }
 
-    QString mergedContent;
-    int fileCount = filesToMerge.count();
-    int processedCount = 0;
+    QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd_HH-mm-ss");
+    QString outputBasePath = QDir(outputPathBase).filePath(QString("collated_files_%1").arg(timestamp));
+
+    writeCheckpoints = options.checkpointing && options.partLimitBytes() <= 0 && !options.deduplicate
+                       && !options.incremental && !options.indexFooter;
+    if (options.checkpointing && !writeCheckpoints) {
+        qDebug() << "MergeWorker: no checkpoints for split, deduplicated, incremental or indexed output";
+    }
+    MergeCheckpoint resumePoint;
+    checkpointListHash = writeCheckpoints ? sourceListHash() : 0;
+    const QString outputSuffix = ".txt" + BlockCompression::fileSuffix(options.compression);
+    OutputClaim outputClaim;
+    bool resuming = writeCheckpoints && options.resume && findResumePoint(outputPathBase, &resumePoint);
+    if (resuming && !outputClaim.claimExactly(resumePoint.outputPath.chopped(outputSuffix.size()))) {
+        qDebug() << "MergeWorker: another merge is continuing" << resumePoint.outputPath << "- starting over";
+        resuming = false;
+    }
+    if (resuming) {
+        // The output keeps the name of the run that was interrupted.
+        outputBasePath = resumePoint.outputPath.chopped(outputSuffix.size());
+        qDebug() << "MergeWorker: resuming" << resumePoint.outputPath << "after" << resumePoint.sourcesDone << "sources";
+    } else {
+        doneSources = ContentHash::Xxh64();
+    }
+    if (!resuming) {
+        outputBasePath = outputClaim.claim(outputBasePath, [this](const QString &basePath) {
+            const PartedOutput probe(basePath, options.compression, options.compressionLevel, options.partLimitBytes());
+            return QFile::exists(probe.resultPath()) || QFile::exists(MergeOutput::temporaryPath(probe.resultPath()));
+        });
+    }
+
+    // Sources are streamed straight into the output file instead of being
+    // decoded and accumulated in memory first, so the output is opened up front.
+    PartedOutput output(outputBasePath, options.compression, options.compressionLevel, options.partLimitBytes());
+    writeManifest = options.incremental && options.compression == OutputCompression::None
+                    && !output.isSplit() && !options.deduplicate;
+    writeIndexFooter = options.indexFooter && options.compression == OutputCompression::None && !output.isSplit();
+    hashSections = writeIndexFooter || writeManifest; // The manifest keeps them for reused ranges
+    sectionIndex.clear();
+    manifest = MergeManifest();
+    if (writeManifest) {
+        openPreviousOutput(output.resultPath()); // Before close() can replace it
+    }
+
+    // Sizes come from the scan or a stat; no source has been read yet.
+    initProgress();
+    if (options.compression == OutputCompression::None) {
+        const qint64 needed = expectedOutputSize() - (resuming ? resumePoint.fileBytes : 0);
+        const QStorageInfo storage(outputPathBase);
+        if (storage.isValid() && storage.bytesAvailable() >= 0 && needed > storage.bytesAvailable()) {
+            emit finished(false, QCoreApplication::tr("输出位置空间不足: 需要约 %1 MB, 可用 %2 MB (Not enough free space for the output: about %1 MB needed, %2 MB available)")
+                                     .arg(needed / (1024.0 * 1024.0), 0, 'f', 1)
+                                     .arg(storage.bytesAvailable() / (1024.0 * 1024.0), 0, 'f', 1));
+            previousOutput.close();
+            emit progressUpdated(100);
+            return;
+        }
+        // Reused ranges are shared with the previous output where the file
+        // system supports it, so reserving space for them would only waste it.
+        if (!previousOutput.isOpen()) {
+            output.setExpectedSize(needed);
+        }
+    }
+    output.setCacheMode(options.cacheMode);
+    const bool opened = resuming ? output.resume(resumePoint.fileBytes, resumePoint.bytesWritten) : output.open();
+    if (!opened) {
+        const QString error = output.errorString();
+        const QString outputFilePath = output.fileName();
+        output.discard();
+        emit finished(false, QCoreApplication::tr("无法创建输出文件: (Could not create output file:) ") + outputFilePath + "\n" + error);
+        emit progressUpdated(100); // Indicate process attempted completion
+        return;
+    }
+
+    firstFileByContent.clear();
+    redactor = Redactor(options.redaction); // Builds the automaton once per run
     emit progressUpdated(0);
 
+    checkpointSaved = resuming; // Its checkpoint stays valid until a newer one replaces it
+    checkpointedCount = 0;
+    if (resuming) {
+        while (processedCount < resumePoint.sourcesDone) {
+            fileDone(); // Already in the output
+        }
+        checkpointedCount = processedCount;
+    }
+    checkpointClock.start();
+
+    // An empty error message with a false result means the merge was cancelled.
+    QString errorMessage;
+    const bool merged = useIoUring() ? mergeWithIoUring(output, &errorMessage)
+                                     : mergeSynchronously(output, &errorMessage);
+    // After a checkpoint the partial output is kept for a resumed run.
+    const QString resumeNote = checkpointSaved
+                                   ? "\n" + QCoreApplication::tr("进度已保存, 可以继续合并。 (Progress was saved; the merge can be resumed.)")
+                                   : QString();
+    if (!merged) {
+        if (checkpointSaved) {
+            output.suspend();
+        } else {
+            output.discard();
+        }
+        reportProgress(true); // Where the merge stopped
+        if (errorMessage.isEmpty() || isCancelled()) { // A cancel can surface as a failed write or read
+            emit finished(false, QCoreApplication::tr("合并操作已取消。(Merge operation cancelled.)") + resumeNote);
+        } else {
+            emit finished(false, errorMessage + resumeNote);
+        }
+        emit progressUpdated(lastPercentage); // Current progress before abort
+        return;
+    }
+
+    if (isCancelled()) {
+         if (checkpointSaved) {
+             output.suspend();
+         } else {
+             output.discard();
+         }
+         emit finished(false, QCoreApplication::tr("合并操作已取消。(Merge operation cancelled before saving.)") + resumeNote);
+         return;
+    }
+
+    // The footer goes last, so the sections keep their offsets.
+    const bool footerWritten = !writeIndexFooter
+                               || output.write(BundleIndex::serialize(sectionIndex, output.bytesWritten()));
+    if (!footerWritten || !output.close()) {
+        const QString error = output.errorString();
+        const QString outputFilePath = output.resultPath();
+        output.discard();
+        emit finished(false, QCoreApplication::tr("无法写入输出文件: (Could not write output file:) ") + outputFilePath + "\n" + error);
+        emit progressUpdated(100);
+        return;
+    }
+
+    if (options.deduplicate) {
+        ContentHash::saveCache(); // Failure only costs a re-read next time
+    }
+    previousOutput.close();
+    if (redactor.isActive()) {
+        qDebug() << "MergeWorker: redacted" << redactor.matchCount() << "matches";
+    }
+    if (writeManifest) {
+        saveManifest(output.resultPath()); // Failure only costs a full merge next time
+    }
+    if (writeCheckpoints) {
+        QFile::remove(MergeCheckpoint::pathFor(output.resultPath())); // Nothing left to resume
+    }
+
+    reportProgress(true);
+    emit progressUpdated(100);
+    emit finished(true, output.resultPath()); // The index file when the output was split
+}
+
+// Upper bound of the uncompressed output, for the free space check and
+// preallocation: every source whole (or its capped ends) plus room for its
+// header and index entry. Transcoding can grow a Latin-1 source, which the
+// bound ignores; running out later still fails cleanly.
+qint64 MergeWorker::expectedOutputSize() const {
+    static constexpr qint64 SectionOverhead = 512;
+    const SourceCap &cap = options.sourceCap;
+    const qint64 cappedSize = !cap.isEnabled()               ? -1
+                              : cap.unit == SourceCap::Bytes ? cap.head + cap.tail + SectionOverhead
+                                                             : 2 * SourceReader::MaxLineEndBytes + SectionOverhead;
+    qint64 total = 0;
+    for (qint64 size : expectedSizes) {
+        total += (cappedSize >= 0 ? qMin(size, cappedSize) : size) + SectionOverhead;
+    }
+    if (options.outputLimit > 0) {
+        total = qMin(total, options.outputLimit + SectionOverhead); // Plus the note
+    }
+    return total;
+}
+
+// Whether sections go through writeTransformed() instead of being copied.
+bool MergeWorker::rewritesContent() const {
+    return options.transforms != 0 || redactor.isActive();
+}
+
+bool MergeWorker::useIoUring() const {
+    if (writeManifest) {
+        return false; // Incremental runs stat every file first and read only the changed ones
+    }
+    if (options.sourceCap.isEnabled() || options.outputLimit > 0) {
+        return false; // The ring reads whole files; capped ones must only have their ends read
+    }
+    if (options.cacheMode != CacheMode::Normal) {
+        return false; // The ring closes each file before its pages could be dropped
+    }
+    if (writeCheckpoints) {
+        return false; // Checkpoints need the stat taken before each source is read
+    }
+    switch (options.ioBackend) {
+    case MergeIoBackend::Synchronous:
+        return false;
+    case MergeIoBackend::IoUring:
+        return UringBatchReader::isSupported();
+    case MergeIoBackend::Auto:
+        break;
+    }
+    return filesToMerge.count() >= MergeOptions::IoUringMinFiles && UringBatchReader::isSupported();
+}
+
+bool MergeWorker::saveManifest(const QString &outputFilePath) {
+    manifest.outputPath = outputFilePath;
+    manifest.settings = outputSettings();
+    QString error;
+    if (!FileIdentity::forPath(outputFilePath, manifest.outputIdentity)
+        || !manifest.save(MergeManifest::pathFor(outputFilePath), &error)) {
+        qWarning() << "MergeWorker: could not write manifest for" << outputFilePath << error;
+        return false;
+    }
+    return true;
+}
+
+// Everything besides the sources themselves that decides the output bytes.
+QString MergeWorker::outputSettings() const {
+    const QByteArray redaction = (options.redaction.toText() + '\n').toUtf8() + options.redaction.replacement;
+    return QString("transcode=%1;utf16=%2;fallback=%3;transforms=%4;redaction=%5;cap=%6/%7/%8")
+        .arg(int(options.transcodeSources))
+        .arg(int(options.detectUtf16WithoutBom))
+        .arg(int(options.fallbackEncoding))
+        .arg(options.transforms)
+        .arg(options.redaction.isEmpty() ? 0 : ContentHash::xxh64(redaction.constData(), redaction.size()), 0, 16)
+        .arg(options.sourceCap.head)
+        .arg(options.sourceCap.tail)
+        .arg(int(options.sourceCap.unit));
+}
+
+// outputSettings() plus what else decides the bytes of a checkpointed output.
+QString MergeWorker::checkpointSettings() const {
+    return outputSettings() + QString(";compression=%1/%2;limit=%3")
+                                  .arg(int(options.compression))
+                                  .arg(options.compressionLevel)
+                                  .arg(options.outputLimit);
+}
+
+quint64 MergeWorker::sourceListHash() const {
+    ContentHash::Xxh64 hash;
     for (const QString &filePath : filesToMerge) {
-        if (QThread::currentThread()->isInterruptionRequested()) {
-             emit finished(false, QCoreApplication::tr("合并操作已取消。(Merge operation cancelled.)"));
-             emit progressUpdated(processedCount * 100 / fileCount); // Current progress before abort
-             return;
+        const QByteArray utf8 = filePath.toUtf8();
+        hash.add(utf8.constData(), utf8.size() + 1); // The terminating NUL separates the paths
+    }
+    return hash.digest();
+}
+
+// Adds a written source to the fingerprint a checkpoint records; a missing
+// one (skipped by the merge) counts with size -1.
+void MergeWorker::addDoneSource(const QString &filePath, const FileIdentity *identity) {
+    const QByteArray utf8 = filePath.toUtf8();
+    const qint64 stamp[2] = {identity ? identity->size : -1, identity ? identity->lastModified : 0};
+    doneSources.add(utf8.constData(), utf8.size() + 1);
+    doneSources.add(stamp, sizeof stamp);
+}
+
+// Loads the newest checkpoint in outputDir of the same sources and checks
+// that this merge can continue it: same settings, its temporary output still
+// there, and the sources it covers unchanged. Rebuilds doneSources on the
+// way. Checkpoints of other merges are passed over and kept, since those
+// merges may still be resumed; one of the same sources that fails the other
+// checks is removed together with its temporary output.
+bool MergeWorker::findResumePoint(const QString &outputDir, MergeCheckpoint *checkpoint) {
+    QString checkpointPath;
+    for (const QString &path : MergeCheckpoint::findAll(outputDir)) {
+        if (MergeCheckpoint::load(path, *checkpoint) && checkpoint->sourceCount == filesToMerge.count()
+            && checkpoint->sourceListHash == checkpointListHash) {
+            checkpointPath = path;
+            break;
+        }
+    }
+    if (checkpointPath.isEmpty()) {
+        qDebug() << "MergeWorker: no checkpoint of these sources, starting over";
+        return false;
+    }
+    // A checkpoint of these sources that cannot be continued is replaced by
+    // this run. Its partial output may be large and nothing would look at
+    // it again, so both go unless a running merge is still writing them.
+    const auto discardCheckpoint = [&checkpointPath, checkpoint]() {
+        if (!OutputClaim::isHeld(checkpoint->outputPath)) {
+            QFile::remove(MergeOutput::temporaryPath(checkpoint->outputPath));
+            QFile::remove(checkpointPath);
+        }
+    };
+    const QFileInfo temporary(MergeOutput::temporaryPath(checkpoint->outputPath));
+    if (checkpoint->settings != checkpointSettings()
+        || !checkpoint->outputPath.endsWith(".txt" + BlockCompression::fileSuffix(options.compression))
+        || !temporary.exists() || temporary.size() < checkpoint->fileBytes) {
+        qDebug() << "MergeWorker: checkpoint is for other settings or its output is gone, starting over:" << checkpointPath;
+        discardCheckpoint();
+        return false;
+    }
+    doneSources = ContentHash::Xxh64();
+    for (int i = 0; i < checkpoint->sourcesDone; ++i) {
+        FileIdentity identity;
+        const bool exists = FileIdentity::forPath(filesToMerge.at(i), identity);
+        addDoneSource(filesToMerge.at(i), exists ? &identity : nullptr);
+    }
+    if (doneSources.digest() != checkpoint->sourcesDoneHash) {
+        qDebug() << "MergeWorker: sources changed since the checkpoint, starting over:" << checkpointPath;
+        discardCheckpoint();
+        return false;
+    }
+    return true;
+}
+
+// Called between sources. Once the interval has passed since the last
+// checkpoint, the output is synced and the sources written so far are
+// recorded. A checkpoint that cannot be saved is only logged.
+bool MergeWorker::maybeCheckpoint(PartedOutput &output, QString *errorMessage) {
+    if (processedCount == checkpointedCount || checkpointClock.elapsed() < options.checkpointIntervalMs) {
+        return true;
+    }
+    MergeCheckpoint checkpoint;
+    if (!output.sync(&checkpoint.fileBytes)) {
+        *errorMessage = QCoreApplication::tr("无法写入输出文件: (Could not write output file:) ") + output.fileName() + "\n" + output.errorString();
+        return false;
+    }
+    checkpoint.outputPath = output.resultPath();
+    checkpoint.settings = checkpointSettings();
+    checkpoint.sourceCount = filesToMerge.count();
+    checkpoint.sourceListHash = checkpointListHash;
+    checkpoint.sourcesDone = processedCount;
+    checkpoint.sourcesDoneHash = doneSources.digest();
+    checkpoint.bytesWritten = output.totalBytesWritten();
+    QString error;
+    if (checkpoint.save(MergeCheckpoint::pathFor(checkpoint.outputPath), &error)) {
+        checkpointSaved = true;
+    } else {
+        qWarning() << "MergeWorker: could not save checkpoint for" << checkpoint.outputPath << error;
+    }
+    checkpointedCount = processedCount;
+    checkpointClock.restart();
+    return true;
+}
+
+// Opens the output of the newest manifest in the output directory if it
+// still is the file the manifest describes.
+void MergeWorker::openPreviousOutput(const QString &outputFilePath) {
+    previousManifest = MergeManifest();
+    const QString manifestPath = MergeManifest::findLatest(QFileInfo(outputFilePath).path());
+    if (manifestPath.isEmpty() || !MergeManifest::load(manifestPath, previousManifest)) {
+        return;
+    }
+    FileIdentity current;
+    if (previousManifest.settings != outputSettings()
+        || !FileIdentity::forPath(previousManifest.outputPath, current)
+        || !(current == previousManifest.outputIdentity)) {
+        qDebug() << "MergeWorker: previous output changed or used other settings, merging in full:" << previousManifest.outputPath;
+        previousManifest = MergeManifest();
+        return;
+    }
+    previousOutput.setFileName(previousManifest.outputPath);
+    if (!previousOutput.open(QIODevice::ReadOnly)) {
+        qWarning() << "MergeWorker: could not open previous output" << previousOutput.fileName() << previousOutput.errorString();
+        previousManifest = MergeManifest();
+        return;
+    }
+    if (QFileInfo(previousManifest.outputPath) == QFileInfo(outputFilePath)) {
+        // Same timestamp: unlink the old file so the new one gets its own
+        // inode; the open descriptor keeps the old content readable.
+        QFile::remove(previousManifest.outputPath);
+        QFile::remove(manifestPath);
+    }
+}
+
+bool MergeWorker::beginFile(PartedOutput &output, const QString &filePath, qint64 contentSize) {
+    // QFileInfo::fileName() only splits the string; it does not touch the disk.
+    const QString fileName = QFileInfo(filePath).fileName();
+    const QByteArray header = QString("\n\n========== [%1] ==========\n\n").arg(fileName).toUtf8();
+    const QByteArray continuationHeader = QString("\n\n========== [%1] (续 continued) ==========\n\n").arg(fileName).toUtf8();
+    if (!output.beginSource(filePath, header, continuationHeader, contentSize)) {
+        return false;
+    }
+    sectionOffset = output.bytesWritten();
+    return true;
+}
+
+void MergeWorker::recordSection(const PartedOutput &output, const QString &filePath) {
+    if (writeIndexFooter) {
+        BundleIndex::Entry entry;
+        entry.path = filePath;
+        entry.offset = sectionOffset;
+        entry.length = output.bytesWritten() - sectionOffset;
+        entry.hash = lastSectionHash;
+        sectionIndex.append(entry);
+    }
+}
+
+void MergeWorker::initProgress() {
+    processedCount = 0;
+    completedWeight = 0;
+    currentFileBytes = 0;
+    bytesDone = 0;
+    lastPercentage = 0;
+
+    expectedSizes = options.fileSizes;
+    if (expectedSizes.count() != filesToMerge.count()) {
+        // No sizes from the scan; one stat per file is cheap next to reading it.
+        expectedSizes.clear();
+        expectedSizes.reserve(filesToMerge.count());
+        for (const QString &filePath : filesToMerge) {
+            expectedSizes.append(qMax<qint64>(0, QFileInfo(filePath).size()));
         }
+    }
+    totalBytes = 0;
+    for (qint64 size : expectedSizes) {
+        totalBytes += size;
+    }
+    totalWeight = totalBytes + PerFileWeight * filesToMerge.count();
+
+    progressClock.start();
+    lastProgressEmitMs = -ProgressIntervalMs; // The first update goes out at once
+}
+
+void MergeWorker::addBytes(qint64 bytes) {
+    currentFileBytes += bytes;
+    bytesDone += bytes;
+    reportProgress(false);
+}
+
+void MergeWorker::fileDone() {
+    completedWeight += expectedSizes.at(processedCount) + PerFileWeight;
+    currentFileBytes = 0;
+    processedCount++;
+    reportProgress(false);
+}
+
+void MergeWorker::reportProgress(bool force) {
+    const qint64 now = progressClock.elapsed();
+    if (!force && now - lastProgressEmitMs < ProgressIntervalMs) {
+        return; // Keep cross-thread signals to about 20 per second
+    }
+    lastProgressEmitMs = now;
+
+    // A file that grew since its size was taken counts only up to that size.
+    const qint64 fileWeight = processedCount < expectedSizes.count()
+                                  ? qMin(currentFileBytes, expectedSizes.at(processedCount)) : 0;
+    const qint64 doneWeight = qMin(totalWeight, completedWeight + fileWeight);
+    const int percentage = totalWeight > 0 ? int(doneWeight * 100 / totalWeight) : 100;
+    if (percentage != lastPercentage) {
+        lastPercentage = percentage;
+        emit progressUpdated(percentage);
+    }
+
+    const double seconds = now / 1000.0;
+    const double bytesPerSecond = seconds > 0 ? bytesDone / seconds : 0.0;
+    int etaSeconds = -1;
+    if (doneWeight > 0 && seconds > 0) {
+        etaSeconds = int((totalWeight - doneWeight) * seconds / doneWeight + 0.5);
+    }
+    emit throughputUpdated(bytesDone, totalBytes, bytesPerSecond, etaSeconds);
+}
+
+bool MergeWorker::writeSource(PartedOutput &output, const char *data, qint64 size) {
+    while (size > 0) {
+        if (isCancelled()) {
+            return false;
+        }
+        const qint64 slice = qMin(size, ProgressSliceBytes);
+        if (!output.write(data, slice)) {
+            return false;
+        }
+        addBytes(slice);
+        data += slice;
+        size -= slice;
+    }
+    return true;
+}
+
+bool MergeWorker::writeDuplicateReference(PartedOutput &output, const QString &filePath, qint64 size, const QString &original) {
+    const QByteArray reference = QString("identical to [%1] (内容相同)\n").arg(original).toUtf8();
+    if (hashSections) {
+        lastSectionHash = ContentHash::xxh64(reference.constData(), reference.size());
+    }
+    if (!beginFile(output, filePath, reference.size()) || !output.write(reference)) {
+        return false;
+    }
+    addBytes(size);
+    return true;
+}
+
+// Sources that arrive whole (mapped, read into a buffer or from the ring) come
+// here, so the encoding and the final size are known before the header is
+// written; see writeFileSlice() for those that arrive in slices.
+// identity, when given, is the stat taken before reading; the content hash
+// is cached under it unless the file changed size in the meantime.
+bool MergeWorker::writeFileContent(PartedOutput &output, const QString &filePath, const char *data, qint64 size,
+                                   const FileIdentity *identity) {
+    if (options.deduplicate || writeManifest) {
+        const bool identityMatches = identity && identity->size == size;
+        quint64 hash = 0;
+        if (!identityMatches || !ContentHash::cachedHash(*identity, &hash)) {
+            hash = hashContent(data, size);
+            if (isCancelled()) {
+                return false; // Not a hash worth caching
+            }
+            if (identityMatches) {
+                ContentHash::storeHash(*identity, hash);
+            }
+        }
+        lastContentHash = hash;
+    }
+    if (options.deduplicate) {
+        const QPair<quint64, qint64> key(lastContentHash, size);
+        const auto first = firstFileByContent.constFind(key);
+        if (first != firstFileByContent.constEnd()) {
+            return writeDuplicateReference(output, filePath, size, first.value());
+        }
+        firstFileByContent.insert(key, filePath);
+    }
+
+    SourceEncoding::Kind kind = SourceEncoding::Kind::Utf8;
+    if (options.transcodeSources) {
+        kind = SourceEncoding::detect(data, size, options.detectUtf16WithoutBom, cancelFlag);
+    }
+    if (isCancelled()) {
+        return false; // kind may be a guess from a cut-short validation
+    }
+    switch (kind) {
+    case SourceEncoding::Kind::Utf8:
+        if (rewritesContent()) {
+            return writeTransformed(output, filePath, data, size, true);
+        }
+        if (hashSections) {
+            lastSectionHash = hashContent(data, size);
+        }
+        return beginFile(output, filePath, size) && writeSource(output, data, size);
+    case SourceEncoding::Kind::Utf8WithBom:
+        addBytes(3);
+        if (rewritesContent()) {
+            return writeTransformed(output, filePath, data + 3, size - 3, true);
+        }
+        if (hashSections) {
+            lastSectionHash = hashContent(data + 3, size - 3);
+        }
+        return beginFile(output, filePath, size - 3) && writeSource(output, data + 3, size - 3);
+    default:
+        break;
+    }
 
-        QFile file(filePath);
-        if (!file.exists()) {
+    const QByteArray converted = SourceEncoding::toUtf8(data, size, kind, options.fallbackEncoding);
+    if (rewritesContent()) {
+        if (!writeTransformed(output, filePath, converted.constData(), converted.size(), false)) {
+            return false;
+        }
+        addBytes(size);
+        return true;
+    }
+    if (hashSections) {
+        lastSectionHash = ContentHash::xxh64(converted.constData(), converted.size());
+    }
+    if (!beginFile(output, filePath, converted.size()) || !output.write(converted)) {
+        return false;
+    }
+    addBytes(size);
+    return true;
+}
+
+// A source that SourceReader delivers in slices (a large one that could not
+// be mapped) is written as it arrives. Its encoding is detected on the first
+// slice, so later invalid UTF-8 is copied as is, and its content hash is only
+// known after the last one: unlike a whole source it is never written as a
+// reference to an earlier duplicate, though later copies still refer to it.
+bool MergeWorker::writeFileSlice(PartedOutput &output, const QString &filePath, const char *data, qint64 size,
+                                 bool first) {
+    if (first) {
+        sourceHash = ContentHash::Xxh64();
+        sourceBytes = 0;
+        SourceEncoding::Kind kind = SourceEncoding::Kind::Utf8;
+        if (options.transcodeSources) {
+            // Leaving out a character the slice boundary may have cut in two
+            kind = SourceEncoding::detect(data, completeUtf8Prefix(data, size), options.detectUtf16WithoutBom, cancelFlag);
+        }
+        if (isCancelled()) {
+            return false;
+        }
+        sourceDecoder.reset();
+        if (kind != SourceEncoding::Kind::Utf8 && kind != SourceEncoding::Kind::Utf8WithBom) {
+            sourceDecoder.emplace(kind, options.fallbackEncoding);
+        }
+        if (!beginContent(output, filePath, expectedSizes.at(processedCount))) {
+            return false;
+        }
+        if (kind == SourceEncoding::Kind::Utf8WithBom) {
+            sourceHash.add(data, 3);
+            sourceBytes += 3;
+            addBytes(3);
+            data += 3;
+            size -= 3;
+        }
+    }
+    if (options.deduplicate || writeManifest) {
+        sourceHash.add(data, size);
+    }
+    sourceBytes += size;
+    return writeSourcePiece(output, data, size);
+}
+
+// Ends a source written by writeFileSlice().
+bool MergeWorker::finishFileSlices(PartedOutput &output, const QString &filePath, const FileIdentity *identity) {
+    if (!finishContent(output)) {
+        return false;
+    }
+    if (options.deduplicate || writeManifest) {
+        lastContentHash = sourceHash.digest();
+        if (identity && identity->size == sourceBytes) {
+            ContentHash::storeHash(*identity, lastContentHash);
+        }
+    }
+    if (options.deduplicate) {
+        const QPair<quint64, qint64> key(lastContentHash, sourceBytes);
+        if (!firstFileByContent.contains(key)) {
+            firstFileByContent.insert(key, filePath);
+        }
+    }
+    return true;
+}
+
+// Writes whole UTF-8 content through the transform stages and the redactor,
+// see beginContent(). countProgress is off when data is a conversion of the
+// source.
+bool MergeWorker::writeTransformed(PartedOutput &output, const QString &filePath, const char *data, qint64 size,
+                                   bool countProgress) {
+    return beginContent(output, filePath, size) && writeContent(output, data, size, countProgress)
+           && finishContent(output);
+}
+
+// A section's UTF-8 content written in pieces: beginContent() writes the
+// header, writeContent() streams each piece through the enabled transform
+// stages and the redactor a slice at a time into reused buffers, and
+// finishContent() writes what the stages held back at the end. The header is
+// sized by the incoming content: the stages only remove bytes, and a
+// redaction marker rarely outgrows what it replaces, so that is close enough
+// for splitting.
+bool MergeWorker::beginContent(PartedOutput &output, const QString &filePath, qint64 sizeHint) {
+    contentChain = Transform::Chain(options.transforms);
+    licensePending = options.transforms & Transform::StripLicenseHeader;
+    contentHash = ContentHash::Xxh64();
+    return beginFile(output, filePath, sizeHint);
+}
+
+bool MergeWorker::writeContent(PartedOutput &output, const char *data, qint64 size, bool countProgress) {
+    if (licensePending) {
+        // Only the start of the section can hold the header.
+        licensePending = false;
+        const qint64 headerLength = Transform::licenseHeaderLength(data, size);
+        data += headerLength;
+        size -= headerLength;
+        if (countProgress) {
+            addBytes(headerLength);
+        }
+    }
+    const qint64 sliceBytes = rewritesContent() ? TransformSliceBytes : ProgressSliceBytes;
+    while (size > 0) {
+        if (isCancelled()) {
+            return false;
+        }
+        const qint64 slice = qMin(size, sliceBytes);
+        bool written = false;
+        if (contentChain.isIdentity()) {
+            written = writeContentStage(output, data, slice, false);
+        } else {
+            transformBuffer.clear();
+            contentChain.process(data, slice, transformBuffer);
+            written = writeContentStage(output, transformBuffer.constData(), transformBuffer.size(), false);
+        }
+        if (!written) {
+            return false;
+        }
+        if (countProgress) {
+            addBytes(slice);
+        }
+        data += slice;
+        size -= slice;
+    }
+    return true;
+}
+
+// Passes what the chain produced through the redactor and writes it.
+bool MergeWorker::writeContentStage(PartedOutput &output, const char *data, qint64 size, bool endOfSource) {
+    if (redactor.isActive()) {
+        redactionBuffer.clear();
+        redactor.process(data, size, redactionBuffer);
+        if (endOfSource) {
+            redactor.finish(redactionBuffer);
+        }
+        data = redactionBuffer.constData();
+        size = redactionBuffer.size();
+    }
+    if (hashSections) {
+        contentHash.add(data, size);
+    }
+    return size == 0 || output.write(data, size);
+}
+
+bool MergeWorker::finishContent(PartedOutput &output) {
+    transformBuffer.clear();
+    contentChain.finish(transformBuffer);
+    if (!writeContentStage(output, transformBuffer.constData(), transformBuffer.size(), true)) {
+        return false;
+    }
+    if (hashSections) {
+        lastSectionHash = contentHash.digest();
+    }
+    return true;
+}
+
+// Writes a piece of the source being sliced or capped, decoded to UTF-8
+// first when sourceDecoder is set. Decoding goes a slice at a time, so the
+// converted text stays small and a cancel is seen in between.
+bool MergeWorker::writeSourcePiece(PartedOutput &output, const char *data, qint64 size) {
+    if (!sourceDecoder) {
+        return writeContent(output, data, size, true);
+    }
+    while (size > 0) {
+        if (isCancelled()) {
+            return false;
+        }
+        const qint64 slice = qMin(size, ProgressSliceBytes);
+        const QByteArray converted = sourceDecoder->toUtf8(data, slice);
+        if (!writeContent(output, converted.constData(), converted.size(), false)) {
+            return false;
+        }
+        addBytes(slice);
+        data += slice;
+        size -= slice;
+    }
+    return true;
+}
+
+// Writes the kept ends of a source longer than cap with a marker between
+// them; *capped is false when the source fits and nothing was written. The
+// ends stream from the reader like any source, and both go through the
+// transforms as one section. The encoding is detected on the first piece of
+// the head, the cut points are moved to character boundaries (a surrogate
+// pair cut in two is dropped), and each end is decoded on its own.
+bool MergeWorker::writeCappedContent(PartedOutput &output, SourceReader &reader, const QString &filePath,
+                                     const SourceCap &cap, bool *capped) {
+    SourceReader::Ends ends;
+    SourceEncoding::Kind kind = SourceEncoding::Kind::Utf8;
+    bool begun = false;
+    bool markerWritten = false;
+    qint64 headDone = 0; // Head bytes delivered so far
+    qint64 omitted = 0;  // Besides the middle: bytes of characters cut at either end
+
+    const auto isUtf16 = [&kind]() {
+        return kind == SourceEncoding::Kind::Utf16LE || kind == SourceEncoding::Kind::Utf16BE;
+    };
+    const auto begin = [&](const char *data, qint64 size) {
+        begun = true;
+        if (options.transcodeSources && size > 0) {
+            kind = SourceEncoding::detect(data, completeUtf8Prefix(data, size), options.detectUtf16WithoutBom, cancelFlag);
+        }
+        if (isCancelled()) {
+            return false; // kind may be a guess from a cut-short validation
+        }
+        sourceDecoder.reset();
+        if (kind != SourceEncoding::Kind::Utf8 && kind != SourceEncoding::Kind::Utf8WithBom) {
+            sourceDecoder.emplace(kind, options.fallbackEncoding);
+        }
+        return beginContent(output, filePath, ends.headLength + ends.tailLength);
+    };
+    // Counts the middle and the cut characters as done: they are skipped, not pending.
+    const auto writeMarker = [&]() {
+        markerWritten = true;
+        addBytes(ends.omitted);
+        const QByteArray marker = QString("\n\n[... 已省略 %1 字节 (%1 bytes omitted) ...]\n\n")
+                                      .arg(ends.omitted + omitted).toUtf8();
+        return writeContent(output, marker.constData(), marker.size(), false);
+    };
+
+    const SourceReader::ChunkHandler writeHead = [&](const char *data, qint64 size) {
+        const bool first = headDone == 0;
+        headDone += size;
+        if (first) {
+            if (!begin(data, size)) {
+                return false;
+            }
+            if (kind == SourceEncoding::Kind::Utf8WithBom) {
+                addBytes(3);
+                data += 3;
+                size -= 3;
+            }
+        }
+        if (headDone == ends.headLength) {
+            // The last piece: keep whole characters
+            const qint64 kept = isUtf16() ? size - ends.headLength % 2 : completeUtf8Prefix(data, size);
+            omitted += size - kept;
+            addBytes(size - kept);
+            size = kept;
+        }
+        return writeSourcePiece(output, data, size);
+    };
+    const SourceReader::ChunkHandler writeTail = [&](const char *data, qint64 size) {
+        if (!markerWritten) {
+            // The first piece: start at a whole character, decoded afresh
+            const qint64 skipped = isUtf16() ? ends.tailOffset % 2 : utf8ContinuationLength(data, size);
+            omitted += skipped;
+            addBytes(skipped);
+            data += skipped;
+            size -= skipped;
+            if ((!begun && !begin(nullptr, 0)) || !writeMarker()) {
+                return false;
+            }
+            if (sourceDecoder) {
+                sourceDecoder.emplace(kind, options.fallbackEncoding);
+            }
+        }
+        return writeSourcePiece(output, data, size);
+    };
+
+    *capped = false;
+    if (!reader.readEnds(filePath, cap, &ends, writeHead, writeTail)) {
+        return false;
+    }
+    *capped = ends.truncated;
+    if (!ends.truncated) {
+        return true;
+    }
+    if (!begun && !begin(nullptr, 0)) {
+        return false;
+    }
+    return (markerWritten || writeMarker()) && finishContent(output);
+}
+
+// The cap for the next source: the configured one, or a head-only cut to
+// what is left of the output limit when the source would not fit (then
+// cutByLimit is set).
+SourceCap MergeWorker::capFor(qint64 sourceSize, qint64 outputRoom, bool *cutByLimit) const {
+    const SourceCap &configured = options.sourceCap;
+    *cutByLimit = false;
+    if (outputRoom < 0 || sourceSize <= outputRoom) {
+        return configured;
+    }
+    if (configured.isEnabled() && configured.unit == SourceCap::Bytes && configured.head + configured.tail <= outputRoom) {
+        return configured;
+    }
+    *cutByLimit = true;
+    SourceCap cap;
+    cap.head = outputRoom;
+    return cap;
+}
+
+bool MergeWorker::appendFile(PartedOutput &output, SourceReader &reader, const QString &filePath, QString *errorMessage,
+                             const FileIdentity *identity, const SourceCap &cap) {
+    if (cap.isEnabled()) {
+        // Only the kept ends are read; a file within the cap is read whole below.
+        bool capped = false;
+        if (!writeCappedContent(output, reader, filePath, cap, &capped)) {
+            const QString error = output.errorString().isEmpty() ? reader.errorString() : output.errorString();
+            *errorMessage = QCoreApplication::tr("无法读取文件: (Could not read file:) ") + filePath + "\n" + error;
+            return false;
+        }
+        if (capped) {
+            return true;
+        }
+    }
+
+    bool delivered = false;
+    const SourceReader::ChunkHandler writeChunk = [&](const char *data, qint64 size) {
+        const bool first = !delivered;
+        delivered = true;
+        if (reader.lastReadWasSliced()) {
+            return writeFileSlice(output, filePath, data, size, first);
+        }
+        return writeFileContent(output, filePath, data, size, identity);
+    };
+    // Empty files produce no chunk but still get their header.
+    lastSectionHash = ContentHash::xxh64(nullptr, 0);
+    if (!reader.read(filePath, writeChunk)
+        || (delivered && reader.lastReadWasSliced() && !finishFileSlices(output, filePath, identity))
+        || (!delivered && !beginFile(output, filePath, 0))) {
+        // A failing write also stops the reader; report whichever side failed.
+        const QString error = output.errorString().isEmpty() ? reader.errorString() : output.errorString();
+        *errorMessage = QCoreApplication::tr("无法读取文件: (Could not read file:) ") + filePath + "\n" + error;
+        return false;
+    }
+    return true;
+}
+
+bool MergeWorker::mergeSynchronously(PartedOutput &output, QString *errorMessage) {
+    SourceReader reader(options.mapThreshold);
+    reader.setDropCache(options.cacheMode != CacheMode::Normal);
+
+    // A resumed merge starts after the sources its checkpoint covers.
+    for (int index = processedCount; index < filesToMerge.count(); ++index) {
+        const QString &filePath = filesToMerge.at(index);
+        if (isCancelled()) {
+            return false;
+        }
+        if (writeCheckpoints && !maybeCheckpoint(output, errorMessage)) {
+            return false;
+        }
+
+        qint64 outputRoom = -1; // No output limit
+        if (options.outputLimit > 0) {
+            outputRoom = options.outputLimit - output.totalBytesWritten();
+            if (outputRoom <= 0) {
+                return writeOutputLimitNote(output, errorMessage);
+            }
+        }
+
+        // With deduplication or a manifest the stat doubles as the existence
+        // check and as the key into the hash cache and the previous manifest;
+        // checkpoints record it.
+        const bool needIdentity = options.deduplicate || writeManifest || writeCheckpoints;
+        FileIdentity identity;
+        const bool exists = needIdentity ? FileIdentity::forPath(filePath, identity)
+                                         : QFileInfo::exists(filePath);
+        if (!exists) {
             qWarning() << "File does not exist, skipping:" << filePath;
             // Optionally collect these errors and report them
             // For now, just skip and continue
-            processedCount++;
-            emit progressUpdated((processedCount * 100) / fileCount);
+            if (writeCheckpoints) {
+                addDoneSource(filePath, nullptr);
+            }
+            fileDone();
             continue;
         }
-        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            emit finished(false, QCoreApplication::tr("无法读取文件: (Could not read file:) ") + filePath + "\n" + file.errorString());
-            emit progressUpdated((processedCount * 100) / fileCount);
-            return;
+
+        if (options.deduplicate && identity.size > 0) {
+            // A known duplicate is not read at all.
+            quint64 hash = 0;
+            if (ContentHash::cachedHash(identity, &hash)) {
+                const auto first = firstFileByContent.constFind(qMakePair(hash, identity.size));
+                if (first != firstFileByContent.constEnd()) {
+                    if (!writeDuplicateReference(output, filePath, identity.size, first.value())) {
+                        *errorMessage = QCoreApplication::tr("无法写入输出文件: (Could not write output file:) ") + output.fileName() + "\n" + output.errorString();
+                        return false;
+                    }
+                    recordSection(output, filePath);
+                    fileDone();
+                    continue;
+                }
+            }
         }
 
-        QFileInfo fileInfo(filePath);
-        mergedContent.append(QString("\n\n========== [%1] ==========\n\n").arg(fileInfo.fileName()));
+        MergeManifest::Entry entry;
+        entry.path = filePath;
+        entry.identity = identity;
+        entry.offset = output.bytesWritten();
 
-        QTextStream in(&file);
-        mergedContent.append(in.readAll());
-        file.close();
+        const MergeManifest::Entry *previous = previousOutput.isOpen() ? previousManifest.find(filePath) : nullptr;
+        bool cutByLimit = false;
+        if (previous && previous->identity == identity && (outputRoom < 0 || previous->length <= outputRoom)) {
+            // Unchanged since the previous run: copy its range, header included.
+            if (!output.appendSourceRange(filePath, previousOutput, previous->offset, previous->length)) {
+                *errorMessage = QCoreApplication::tr("无法写入输出文件: (Could not write output file:) ") + output.fileName() + "\n" + output.errorString();
+                return false;
+            }
+            addBytes(identity.size);
+            entry.hash = previous->hash;
+            sectionOffset = entry.offset + previous->headerLength;
+            lastSectionHash = previous->contentHash;
+        } else {
+            lastContentHash = ContentHash::xxh64(nullptr, 0); // Empty files never reach writeFileContent()
+            const SourceCap cap = capFor(expectedSizes.at(processedCount), outputRoom, &cutByLimit);
+            if (!appendFile(output, reader, filePath, errorMessage, needIdentity ? &identity : nullptr, cap)) {
+                return false;
+            }
+            entry.hash = lastContentHash;
+        }
 
-        processedCount++;
-        emit progressUpdated((processedCount * 100) / fileCount);
+        recordSection(output, filePath);
+        if (writeManifest && !cutByLimit) {
+            // A source cut by the output limit is left out, so that a later
+            // run with more room reads it again instead of copying the cut.
+            entry.length = output.bytesWritten() - entry.offset;
+            entry.headerLength = sectionOffset - entry.offset;
+            entry.contentHash = lastSectionHash;
+            manifest.entries.append(entry);
+        }
+        if (writeCheckpoints) {
+            addDoneSource(filePath, &identity);
+        }
+        fileDone();
     }
+    return true;
+}
 
-    if (QThread::currentThread()->isInterruptionRequested()) {
-         emit finished(false, QCoreApplication::tr("合并操作已取消。(Merge operation cancelled before saving.)"));
-         return;
+// Ends the output early, saying how many sources were left out.
+bool MergeWorker::writeOutputLimitNote(PartedOutput &output, QString *errorMessage) {
+    const int skipped = filesToMerge.count() - processedCount;
+    qDebug() << "MergeWorker: output limit reached, leaving out" << skipped << "files";
+    const QByteArray note = QString("\n\n========== 已达到输出上限, 其余 %1 个文件未合并 (Output limit reached, %1 more files left out) ==========\n")
+                                .arg(skipped).toUtf8();
+    if (!output.write(note)) {
+        *errorMessage = QCoreApplication::tr("无法写入输出文件: (Could not write output file:) ") + output.fileName() + "\n" + output.errorString();
+        return false;
     }
+    return true;
+}
 
-    QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd_HH-mm-ss");
-    QString outputFilename = QString("collated_files_%1.txt").arg(timestamp);
-    QString outputFilePath = QDir(outputPathBase).filePath(outputFilename);
+// Small files arrive from the ring already read, in input order; a missing
+// file shows up as ENOENT instead of a separate exists() call. Files that fill
+// the ring's buffer are read again through SourceReader.
+bool MergeWorker::mergeWithIoUring(PartedOutput &output, QString *errorMessage) {
+    UringBatchReader uring;
+    if (!uring.isValid()) {
+        qDebug() << "MergeWorker: io_uring setup failed, using synchronous reads:" << uring.errorString();
+        return mergeSynchronously(output, errorMessage);
+    }
 
-    QFile outputFile(outputFilePath);
-    if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
-        emit finished(false, QCoreApplication::tr("无法创建输出文件: (Could not create output file:) ") + outputFilePath + "\n" + outputFile.errorString());
-        emit progressUpdated(100); // Indicate process attempted completion
-        return;
+    QList<QByteArray> encodedPaths;
+    encodedPaths.reserve(filesToMerge.count());
+    for (const QString &filePath : filesToMerge) {
+        encodedPaths.append(QFile::encodeName(filePath));
     }
 
-    QTextStream out(&outputFile);
-    out << mergedContent;
-    outputFile.close();
+    SourceReader reader(options.mapThreshold);
+    const bool ok = uring.run(encodedPaths, [&](const UringBatchReader::Result &result) {
+        if (isCancelled()) {
+            return false;
+        }
+        const QString &filePath = filesToMerge.at(result.index);
+        if (result.error == ENOENT) {
+            qWarning() << "File does not exist, skipping:" << filePath;
+            fileDone();
+            return true;
+        }
+        if (result.error != 0) {
+            *errorMessage = QCoreApplication::tr("无法读取文件: (Could not read file:) ") + filePath + "\n"
+                          + QString::fromLocal8Bit(strerror(result.error));
+            return false;
+        }
+        // A file larger than the buffer, or a read that came back short (or
+        // a file that changed since the scan), is read again synchronously.
+        if (result.truncated || result.size != expectedSizes.at(result.index)) {
+            if (!result.truncated) {
+                qDebug() << "MergeWorker: io_uring read" << result.size << "of" << expectedSizes.at(result.index)
+                         << "bytes, reading again:" << filePath;
+            }
+            if (!appendFile(output, reader, filePath, errorMessage)) {
+                return false;
+            }
+        } else if (!writeFileContent(output, filePath, result.data, result.size)) {
+            *errorMessage = QCoreApplication::tr("无法写入输出文件: (Could not write output file:) ") + output.fileName() + "\n" + output.errorString();
+            return false;
+        }
+        recordSection(output, filePath);
+        fileDone();
+        return true;
+    });
 
-    emit progressUpdated(100);
-    emit finished(true, outputFilePath);
+    if (!ok && errorMessage->isEmpty() && !isCancelled()) {
+        *errorMessage = QCoreApplication::tr("io_uring 读取失败: (io_uring read failed:) ") + uring.errorString();
+    }
+    return ok;
 }
 
 
 // --- FileMergerLogic Implementation ---
-FileMergerLogic::FileMergerLogic(QObject *parent) : QObject(parent), workerThread(nullptr), worker(nullptr)
+FileMergerLogic::FileMergerLogic(QObject *parent) : QObject(parent), nextJobId(1), closing(false)
 {
+    pool.setMaxThreadCount(1);
+    pool.setExpiryTimeout(-1); // Threads wait for the next job instead of exiting
 }
 
 FileMergerLogic::~FileMergerLogic()
 {
-    if (workerThread) {
-        if (workerThread->isRunning()) {
-            workerThread->requestInterruption(); // Request interruption
-            workerThread->quit(); // Request thread to quit
-            if (!workerThread->wait(3000)) { // Wait for max 3 seconds
-                 qWarning() << "Worker thread did not quit gracefully, terminating.";
-                 workerThread->terminate();
-                 workerThread->wait(); // Wait for termination
-            }
-        }
-        delete workerThread; // QThread should be deleted after worker
-        workerThread = nullptr;
-    }
-    // Worker object (worker) is moved to the thread and should be deleted
-    // when the thread finishes via QObject::deleteLater.
-    // If worker was not deleted for some reason, it would be a leak.
-    // The connections worker->deleteLater() and thread->deleteLater() handle this.
-     if(worker) { // Should have been deleted by deleteLater
-        qWarning() << "Worker object was not deleted by thread finishing, deleting now.";
-        delete worker; // Fallback, though typically deleteLater should handle it.
-        worker = nullptr;
+    {
+        QMutexLocker locker(&jobsMutex);
+        closing = true; // Merges that pipelines reach from now on start cancelled
     }
+    cancelAll();
+    pool.waitForDone(); // Signals still queued for this object are dropped with it
 }
 
-void FileMergerLogic::startMergeProcess(const QStringList &files, const QString &outputDir)
+int FileMergerLogic::queueMerge(const QStringList &files, const QString &outputDir, const MergeOptions &options)
 {
-    if (workerThread && workerThread->isRunning()) {
-        emit statusUpdated(QCoreApplication::tr("合并操作已在进行中。 (Merge operation already in progress.)"));
-        return;
-    }
+    return queueJob([files](MergeOptions &) { return files; }, outputDir, options);
+}
 
-    // Clean up previous thread and worker if they exist and didn't self-delete
-    // This is a safeguard; deleteLater connections should handle it.
-    if (workerThread) {
-        qDebug() << "Previous workerThread found, deleting it.";
-        delete workerThread; // This will also trigger worker's deleteLater if connected
-        workerThread = nullptr;
-        worker = nullptr; // Worker should be null after thread deletion
-    }
+int FileMergerLogic::queueMerge(const SelectionSnapshot &selection, const QString &outputDir, const MergeOptions &options)
+{
+    return queueJob([selection](MergeOptions &jobOptions) {
+        jobOptions.fileSizes.clear();
+        return selection.paths(&jobOptions.fileSizes);
+    }, outputDir, options);
+}
 
+int FileMergerLogic::queueJob(const FileList &files, const QString &outputDir, const MergeOptions &options)
+{
+    const auto cancelled = std::make_shared<std::atomic_bool>(false);
+    const bool waits = activeJobCount() >= pool.maxThreadCount();
+    const int jobId = addJob(cancelled);
+    pool.start([this, jobId, files, outputDir, options, cancelled]() {
+        runJob(jobId, files, outputDir, options, cancelled);
+    });
+    emit statusUpdated(waits ? QCoreApplication::tr("合并任务 #%1 已排队。 (Merge #%1 queued.)").arg(jobId)
+                             : QCoreApplication::tr("开始合并任务 #%1... (Starting merge #%1...)").arg(jobId));
+    return jobId;
+}
 
-    workerThread = new QThread(this); // Parent thread to FileMergerLogic for safety if not deleted properly
-    worker = new MergeWorker(files, outputDir);
+int FileMergerLogic::addJob(const std::shared_ptr<std::atomic_bool> &cancelled)
+{
+    QMutexLocker locker(&jobsMutex);
+    const int jobId = nextJobId++;
+    if (closing) {
+        cancelled->store(true);
+    }
+    jobs.insert(jobId, cancelled);
+    return jobId;
+}
 
-    worker->moveToThread(workerThread);
+// Runs on a pool thread.
+void FileMergerLogic::runJob(int jobId, const FileList &files, const QString &outputDir, MergeOptions options,
+                             const std::shared_ptr<std::atomic_bool> &cancelled)
+{
+    MergeResult result;
+    if (cancelled->load()) {
+        result.jobId = jobId;
+        result.messageOrPath = QCoreApplication::tr("合并操作已取消。(Merge operation cancelled.)");
+        result.cancelled = true;
+    } else {
+        const QStringList paths = files(options); // A snapshot's list is built here, off the UI thread
+        result = runWorker(jobId, paths, outputDir, options, cancelled);
+    }
+    QMetaObject::invokeMethod(this, [this, result]() { finishJob(result); }, Qt::QueuedConnection);
+}
 
-    // Connections for thread lifecycle and worker signals
-    connect(workerThread, &QThread::started, worker, &MergeWorker::process);
-    connect(worker, &MergeWorker::finished, this, &FileMergerLogic::handleMergeWorkerFinished);
-    connect(worker, &MergeWorker::progressUpdated, this, &FileMergerLogic::handleProgressUpdate);
+// Runs on a pool thread. The worker lives on the stack; its progress reaches
+// the receivers through queued connections, tagged with the job id.
+MergeResult FileMergerLogic::runWorker(int jobId, const QStringList &paths, const QString &outputDir, const MergeOptions &options,
+                                       const std::shared_ptr<std::atomic_bool> &cancelled)
+{
+    MergeResult result;
+    result.jobId = jobId;
+    MergeWorker worker(paths, outputDir, options);
+    worker.setCancelFlag(cancelled.get());
+    connect(&worker, &MergeWorker::progressUpdated, this, [this, jobId](int percentage) {
+        emit jobProgress(jobId, percentage);
+    });
+    connect(&worker, &MergeWorker::throughputUpdated, this,
+            [this, jobId](qint64 bytesDone, qint64 bytesTotal, double bytesPerSecond, int etaSeconds) {
+        emit jobThroughput(jobId, bytesDone, bytesTotal, bytesPerSecond, etaSeconds);
+    });
+    connect(&worker, &MergeWorker::finished, &worker, [&result, &cancelled](bool success, const QString &messageOrPath) {
+        result.success = success;
+        result.messageOrPath = messageOrPath;
+        result.cancelled = !success && cancelled->load();
+    }, Qt::DirectConnection);
+    QMetaObject::invokeMethod(this, [this, jobId]() { emit jobStarted(jobId); }, Qt::QueuedConnection);
+    worker.process();
+    return result;
+}
 
-    // When the worker is done, it emits finished(), which is connected to handleMergeWorkerFinished.
-    // In handleMergeWorkerFinished, we can request the thread to quit.
-    // And when the thread finishes, it should clean up the worker and itself.
-    connect(worker, &MergeWorker::finished, worker, &QObject::deleteLater); // Worker cleans itself up
-    connect(workerThread, &QThread::finished, workerThread, &QObject::deleteLater); // Thread cleans itself up
+void FileMergerLogic::finishJob(const MergeResult &result)
+{
+    {
+        QMutexLocker locker(&jobsMutex);
+        jobs.remove(result.jobId);
+    }
+    emit jobFinished(result.jobId, result.success, result.messageOrPath, result.cancelled);
+}
 
+Task<SelectionSnapshot> FileMergerLogic::scanFolder(QString rootPath)
+{
+    co_await AsyncTask::resumeOn(pool);
 
-    // Also connect thread's finished signal to nullify our pointers
-    // to avoid dangling pointers if the thread finishes unexpectedly.
-    connect(workerThread, &QThread::finished, [this](){
-        qDebug() << "Worker thread finished signal received. Worker pointer:" << worker << "Thread pointer:" << workerThread;
-        // Objects are scheduled for deletion, so we nullify our tracking pointers.
-        // Do not delete them here again if deleteLater is connected.
-        this->worker = nullptr;
-        this->workerThread = nullptr;
-        qDebug() << "Worker and workerThread pointers nullified.";
+    // The same walk as CustomFileModel::setupModelData(), so the files come
+    // in the order of the tree.
+    QStringList paths;
+    QList<qint64> sizes;
+    const std::function<void(const QString &)> scanDirectory = [&](const QString &path) {
+        QDir dir(path);
+        dir.setFilter(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::Readable);
+        dir.setSorting(QDir::Name | QDir::DirsFirst);
+        const QFileInfoList entries = dir.entryInfoList();
+        for (const QFileInfo &entryInfo : entries) {
+            if (entryInfo.isDir()) {
+                scanDirectory(entryInfo.filePath());
+            } else if (entryInfo.isFile()) {
+                paths.append(entryInfo.filePath());
+                sizes.append(entryInfo.size());
+            }
+        }
+    };
+    if (QDir(rootPath).exists()) {
+        scanDirectory(rootPath);
+    } else {
+        qWarning() << "Directory does not exist:" << rootPath;
+    }
+    const int count = int(paths.size());
+    co_return SelectionSnapshot(QBitArray(count, true), paths, sizes, count);
+}
+
+Task<SelectionSnapshot> FileMergerLogic::skipBinaryFiles(SelectionSnapshot selection)
+{
+    co_await AsyncTask::resumeOn(pool);
+    co_return selection.filtered([](const QString &path, qint64) {
+        return FileClassifier::classifyFile(path) != FileClassifier::Binary; // Cached per file identity
     });
+}
 
+Task<MergeResult> FileMergerLogic::merge(SelectionSnapshot selection, QString outputDir, MergeOptions options)
+{
+    co_await AsyncTask::resumeOn(pool);
+    const auto cancelled = std::make_shared<std::atomic_bool>(false);
+    const int jobId = addJob(cancelled);
+    options.fileSizes.clear();
+    const QStringList paths = selection.paths(&options.fileSizes);
+    MergeResult result = runWorker(jobId, paths, outputDir, options, cancelled);
+    QMetaObject::invokeMethod(this, [this, result]() { finishJob(result); }, Qt::QueuedConnection);
+    co_return result; // Moved on to the next step
+}
 
-    workerThread->start();
-    emit statusUpdated(QCoreApplication::tr("开始文件合并线程... (Starting file merge thread...)"));
+void FileMergerLogic::cancelJob(int jobId)
+{
+    {
+        QMutexLocker locker(&jobsMutex);
+        const auto job = jobs.constFind(jobId);
+        if (job == jobs.constEnd()) {
+            return; // Already finished
+        }
+        job.value()->store(true); // The worker polls this between slices
+    }
+    emit statusUpdated(QCoreApplication::tr("正在取消合并任务 #%1... (Cancelling merge #%1...)").arg(jobId));
 }
 
-void FileMergerLogic::handleMergeWorkerFinished(bool success, const QString &messageOrPath)
+void FileMergerLogic::cancelAll()
 {
-    emit mergeFinished(success, messageOrPath); // Forward signal to MainWindow
+    QMutexLocker locker(&jobsMutex);
+    for (const std::shared_ptr<std::atomic_bool> &cancelled : std::as_const(jobs)) {
+        cancelled->store(true);
+    }
+}
 
-    // Thread and worker will be deleted due to deleteLater connections.
-    // We request the thread to quit, which will eventually lead to its 'finished' signal.
-    if (workerThread && workerThread->isRunning()) {
-        workerThread->quit();
+bool FileMergerLogic::isCancelling() const
+{
+    QMutexLocker locker(&jobsMutex);
+    for (const std::shared_ptr<std::atomic_bool> &cancelled : jobs) {
+        if (cancelled->load()) {
+            return true;
+        }
     }
-    // Pointers are nullified in the QThread::finished lambda connection.
+    return false;
+}
+
+void FileMergerLogic::setMaxConcurrentMerges(int count)
+{
+    pool.setMaxThreadCount(qMax(1, count));
 }
 
-void FileMergerLogic::handleProgressUpdate(int percentage) {
-    emit progressUpdated(percentage); // Forward to MainWindow
-} 
\ No newline at end of file
+int FileMergerLogic::maxConcurrentMerges() const
+{
+    return pool.maxThreadCount();
+}
+
+int FileMergerLogic::activeJobCount() const
+{
+    QMutexLocker locker(&jobsMutex);
+    return jobs.count();
+}
@@ -5,50 +5,367 @@
 
 #include <QObject>
 #include <QStringList>
+#include <QList>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPair>
+#include <QStringConverter>
+#include <QThreadPool>
+#include <QMutex>
+#include <QPointer>
+#include "mergeio.h"
+#include "fileidentity.h"
+#include "mergemanifest.h"
+#include "mergecheckpoint.h"
+#include "contenthash.h"
+#include "bundleindex.h"
+#include "transformchain.h"
+#include "redaction.h"
+#include "selectionsnapshot.h"
+#include "sourceencoding.h"
+#include "asynctask.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
 
 class QThread; // Forward declaration
 
+// How source files are read.
+enum class MergeIoBackend {
+    Auto,        // io_uring for large batches when the kernel supports it
+    Synchronous, // One file at a time through SourceReader
+    IoUring      // Batched io_uring whenever supported (falls back otherwise)
+};
+
+// What MergeOptions::splitLimit counts.
+enum class SplitUnit {
+    Bytes,
+    Tokens // Estimated as BytesPerToken bytes each, the usual rule of thumb for LLM tokenizers
+};
+
+// Tunables for a merge run. Defaults are what the GUI uses.
+struct MergeOptions {
+    // With Auto, batches smaller than this are not worth setting up a ring for.
+    static constexpr int IoUringMinFiles = 64;
+
+    MergeIoBackend ioBackend = MergeIoBackend::Auto;
+
+    // Sizes of the files to merge, in the same order, as recorded by the scan.
+    // When the count does not match the file list the worker stats each file.
+    QList<qint64> fileSizes;
+
+    // The output is UTF-8. Valid UTF-8 sources are copied byte for byte (minus
+    // a BOM); others are converted: UTF-16 by BOM or NUL pattern, anything else
+    // from fallbackEncoding. With transcodeSources off every source is copied raw.
+    bool transcodeSources = true;
+    bool detectUtf16WithoutBom = true;
+    QStringConverter::Encoding fallbackEncoding = QStringConverter::Latin1;
+
+    // Compress the output while it is written (adds .gz / .zst to its name).
+    OutputCompression compression = OutputCompression::None;
+    int compressionLevel = -1; // Library default
+
+    // Cap each output part at this many bytes or estimated tokens (0: one file).
+    // Parts are named ..._part-001.txt and listed in ..._index.txt.
+    static constexpr qint64 BytesPerToken = PartedOutput::BytesPerToken;
+    qint64 splitLimit = 0;
+    SplitUnit splitUnit = SplitUnit::Bytes;
+    qint64 partLimitBytes() const { return splitUnit == SplitUnit::Tokens ? splitLimit * BytesPerToken : splitLimit; }
+
+    // Write sources whose content was already merged once as a short
+    // reference to the first copy. Content hashes are cached by file identity
+    // (device, inode, size, mtime) across runs, so an unchanged duplicate is
+    // recognized without being read.
+    bool deduplicate = false;
+
+    // Write <output>.manifest.json and, when the newest manifest in the output
+    // directory was made with the same settings, copy every unchanged source's
+    // range from that previous output instead of reading the source again.
+    // Only for uncompressed, unsplit output without deduplication (a
+    // reference depends on other sources), and always with synchronous reads.
+    bool incremental = false;
+
+    // End the output with an index of every section's path, offset, length
+    // and hash (see BundleIndex), so BundleReader or "FileMergerApp --extract"
+    // can find one source with a seek. Uncompressed, unsplit output only.
+    bool indexFooter = false;
+
+    // Transform::Stage flags applied to each source's UTF-8 content as it is
+    // written (after transcoding), e.g. CRLF to LF or dropping license
+    // headers. Sections then hold the transformed text.
+    Transform::Stages transforms = 0;
+
+    // Literals and patterns replaced in every section after the transforms,
+    // as the content streams through (see Redactor).
+    RedactionRules redaction;
+
+    // Keep only the first sourceCap.head and last sourceCap.tail bytes or
+    // lines of larger sources, with a marker naming the bytes left out; only
+    // the kept ends are read. Stop adding sources once the output holds
+    // outputLimit bytes (0: no limit), cutting the one that crosses it and
+    // noting how many were left out; the merge still succeeds. Either one
+    // means synchronous reads.
+    SourceCap sourceCap;
+    qint64 outputLimit = 0;
+
+    // Source files at least this large are memory-mapped, smaller ones are
+    // read with a single pread() into a reused buffer. Files that are not
+    // mapped and larger than SourceReader::ReadSliceBytes are read and
+    // written a slice at a time.
+    qint64 mapThreshold = SourceReader::DefaultMapThreshold;
+
+    // Keep the merge from flooding the page cache on shared machines: drop
+    // sources and written output from the cache as the merge goes, and
+    // optionally bypass it for the output (see CacheMode). Means synchronous
+    // reads, since the ring closes each file before the merge sees it.
+    CacheMode cacheMode = CacheMode::Normal;
+
+    // Save a checkpoint (see MergeCheckpoint) at least every
+    // checkpointIntervalMs (0: after every source), and keep the temporary
+    // output of a merge that fails or is cancelled after one. With resume, a
+    // merge looks for the newest checkpoint of its sources in the output
+    // directory (passing over other merges'); if the settings match too, it
+    // cuts that output back to it and continues with the next source,
+    // provided the sources already written still have their recorded sizes
+    // and modification times; otherwise it starts over.
+    // Unsplit output without deduplication, incremental re-merge or index
+    // footer only (those keep state per source), and synchronous reads.
+    bool checkpointing = false;
+    int checkpointIntervalMs = 30 * 1000;
+    bool resume = false;
+};
+
 // Worker class that will run in a separate thread
 class MergeWorker : public QObject {
     Q_OBJECT
 public:
-    MergeWorker(const QStringList &files, const QString &outputPath);
+    MergeWorker(const QStringList &files, const QString &outputPath, const MergeOptions &options = MergeOptions());
     ~MergeWorker();
 
+    // Once *flag is set (from any thread) the merge stops at the next slice,
+    // removes its partial output and reports a cancellation. The flag must
+    // outlive process(). An interruption request on the worker's thread has
+    // the same effect.
+    void setCancelFlag(const std::atomic_bool *flag);
+
 public slots:
     void process(); // This is the slot that will be called when the thread starts
 
 signals:
     void finished(bool success, const QString &messageOrPath);
     void progressUpdated(int percentage);
+    // Bytes of source data merged so far, the average rate and the estimated
+    // seconds left (-1 while unknown). Throttled like progressUpdated.
+    void throughputUpdated(qint64 bytesDone, qint64 bytesTotal, double bytesPerSecond, int etaSeconds);
 
 private:
+    // Progress is weighted by file size plus a fixed per-file cost, so both a
+    // single huge file and a million empty ones advance the bar smoothly.
+    static constexpr qint64 PerFileWeight = 4096;
+    static constexpr qint64 ProgressIntervalMs = 50;
+    // Large mapped blocks are hashed and written in slices of this size so
+    // progress moves, and cancellation is seen, within one file.
+    static constexpr qint64 ProgressSliceBytes = 8 * 1024 * 1024;
+    // Input fed to the transform chain at a time; small enough that input and
+    // output stay in cache between the kernel and the write.
+    static constexpr qint64 TransformSliceBytes = 256 * 1024;
+
     QStringList filesToMerge;
     QString outputPathBase; // e.g., Desktop path
+    MergeOptions options;
+    const std::atomic_bool *cancelFlag;
+    int processedCount;
+
+    QList<qint64> expectedSizes; // Per file, from options.fileSizes or a stat
+    qint64 totalBytes;
+    qint64 totalWeight;
+    qint64 completedWeight;  // Weight of all finished files
+    qint64 currentFileBytes; // Bytes written so far for the file in progress
+    qint64 bytesDone;
+    QElapsedTimer progressClock;
+    qint64 lastProgressEmitMs;
+    int lastPercentage;
+
+    // First file seen with a given (content hash, size), for deduplication.
+    QHash<QPair<quint64, qint64>, QString> firstFileByContent;
+    quint64 lastContentHash; // Of the source last passed to writeFileContent()
+
+    // Index footer; also feeds the manifest
+    bool hashSections;
+    bool writeIndexFooter;
+    qint64 sectionOffset;     // Where the content of the current source starts
+    quint64 lastSectionHash;  // Of the content last written for a source
+    QList<BundleIndex::Entry> sectionIndex;
+
+    // Section being written, see beginContent()
+    Transform::Chain contentChain;
+    bool licensePending;            // Its first piece may start with a license header
+    ContentHash::Xxh64 contentHash; // Of what was written, for the index footer
+    QByteArray transformBuffer; // Output of the transform chain, reused per slice
+    Redactor redactor;
+    QByteArray redactionBuffer; // Output of the redactor, reused per slice
+
+    // Source arriving in slices, see writeFileSlice()
+    std::optional<SourceEncoding::Decoder> sourceDecoder; // Unless it is UTF-8
+    ContentHash::Xxh64 sourceHash;
+    qint64 sourceBytes;
+
+    // Incremental re-merge
+    bool writeManifest;
+    MergeManifest manifest;         // Of this run
+    MergeManifest previousManifest;
+    QFile previousOutput;           // Open only when its ranges can be reused
+
+    // Checkpointing
+    bool writeCheckpoints;
+    quint64 checkpointListHash;     // sourceListHash(), taken once per run
+    ContentHash::Xxh64 doneSources; // Path, size and mtime of each source written so far
+    int checkpointedCount;          // Sources covered by the last checkpoint
+    bool checkpointSaved;           // This run saved one, so its output can be resumed
+    QElapsedTimer checkpointClock;
+
+    bool isCancelled() const;
+    quint64 hashContent(const char *data, qint64 size) const;
+    bool useIoUring() const;
+    bool rewritesContent() const;
+    QString outputSettings() const;
+    void openPreviousOutput(const QString &outputFilePath);
+    bool saveManifest(const QString &outputFilePath);
+    QString checkpointSettings() const;
+    quint64 sourceListHash() const;
+    void addDoneSource(const QString &filePath, const FileIdentity *identity);
+    bool findResumePoint(const QString &outputDir, MergeCheckpoint *checkpoint);
+    bool maybeCheckpoint(PartedOutput &output, QString *errorMessage);
+    void initProgress();
+    qint64 expectedOutputSize() const;
+    void addBytes(qint64 bytes);
+    void reportProgress(bool force);
+    bool writeSource(PartedOutput &output, const char *data, qint64 size);
+    bool writeFileContent(PartedOutput &output, const QString &filePath, const char *data, qint64 size,
+                          const FileIdentity *identity = nullptr);
+    bool writeFileSlice(PartedOutput &output, const QString &filePath, const char *data, qint64 size, bool first);
+    bool finishFileSlices(PartedOutput &output, const QString &filePath, const FileIdentity *identity);
+    bool writeTransformed(PartedOutput &output, const QString &filePath, const char *data, qint64 size, bool countProgress);
+    bool beginContent(PartedOutput &output, const QString &filePath, qint64 sizeHint);
+    bool writeContent(PartedOutput &output, const char *data, qint64 size, bool countProgress);
+    bool writeContentStage(PartedOutput &output, const char *data, qint64 size, bool endOfSource);
+    bool finishContent(PartedOutput &output);
+    bool writeSourcePiece(PartedOutput &output, const char *data, qint64 size);
+    bool writeDuplicateReference(PartedOutput &output, const QString &filePath, qint64 size, const QString &original);
+    bool mergeSynchronously(PartedOutput &output, QString *errorMessage);
+    bool mergeWithIoUring(PartedOutput &output, QString *errorMessage);
+    bool appendFile(PartedOutput &output, SourceReader &reader, const QString &filePath, QString *errorMessage,
+                    const FileIdentity *identity = nullptr, const SourceCap &cap = SourceCap());
+    bool writeCappedContent(PartedOutput &output, SourceReader &reader, const QString &filePath, const SourceCap &cap,
+                            bool *capped);
+    SourceCap capFor(qint64 sourceSize, qint64 outputRoom, bool *cutByLimit) const;
+    bool writeOutputLimitNote(PartedOutput &output, QString *errorMessage);
+    bool beginFile(PartedOutput &output, const QString &filePath, qint64 contentSize);
+    void recordSection(const PartedOutput &output, const QString &filePath);
+    void fileDone();
 };
 
 
+// How a merge job ended, as jobFinished() reports it.
+struct MergeResult {
+    int jobId = 0;
+    bool success = false;
+    QString messageOrPath; // The output path on success
+    bool cancelled = false;
+};
+
+// Runs merges as jobs on a thread pool of its own, whose threads stay alive
+// between merges. Jobs start in the order they were queued, at most
+// maxConcurrentMerges() at a time; each has its own files, output directory
+// and options and reports through the job* signals under the id
+// queueMerge() returned.
 class FileMergerLogic : public QObject
 {
     Q_OBJECT
 public:
     explicit FileMergerLogic(QObject *parent = nullptr);
-    ~FileMergerLogic();
+    ~FileMergerLogic(); // Cancels every job and waits for the running ones
 
-    void startMergeProcess(const QStringList &files, const QString &outputDir);
+    int queueMerge(const QStringList &files, const QString &outputDir, const MergeOptions &options = MergeOptions());
+    // Merges the snapshot's files with the sizes it recorded; the file list is
+    // only built once the job runs, on its pool thread.
+    int queueMerge(const SelectionSnapshot &selection, const QString &outputDir, const MergeOptions &options = MergeOptions());
+    // Stops a running job within a slice of its current file, or a queued
+    // one before it starts; it then finishes with cancelled set and leaves no
+    // output behind (apart from a resumable one, see MergeOptions::checkpointing).
+    void cancelJob(int jobId);
+    void cancelAll();
+    void cancel() { cancelAll(); } // Kept for single-merge callers
+    bool isCancelling() const;     // A cancelled job is still queued or running
+
+    // Steps for pipelines written as coroutines (see asynctask.h), e.g.
+    //     SelectionSnapshot files = co_await logic.scanFolder(root);
+    //     files = co_await logic.skipBinaryFiles(std::move(files));
+    //     MergeResult result = co_await logic.merge(std::move(files), outputDir);
+    // Every step runs on this object's pool. The first one awaited moves the
+    // pipeline there, the others continue on the same thread with the result
+    // of the step before; a pipeline holds one pool thread while it runs.
+    // Start one with start().
+
+    // All files under rootPath, selected, in the order CustomFileModel lists them.
+    Task<SelectionSnapshot> scanFolder(QString rootPath);
+    // The selection without the files FileClassifier takes for binary.
+    Task<SelectionSnapshot> skipBinaryFiles(SelectionSnapshot selection);
+    // Merges the selection as a job: it gets an id, reports through the job*
+    // signals like a queued one and stops on cancelJob() or cancelAll().
+    Task<MergeResult> merge(SelectionSnapshot selection, QString outputDir, MergeOptions options = MergeOptions());
+
+    // Runs task and calls done with its result on this object's thread,
+    // unless context has been destroyed by then.
+    template <typename T, typename Done>
+    void start(Task<T> task, QObject *context, Done done);
+
+    void setMaxConcurrentMerges(int count); // 1 by default
+    int maxConcurrentMerges() const;
+    int activeJobCount() const; // Queued or running
 
 signals:
     void statusUpdated(const QString &message);
-    void mergeFinished(bool success, const QString &messageOrPath);
-    void progressUpdated(int percentage);
-
-private slots:
-    void handleMergeWorkerFinished(bool success, const QString &messageOrPath);
-    void handleProgressUpdate(int percentage);
+    void jobStarted(int jobId);
+    void jobProgress(int jobId, int percentage);
+    void jobThroughput(int jobId, qint64 bytesDone, qint64 bytesTotal, double bytesPerSecond, int etaSeconds);
+    void jobFinished(int jobId, bool success, const QString &messageOrPath, bool cancelled);
 
 private:
-    QThread *workerThread;
-    MergeWorker *worker; // Keep track of the worker
+    // Produces a job's files on its pool thread, possibly adding their sizes to the options.
+    using FileList = std::function<QStringList(MergeOptions &options)>;
+
+    int queueJob(const FileList &files, const QString &outputDir, const MergeOptions &options);
+    void runJob(int jobId, const FileList &files, const QString &outputDir, MergeOptions options,
+                const std::shared_ptr<std::atomic_bool> &cancelled);
+    int addJob(const std::shared_ptr<std::atomic_bool> &cancelled);
+    MergeResult runWorker(int jobId, const QStringList &paths, const QString &outputDir, const MergeOptions &options,
+                          const std::shared_ptr<std::atomic_bool> &cancelled);
+    void finishJob(const MergeResult &result); // On this object's thread
+
+    // Merges wait for compression blocks on the global pool, so they must not
+    // take its threads.
+    QThreadPool pool;
+    mutable QMutex jobsMutex; // merge() adds its job from a pool thread
+    int nextJobId;
+    // Cancel flag of every queued or running job, shared with the job itself
+    // so that it stays valid while the job winds down.
+    QHash<int, std::shared_ptr<std::atomic_bool>> jobs;
+    bool closing; // Set by the destructor
 };
 
+template <typename T, typename Done>
+void FileMergerLogic::start(Task<T> task, QObject *context, Done done)
+{
+    AsyncTask::start(std::move(task), [this, context = QPointer<QObject>(context), done](T result) {
+        // The only switch back, to hand the result over
+        QMetaObject::invokeMethod(this, [context, done, result = std::move(result)]() {
+            if (context) {
+                done(result);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
 #endif // FILEMERGERLOGIC_H 
\ No newline at end of file
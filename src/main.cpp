@@ -2,11 +2,84 @@
 // Application entry point
 
 #include "mainwindow.h"
+#include "bundleindex.h"
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QStyleFactory>
+#include <QTextStream>
+#include <cstdio>
+
+// Command-line access to outputs written with an index footer:
+//   FileMergerApp --list <output>
+//   FileMergerApp --extract <output> <source path or file name> [target file]
+static int runBundleCommand()
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QCoreApplication::tr("列出或提取合并输出中的文件 (List or extract files of a merged output)"));
+    parser.addHelpOption();
+    const QCommandLineOption listOption("list", QCoreApplication::tr("列出所有源文件 (List all sources)"), "output");
+    const QCommandLineOption extractOption("extract", QCoreApplication::tr("提取一个源文件 (Extract one source)"), "output");
+    parser.addOption(listOption);
+    parser.addOption(extractOption);
+    parser.addPositionalArgument("source", QCoreApplication::tr("--extract 的源文件路径或文件名 (Source path or file name for --extract)"));
+    parser.addPositionalArgument("target", QCoreApplication::tr("写入的目标文件, 默认为标准输出 (File to write, standard output by default)"), "[target]");
+    parser.process(*QCoreApplication::instance());
+
+    QTextStream err(stderr);
+    BundleReader reader;
+    const QString bundlePath = parser.isSet(listOption) ? parser.value(listOption) : parser.value(extractOption);
+    if (!reader.open(bundlePath)) {
+        err << bundlePath << ": " << reader.errorString() << Qt::endl;
+        return 1;
+    }
+
+    if (parser.isSet(listOption)) {
+        QTextStream out(stdout);
+        for (const BundleIndex::Entry &entry : reader.entries()) {
+            out << entry.length << '\t' << entry.path << '\n';
+        }
+        return 0;
+    }
+
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.isEmpty() || arguments.count() > 2) {
+        parser.showHelp(1);
+    }
+    const BundleIndex::Entry *entry = reader.find(arguments.at(0));
+    if (!entry) {
+        err << QCoreApplication::tr("未找到或不唯一: (Not found or ambiguous:) ") << arguments.at(0) << Qt::endl;
+        return 1;
+    }
+    QByteArray content;
+    if (!reader.extract(*entry, &content)) {
+        err << reader.errorString() << Qt::endl;
+        return 1;
+    }
+    QFile target;
+    bool opened = false;
+    if (arguments.count() == 2) {
+        target.setFileName(arguments.at(1));
+        opened = target.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    } else {
+        opened = target.open(stdout, QIODevice::WriteOnly);
+    }
+    if (!opened || target.write(content) != content.size() || !target.flush()) {
+        err << target.errorString() << Qt::endl;
+        return 1;
+    }
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
+    for (int i = 1; i < argc; ++i) {
+        const QByteArray argument(argv[i]);
+        if (argument == "--list" || argument == "--extract") {
+            QCoreApplication app(argc, argv); // No GUI needed
+            return runBundleCommand();
+        }
+    }
+
     QApplication a(argc, argv);
 
     // Optional: Attempt to set a more modern style if available
@@ -17,4 +90,4 @@ int main(int argc, char *argv[])
     MainWindow w;
     w.show();
     return a.exec();
-} 
\ No newline at end of file
+}
@@ -4,6 +4,7 @@
 #include "customfilemodel.h"
 #include "filemergerlogic.h"
 #include "treeitem.h"      // Added for TreeItem
+#include "selectionprofiles.h"
 #include <QDebug>          // Added for qDebug
 #include <QFileInfo>       // Added for QFileInfo
 #include <QtAlgorithms>    // Added for qSort (though often pulled in by other headers)
@@ -22,9 +23,21 @@
 #include <QGroupBox>    // For QGroupBox
 #include <QInputDialog> // For QInputDialog
 #include <QMenu>        // For QMenu (already included, but good for context)
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QSpinBox>
+#include <QActionGroup>
+#include <QTimer>
+#include <QLocale>
+#include <QComboBox>
+#include <QPlainTextEdit>
+#include <QLineEdit>
+#include <QThread>      // For idealThreadCount
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), progressBar(nullptr), fileModel(nullptr), mergerLogic(nullptr), currentFolderPath("")
+    : QMainWindow(parent), progressBar(nullptr), throughputLabel(nullptr), estimateLabel(nullptr), estimateTimer(nullptr), fileModel(nullptr), mergerLogic(nullptr), shownJobId(0), currentFolderPath(""),
+      splitLimit(0), splitUnit(SplitUnit::Bytes), outputLimit(0)
 {
     // Basic window setup
     setWindowTitle(tr("文件合并工具 (File Merger Tool)"));
@@ -49,6 +62,11 @@ MainWindow::MainWindow(QWidget *parent)
     // 2. File Selection
     QGroupBox *fileSelectGroup = new QGroupBox(tr("文件选择 (File Selection)"));
     QVBoxLayout *fileSelectLayout = new QVBoxLayout(fileSelectGroup);
+    filterLineEdit = new QLineEdit();
+    filterLineEdit->setPlaceholderText(tr("按名称筛选... (Filter by name...)"));
+    filterLineEdit->setClearButtonEnabled(true);
+    filterLineEdit->setEnabled(false); // Enabled once a folder is loaded
+    fileSelectLayout->addWidget(filterLineEdit);
     fileTreeView = new QTreeView();
     fileTreeView->setContextMenuPolicy(Qt::CustomContextMenu); // Set context menu policy
     fileSelectLayout->addWidget(fileTreeView);
@@ -63,7 +81,13 @@ MainWindow::MainWindow(QWidget *parent)
     actionLayout->addWidget(selectAllButton);
     actionLayout->addWidget(deselectAllButton);
     actionLayout->addStretch();
+    estimateLabel = new QLabel();
+    estimateLabel->setToolTip(tr("按每 4 个非空白字节约 1 个 token 估算 (Tokens estimated at about 4 non-whitespace bytes each)"));
+    actionLayout->addWidget(estimateLabel);
     actionLayout->addWidget(mergeButton);
+    estimateTimer = new QTimer(this);
+    estimateTimer->setSingleShot(true);
+    estimateTimer->setInterval(100); // A bulk selection emits many dataChanged signals
     mainLayout->addWidget(actionGroup);
 
     // Status Bar (QMainWindow has one by default)
@@ -73,6 +97,15 @@ MainWindow::MainWindow(QWidget *parent)
     progressBar->hide(); // Initially hidden
     progressBar->setRange(0,100); // Default progress range
     progressBar->setTextVisible(false); // Or true if you want to show percentage text on bar
+    throughputLabel = new QLabel(statusBar);
+    statusBar->addPermanentWidget(throughputLabel);
+    throughputLabel->hide(); // Only visible while merging
+    cancelScanButton = new QPushButton(tr("取消扫描 (Cancel Scan)"), statusBar);
+    statusBar->addPermanentWidget(cancelScanButton);
+    cancelScanButton->hide(); // Only visible while a content scan runs
+    cancelMergeButton = new QPushButton(tr("取消合并 (Cancel Merge)"), statusBar);
+    statusBar->addPermanentWidget(cancelMergeButton);
+    cancelMergeButton->hide(); // Only visible while merging
 
     // Create a Tools menu
     QMenu *toolsMenu = menuBar()->addMenu(tr("工具 (&T)"));
@@ -81,6 +114,92 @@ MainWindow::MainWindow(QWidget *parent)
     actionRecursiveSelectByExtension = new QAction(tr("递归按后缀选择... (&R)"), this);
     toolsMenu->addAction(actionRecursiveSelectByExtension);
 
+    actionSelectByContent = new QAction(tr("按内容选择... (&C)"), this);
+    toolsMenu->addAction(actionSelectByContent);
+
+    actionSelectByPredicate = new QAction(tr("按大小/时间/深度选择... (&P)"), this);
+    toolsMenu->addAction(actionSelectByPredicate);
+
+    toolsMenu->addSeparator();
+    actionSaveProfile = new QAction(tr("保存选择配置... (&S)"), this);
+    toolsMenu->addAction(actionSaveProfile);
+    actionApplyProfile = new QAction(tr("应用选择配置... (&A)"), this);
+    toolsMenu->addAction(actionApplyProfile);
+
+    toolsMenu->addSeparator();
+    actionSkipBinaryFiles = new QAction(tr("批量选择时跳过二进制文件 (Skip binary files when selecting)"), this);
+    actionSkipBinaryFiles->setCheckable(true);
+    actionSkipBinaryFiles->setChecked(true);
+    toolsMenu->addAction(actionSkipBinaryFiles);
+
+    // Output compression; exactly one of the entries is checked
+    QMenu *compressionMenu = toolsMenu->addMenu(tr("输出压缩 (Output Compression)"));
+    compressionGroup = new QActionGroup(this);
+    const QList<QPair<QString, OutputCompression>> compressionChoices = {
+        {tr("不压缩 (None)"), OutputCompression::None},
+        {tr("gzip (.gz)"), OutputCompression::Gzip},
+        {tr("zstd (.zst)"), OutputCompression::Zstd},
+    };
+    for (const auto &choice : compressionChoices) {
+        QAction *action = compressionMenu->addAction(choice.first);
+        action->setCheckable(true);
+        action->setData(static_cast<int>(choice.second));
+        action->setEnabled(BlockCompression::isAvailable(choice.second)); // zstd is optional at build time
+        action->setChecked(choice.second == OutputCompression::None);
+        compressionGroup->addAction(action);
+    }
+    actionSplitOutput = new QAction(tr("拆分输出... (Split Output...)"), this);
+    toolsMenu->addAction(actionSplitOutput);
+    actionRedactionRules = new QAction(tr("脱敏规则... (Redaction Rules...)"), this);
+    toolsMenu->addAction(actionRedactionRules);
+    actionSizeLimits = new QAction(tr("大小上限... (Size Limits...)"), this);
+    toolsMenu->addAction(actionSizeLimits);
+    actionDeduplicate = new QAction(tr("合并时去除重复内容 (Deduplicate identical files)"), this);
+    actionDeduplicate->setCheckable(true);
+    toolsMenu->addAction(actionDeduplicate);
+    actionIncremental = new QAction(tr("增量合并: 复用上次输出 (Incremental re-merge)"), this);
+    actionIncremental->setCheckable(true);
+    toolsMenu->addAction(actionIncremental);
+    actionIndexFooter = new QAction(tr("输出末尾附加索引 (Append index footer)"), this);
+    actionIndexFooter->setCheckable(true);
+    toolsMenu->addAction(actionIndexFooter);
+    actionResumable = new QAction(tr("可续传合并: 中断后从检查点继续 (Resumable merges)"), this);
+    actionResumable->setCheckable(true);
+    toolsMenu->addAction(actionResumable);
+    actionConcurrentMerges = new QAction(tr("同时进行的合并数... (Concurrent Merges...)"), this);
+    toolsMenu->addAction(actionConcurrentMerges);
+
+    // Page cache use during merges; exactly one of the entries is checked
+    QMenu *cacheMenu = toolsMenu->addMenu(tr("页缓存 (Page Cache)"));
+    cacheModeGroup = new QActionGroup(this);
+    const QList<QPair<QString, CacheMode>> cacheChoices = {
+        {tr("正常 (Normal)"), CacheMode::Normal},
+        {tr("用后释放 (Drop after use)"), CacheMode::DropAfterUse},
+        {tr("用后释放, 输出直写 (Drop after use, direct output)"), CacheMode::DirectOutput},
+    };
+    for (const auto &choice : cacheChoices) {
+        QAction *action = cacheMenu->addAction(choice.first);
+        action->setCheckable(true);
+        action->setData(static_cast<int>(choice.second));
+        action->setChecked(choice.second == CacheMode::Normal);
+        cacheModeGroup->addAction(action);
+    }
+
+    // Per-file transforms; any combination may be checked (action data: Transform::Stage)
+    QMenu *transformMenu = toolsMenu->addMenu(tr("输出转换 (Output Transforms)"));
+    const QList<QPair<QString, Transform::Stage>> transformChoices = {
+        {tr("去除许可证头 (Strip license headers)"), Transform::StripLicenseHeader},
+        {tr("CRLF 转为 LF (Normalize CRLF to LF)"), Transform::NormalizeLineEndings},
+        {tr("删除行尾空白 (Trim trailing whitespace)"), Transform::TrimTrailingWhitespace},
+        {tr("合并连续空行 (Collapse blank lines)"), Transform::CollapseBlankLines},
+    };
+    for (const auto &choice : transformChoices) {
+        QAction *action = transformMenu->addAction(choice.first);
+        action->setCheckable(true);
+        action->setData(static_cast<uint>(choice.second));
+        transformActions.append(action);
+    }
+
     updateStatus(tr("请选择一个文件夹 (Please select a folder)."));
 
     // Initialize logic and model
@@ -112,17 +231,45 @@ void MainWindow::connectSignalsAndSlots()
     connect(selectAllButton, &QPushButton::clicked, this, &MainWindow::selectAllFiles);
     connect(deselectAllButton, &QPushButton::clicked, this, &MainWindow::deselectAllFiles);
     connect(mergeButton, &QPushButton::clicked, this, &MainWindow::startMerge);
+    connect(filterLineEdit, &QLineEdit::textChanged, this, &MainWindow::onFilterTextChanged);
+    connect(estimateTimer, &QTimer::timeout, this, &MainWindow::updateEstimate);
 
     // Connect signals from FileMergerLogic
     connect(mergerLogic, &FileMergerLogic::statusUpdated, this, &MainWindow::updateStatus);
-    connect(mergerLogic, &FileMergerLogic::mergeFinished, this, &MainWindow::mergeProcessFinished);
-    connect(mergerLogic, &FileMergerLogic::progressUpdated, this, &MainWindow::updateProgressBar);
+    connect(mergerLogic, &FileMergerLogic::jobStarted, this, &MainWindow::mergeJobStarted);
+    connect(mergerLogic, &FileMergerLogic::jobFinished, this, &MainWindow::mergeProcessFinished);
+    connect(mergerLogic, &FileMergerLogic::jobProgress, this, &MainWindow::updateProgressBar);
+    connect(mergerLogic, &FileMergerLogic::jobThroughput, this, &MainWindow::updateThroughput);
 
     // Connect context menu signal
     connect(fileTreeView, &QTreeView::customContextMenuRequested, this, &MainWindow::showContextMenu);
 
     // Connect new action signal
     connect(actionRecursiveSelectByExtension, &QAction::triggered, this, &MainWindow::onRecursiveSelectByExtensionTriggered);
+    connect(actionSelectByContent, &QAction::triggered, this, &MainWindow::onSelectByContentTriggered);
+    connect(actionSelectByPredicate, &QAction::triggered, this, &MainWindow::onSelectByPredicateTriggered);
+    connect(actionSaveProfile, &QAction::triggered, this, &MainWindow::onSaveProfileTriggered);
+    connect(actionApplyProfile, &QAction::triggered, this, &MainWindow::onApplyProfileTriggered);
+    connect(actionSplitOutput, &QAction::triggered, this, &MainWindow::onSplitOutputTriggered);
+    connect(actionRedactionRules, &QAction::triggered, this, &MainWindow::onRedactionRulesTriggered);
+    connect(actionSizeLimits, &QAction::triggered, this, &MainWindow::onSizeLimitsTriggered);
+    connect(actionConcurrentMerges, &QAction::triggered, this, &MainWindow::onConcurrentMergesTriggered);
+    connect(actionSkipBinaryFiles, &QAction::toggled, this, [this](bool checked) {
+        if (fileModel) {
+            fileModel->setSkipBinaryFiles(checked);
+        }
+    });
+    connect(cancelScanButton, &QPushButton::clicked, this, [this]() {
+        if (fileModel) {
+            fileModel->cancelContentSelection();
+        }
+    });
+    connect(cancelMergeButton, &QPushButton::clicked, this, [this]() {
+        cancelMergeButton->setEnabled(false); // Until the workers have stopped
+        for (int jobId : std::as_const(mergeJobs)) {
+            mergerLogic->cancelJob(jobId); // Queued ones too
+        }
+    });
 }
 
 
@@ -138,16 +285,30 @@ void MainWindow::browseFolder()
 
         if (fileModel) {
             fileTreeView->setModel(nullptr); // Disconnect old model
-            delete fileModel; // Delete old model
+            delete fileModel; // Delete old model (cancels any running content scan)
             fileModel = nullptr;
+            cancelScanButton->hide();
         }
+        filterLineEdit->blockSignals(true); // The new model starts unfiltered
+        filterLineEdit->clear();
+        filterLineEdit->blockSignals(false);
         fileModel = new CustomFileModel(currentFolderPath, this); // Parent to MainWindow
         fileTreeView->setModel(fileModel);
+        connect(fileModel, &CustomFileModel::contentSelectionProgress, this, &MainWindow::updateContentSelectionProgress);
+        connect(fileModel, &CustomFileModel::contentSelectionFinished, this, &MainWindow::contentSelectionFinished);
+        connect(fileModel, &CustomFileModel::contentClassificationFinished, this, &MainWindow::contentClassificationFinished);
+        connect(fileModel, &CustomFileModel::dataChanged, this, &MainWindow::scheduleEstimateUpdate);
+        connect(fileModel, &CustomFileModel::modelReset, this, &MainWindow::scheduleEstimateUpdate);
+        connect(fileModel, &CustomFileModel::textStatisticsFinished, this, &MainWindow::scheduleEstimateUpdate);
+        updateEstimate();
+        fileModel->setSkipBinaryFiles(actionSkipBinaryFiles->isChecked());
+        fileModel->startContentClassification(); // Runs in the background
         // fileTreeView->expandAll(); // Optionally expand all items
         fileTreeView->header()->setSectionResizeMode(0, QHeaderView::Stretch);
 
 
         bool filesFound = fileModel->hasFiles();
+        filterLineEdit->setEnabled(filesFound);
         selectAllButton->setEnabled(filesFound);
         deselectAllButton->setEnabled(filesFound);
         mergeButton->setEnabled(filesFound);
@@ -190,8 +351,28 @@ void MainWindow::startMerge()
         return;
     }
 
-    QStringList filesToMerge = fileModel->getCheckedFilesPaths();
-    if (filesToMerge.isEmpty()) {
+    MergeOptions mergeOptions;
+    mergeOptions.compression = static_cast<OutputCompression>(compressionGroup->checkedAction()->data().toInt());
+    mergeOptions.splitLimit = splitLimit;
+    mergeOptions.splitUnit = splitUnit;
+    mergeOptions.deduplicate = actionDeduplicate->isChecked();
+    mergeOptions.incremental = actionIncremental->isChecked();
+    mergeOptions.indexFooter = actionIndexFooter->isChecked();
+    // The next merge of the same selection picks up where an interrupted one stopped.
+    mergeOptions.checkpointing = mergeOptions.resume = actionResumable->isChecked();
+    mergeOptions.redaction = redactionRules;
+    mergeOptions.sourceCap = sourceCap;
+    mergeOptions.outputLimit = outputLimit;
+    mergeOptions.cacheMode = static_cast<CacheMode>(cacheModeGroup->checkedAction()->data().toInt());
+    for (const QAction *action : std::as_const(transformActions)) {
+        if (action->isChecked()) {
+            mergeOptions.transforms |= action->data().toUInt();
+        }
+    }
+    // The merge reads this snapshot (paths plus scan sizes, which weight the
+    // progress bar), so the tree stays editable while it runs.
+    const SelectionSnapshot selection = fileModel->selectionSnapshot();
+    if (selection.isEmpty()) {
         QMessageBox::information(this, tr("未选择文件 (No Files Selected)"), tr("请至少选择一个文件进行合并。 (Please select at least one file to merge.)"));
         return;
     }
@@ -207,17 +388,23 @@ void MainWindow::startMerge()
         }
     }
 
-    // Disable buttons during merge
-    mergeButton->setEnabled(false);
-    browseButton->setEnabled(false);
-    selectAllButton->setEnabled(false);
-    deselectAllButton->setEnabled(false);
-    fileTreeView->setEnabled(false); // Disable tree view as well
+    // Browsing and selecting go on while it runs; another merge queues behind it.
+    cancelMergeButton->setEnabled(true);
+    cancelMergeButton->show();
+    mergeJobs.append(mergerLogic->queueMerge(selection, desktopPath, mergeOptions));
+}
 
+void MainWindow::mergeJobStarted(int jobId)
+{
+    if (!mergeJobs.contains(jobId)) {
+        return; // Not started from this window
+    }
+    shownJobId = jobId; // The status bar follows the newest running merge
     updateStatus(tr("正在合并文件... (Merging files...)"));
     progressBar->setValue(0);
     progressBar->show();
-    mergerLogic->startMergeProcess(filesToMerge, desktopPath);
+    throughputLabel->clear();
+    throughputLabel->show();
 }
 
 void MainWindow::updateStatus(const QString &message)
@@ -225,18 +412,23 @@ void MainWindow::updateStatus(const QString &message)
     statusBar->showMessage(message);
 }
 
-void MainWindow::mergeProcessFinished(bool success, const QString &messageOrPath)
+void MainWindow::mergeProcessFinished(int jobId, bool success, const QString &messageOrPath, bool cancelled)
 {
-    // Re-enable buttons
-    mergeButton->setEnabled(fileModel ? fileModel->hasFiles() : false);
-    browseButton->setEnabled(true);
-    selectAllButton->setEnabled(fileModel ? fileModel->hasFiles() : false);
-    deselectAllButton->setEnabled(fileModel ? fileModel->hasFiles() : false);
-    fileTreeView->setEnabled(true);
-    progressBar->hide();
-
+    if (!mergeJobs.removeOne(jobId)) {
+        return; // Not started from this window
+    }
+    if (jobId == shownJobId) {
+        shownJobId = 0;
+        progressBar->hide();
+        throughputLabel->hide();
+    }
+    if (mergeJobs.isEmpty()) {
+        cancelMergeButton->hide();
+    }
 
-    if (success) {
+    if (cancelled) {
+        updateStatus(messageOrPath); // Asked for, so no error dialog
+    } else if (success) {
         QMessageBox::information(this, tr("合并完成 (Merge Complete)"), tr("文件合并成功！已保存到: (Files merged successfully! Saved to:) ") + messageOrPath);
         updateStatus(tr("合并完成。 (Merge complete.) ") + tr("文件已保存到: (File saved to:) ") + messageOrPath);
     } else {
@@ -245,7 +437,10 @@ void MainWindow::mergeProcessFinished(bool success, const QString &messageOrPath
     }
 }
 
-void MainWindow::updateProgressBar(int value) {
+void MainWindow::updateProgressBar(int jobId, int value) {
+    if (jobId != shownJobId) {
+        return;
+    }
     if (value >= 0 && value <= 100) {
         progressBar->setValue(value);
         if (value == 0 || value == 100) { // Hide if reset or complete from logic's perspective
@@ -256,6 +451,58 @@ void MainWindow::updateProgressBar(int value) {
     }
 }
 
+void MainWindow::scheduleEstimateUpdate()
+{
+    if (!estimateTimer->isActive()) {
+        estimateTimer->start();
+    }
+}
+
+// The totals are maintained by the model as check states change; only the
+// line/token counts of newly checked files need a (background) read.
+void MainWindow::updateEstimate()
+{
+    if (!fileModel) {
+        estimateLabel->clear();
+        return;
+    }
+    const SelectionTotals totals = fileModel->selectionTotals();
+    if (totals.fileCount == 0) {
+        estimateLabel->setText(tr("未选择文件 (No files selected)"));
+        return;
+    }
+    QString text = tr("%1 个文件, %2 MB (%1 files, %2 MB)")
+                       .arg(totals.fileCount)
+                       .arg(totals.bytes / (1024.0 * 1024.0), 0, 'f', 1);
+    if (totals.countedFiles == totals.fileCount) {
+        text += tr(", %1 行, 约 %2 tokens (%1 lines, ~%2 tokens)")
+                    .arg(QLocale().toString(totals.lines))
+                    .arg(QLocale().toString(totals.tokens));
+    } else {
+        text += tr(", 正在统计行数... (counting lines... %1/%2)").arg(totals.countedFiles).arg(totals.fileCount);
+        if (!fileModel->isTextStatisticsRunning()) {
+            fileModel->startTextStatistics(); // Finishing triggers another update
+        }
+    }
+    estimateLabel->setText(text);
+}
+
+void MainWindow::updateThroughput(int jobId, qint64 bytesDone, qint64 bytesTotal, double bytesPerSecond, int etaSeconds)
+{
+    if (jobId != shownJobId) {
+        return;
+    }
+    const double mib = 1024.0 * 1024.0;
+    QString text = tr("%1 / %2 MB, %3 MB/s")
+                       .arg(bytesDone / mib, 0, 'f', 1)
+                       .arg(bytesTotal / mib, 0, 'f', 1)
+                       .arg(bytesPerSecond / mib, 0, 'f', 1);
+    if (etaSeconds >= 0) {
+        text += tr(", 剩余 (ETA) %1:%2").arg(etaSeconds / 60).arg(etaSeconds % 60, 2, 10, QChar('0'));
+    }
+    throughputLabel->setText(text);
+}
+
 void MainWindow::showContextMenu(const QPoint &point)
 {
     QModelIndex index = fileTreeView->indexAt(point);
@@ -391,4 +638,351 @@ void MainWindow::onRecursiveSelectByExtensionTriggered()
     } else if (ok && extension.isEmpty()){
         QMessageBox::warning(this, tr("输入无效 (Invalid Input)"), tr("后缀名不能为空。 (Extension cannot be empty.)"));
     }
-}
\ No newline at end of file
+}
+
+QModelIndex MainWindow::selectedFolderIndex() const
+{
+    QModelIndex current = fileTreeView->currentIndex();
+    if (current.isValid()) {
+        TreeItem *item = static_cast<TreeItem*>(current.internalPointer());
+        if (item && item->type() == TreeItem::Folder) {
+            return current;
+        }
+    }
+    return QModelIndex(); // Root
+}
+
+void MainWindow::onSelectByContentTriggered()
+{
+    if (!fileModel) {
+        QMessageBox::information(this, tr("无模型 (No Model)"), tr("请先加载一个文件夹。 (Please load a folder first.)"));
+        return;
+    }
+    if (fileModel->isContentSelectionRunning()) {
+        updateStatus(tr("内容扫描已在进行中。 (A content scan is already running.)"));
+        return;
+    }
+
+    bool ok;
+    QString text = QInputDialog::getText(this, tr("按内容选择 (Select by Content)"),
+                                         tr("选择包含以下文本的文件，多个关键字用 | 分隔: (Select files containing the text, separate alternatives with |:)"),
+                                         QLineEdit::Normal, "", &ok);
+    if (!ok) {
+        return;
+    }
+
+    QStringList patterns = text.split('|', Qt::SkipEmptyParts);
+    if (patterns.isEmpty()) {
+        QMessageBox::warning(this, tr("输入无效 (Invalid Input)"), tr("搜索文本不能为空。 (Search text cannot be empty.)"));
+        return;
+    }
+
+    if (fileModel->selectFilesByContent(selectedFolderIndex(), patterns)) {
+        cancelScanButton->show();
+        updateStatus(tr("正在扫描文件内容... (Scanning file contents...)"));
+    }
+}
+
+void MainWindow::updateContentSelectionProgress(int scannedCount, int totalCount)
+{
+    updateStatus(tr("正在扫描文件内容: %1 / %2 (Scanning file contents: %1 / %2)").arg(scannedCount).arg(totalCount));
+}
+
+void MainWindow::contentSelectionFinished(int matchedCount, bool cancelled)
+{
+    cancelScanButton->hide();
+    if (cancelled) {
+        updateStatus(tr("内容扫描已取消。 (Content scan cancelled.)"));
+    } else {
+        updateStatus(tr("内容扫描完成，已选择 %1 个文件。 (Content scan complete, %1 files selected.)").arg(matchedCount));
+    }
+}
+
+void MainWindow::onSelectByPredicateTriggered()
+{
+    if (!fileModel) {
+        QMessageBox::information(this, tr("无模型 (No Model)"), tr("请先加载一个文件夹。 (Please load a folder first.)"));
+        return;
+    }
+
+    // A value of 0 in any field means "no limit".
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("按条件选择 (Select by Criteria)"));
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    QSpinBox *maxSizeSpin = new QSpinBox(&dialog);
+    maxSizeSpin->setRange(0, 1024 * 1024);
+    maxSizeSpin->setSuffix(" KB");
+    maxSizeSpin->setSpecialValueText(tr("不限 (Any)"));
+    form->addRow(tr("最大文件大小 (Max size):"), maxSizeSpin);
+
+    QSpinBox *modifiedWithinSpin = new QSpinBox(&dialog);
+    modifiedWithinSpin->setRange(0, 24 * 365);
+    modifiedWithinSpin->setSuffix(tr(" 小时 (h)"));
+    modifiedWithinSpin->setSpecialValueText(tr("不限 (Any)"));
+    form->addRow(tr("最近修改于 (Modified within):"), modifiedWithinSpin);
+
+    QSpinBox *maxDepthSpin = new QSpinBox(&dialog);
+    maxDepthSpin->setRange(0, 1000);
+    maxDepthSpin->setSpecialValueText(tr("不限 (Any)"));
+    form->addRow(tr("最大目录深度 (Max depth):"), maxDepthSpin);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    FilePredicate predicate;
+    if (maxSizeSpin->value() > 0) {
+        predicate.maxSize = qint64(maxSizeSpin->value()) * 1024;
+    }
+    if (modifiedWithinSpin->value() > 0) {
+        predicate.modifiedAfter = QDateTime::currentDateTime().addSecs(-qint64(modifiedWithinSpin->value()) * 3600);
+    }
+    if (maxDepthSpin->value() > 0) {
+        predicate.maxDepth = maxDepthSpin->value();
+    }
+
+    int selected = fileModel->selectFilesByPredicate(selectedFolderIndex(), predicate);
+    updateStatus(tr("按条件选择完成，已选择 %1 个文件。 (Selection by criteria complete, %1 files selected.)").arg(selected));
+}
+
+void MainWindow::onSplitOutputTriggered()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("拆分输出 (Split Output)"));
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    // Sizes are entered in MB or thousands of tokens; 0 writes a single file.
+    QComboBox *unitCombo = new QComboBox(&dialog);
+    unitCombo->addItem(tr("按大小 MB (By size, MB)"), static_cast<int>(SplitUnit::Bytes));
+    unitCombo->addItem(tr("按估计 token 数，千 (By estimated tokens, thousands)"), static_cast<int>(SplitUnit::Tokens));
+    unitCombo->setCurrentIndex(splitUnit == SplitUnit::Tokens ? 1 : 0);
+    form->addRow(tr("单位 (Unit):"), unitCombo);
+
+    QSpinBox *limitSpin = new QSpinBox(&dialog);
+    limitSpin->setRange(0, 1024 * 1024);
+    limitSpin->setSpecialValueText(tr("不拆分 (Off)"));
+    const qint64 scale = splitUnit == SplitUnit::Tokens ? 1000 : 1024 * 1024;
+    limitSpin->setValue(int(splitLimit / scale));
+    form->addRow(tr("每部分上限 (Limit per part):"), limitSpin);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    splitUnit = static_cast<SplitUnit>(unitCombo->currentData().toInt());
+    splitLimit = qint64(limitSpin->value()) * (splitUnit == SplitUnit::Tokens ? 1000 : 1024 * 1024);
+    if (splitLimit > 0) {
+        updateStatus(tr("合并输出将拆分为多个部分。 (Merge output will be split into parts.)"));
+    } else {
+        updateStatus(tr("合并输出为单个文件。 (Merge output is a single file.)"));
+    }
+}
+
+void MainWindow::onRedactionRulesTriggered()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("脱敏规则 (Redaction Rules)"));
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    QPlainTextEdit *rulesEdit = new QPlainTextEdit(&dialog);
+    rulesEdit->setPlaceholderText(tr("每行一条: 字面文本, 或以 re: 开头的正则表达式\n(One per line: literal text, or a regular expression after re:)\n"
+                                     "re:AKIA[0-9A-Z]{16}"));
+    rulesEdit->setPlainText(redactionRules.toText());
+    form->addRow(tr("规则 (Rules):"), rulesEdit);
+
+    QLineEdit *replacementEdit = new QLineEdit(QString::fromUtf8(redactionRules.replacement), &dialog);
+    form->addRow(tr("替换为 (Replace with):"), replacementEdit);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    RedactionRules rules;
+    QString error;
+    while (true) {
+        if (dialog.exec() != QDialog::Accepted) {
+            return;
+        }
+        rules.replacement = replacementEdit->text().toUtf8();
+        if (RedactionRules::parse(rulesEdit->toPlainText(), &rules, &error)) {
+            break;
+        }
+        QMessageBox::warning(this, tr("脱敏规则 (Redaction Rules)"), error); // Keep the dialog's text for fixing
+    }
+
+    redactionRules = rules;
+    if (redactionRules.isEmpty()) {
+        updateStatus(tr("已关闭脱敏。 (Redaction off.)"));
+    } else {
+        updateStatus(tr("合并时将脱敏 %1 条规则。 (Merges will redact %1 rules.)")
+                         .arg(redactionRules.literals.count() + redactionRules.patterns.count()));
+    }
+}
+
+void MainWindow::onConcurrentMergesTriggered()
+{
+    bool ok = false;
+    const int count = QInputDialog::getInt(this, tr("同时进行的合并数 (Concurrent Merges)"),
+                                           tr("最多同时运行的合并任务, 其余排队等候: (Merges running at once; the rest wait in the queue:)"),
+                                           mergerLogic->maxConcurrentMerges(), 1, qMax(1, QThread::idealThreadCount()), 1, &ok);
+    if (ok) {
+        mergerLogic->setMaxConcurrentMerges(count);
+    }
+}
+
+void MainWindow::onSizeLimitsTriggered()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("大小上限 (Size Limits)"));
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    // Ends are entered in KB or lines; 0 in both turns the per-file cap off.
+    QComboBox *unitCombo = new QComboBox(&dialog);
+    unitCombo->addItem(tr("按大小 KB (By size, KB)"), static_cast<int>(SourceCap::Bytes));
+    unitCombo->addItem(tr("按行数 (By lines)"), static_cast<int>(SourceCap::Lines));
+    unitCombo->setCurrentIndex(sourceCap.unit == SourceCap::Lines ? 1 : 0);
+    form->addRow(tr("单位 (Unit):"), unitCombo);
+
+    const qint64 scale = sourceCap.unit == SourceCap::Lines ? 1 : 1024;
+    QSpinBox *headSpin = new QSpinBox(&dialog);
+    headSpin->setRange(0, 1000000);
+    headSpin->setValue(int(sourceCap.head / scale));
+    form->addRow(tr("每个文件保留开头 (Keep from the start of each file):"), headSpin);
+    QSpinBox *tailSpin = new QSpinBox(&dialog);
+    tailSpin->setRange(0, 1000000);
+    tailSpin->setValue(int(sourceCap.tail / scale));
+    form->addRow(tr("每个文件保留结尾 (Keep from the end of each file):"), tailSpin);
+
+    QSpinBox *outputLimitSpin = new QSpinBox(&dialog);
+    outputLimitSpin->setRange(0, 1024 * 1024);
+    outputLimitSpin->setSuffix(" MB");
+    outputLimitSpin->setSpecialValueText(tr("不限 (No limit)"));
+    outputLimitSpin->setValue(int(outputLimit / (1024 * 1024)));
+    form->addRow(tr("输出总大小上限 (Output limit):"), outputLimitSpin);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    sourceCap.unit = static_cast<SourceCap::Unit>(unitCombo->currentData().toInt());
+    const qint64 unitScale = sourceCap.unit == SourceCap::Lines ? 1 : 1024;
+    sourceCap.head = qint64(headSpin->value()) * unitScale;
+    sourceCap.tail = qint64(tailSpin->value()) * unitScale;
+    outputLimit = qint64(outputLimitSpin->value()) * 1024 * 1024;
+    if (sourceCap.isEnabled() || outputLimit > 0) {
+        updateStatus(tr("大文件将被截断。 (Large files will be truncated.)"));
+    } else {
+        updateStatus(tr("不限制文件大小。 (No size limits.)"));
+    }
+}
+
+void MainWindow::contentClassificationFinished(int binaryCount)
+{
+    if (binaryCount > 0) {
+        updateStatus(tr("检测到 %1 个二进制文件。 (Detected %1 binary files.)").arg(binaryCount));
+    }
+}
+
+void MainWindow::onFilterTextChanged(const QString &text)
+{
+    if (!fileModel) {
+        return;
+    }
+
+    fileModel->setNameFilter(text);
+    if (!fileModel->isFiltered()) {
+        updateStatus(tr("已清除筛选。 (Filter cleared.)"));
+        return;
+    }
+
+    // Expanding is cheap for a handful of matches and saves clicking through folders.
+    const int matchCount = fileModel->filterMatchCount();
+    if (matchCount <= 1000) {
+        fileTreeView->expandAll();
+    }
+    updateStatus(tr("筛选 '%1': %2 个匹配项 (Filter '%1': %2 matches)").arg(fileModel->nameFilter()).arg(matchCount));
+}
+
+void MainWindow::onSaveProfileTriggered()
+{
+    if (!fileModel) {
+        QMessageBox::information(this, tr("无模型 (No Model)"), tr("请先加载一个文件夹。 (Please load a folder first.)"));
+        return;
+    }
+
+    SelectionProfile profile;
+    profile.relativePaths = fileModel->checkedRelativePaths();
+    if (profile.relativePaths.isEmpty()) {
+        QMessageBox::information(this, tr("未选择文件 (No Files Selected)"), tr("请至少选择一个文件。 (Please select at least one file.)"));
+        return;
+    }
+
+    bool ok;
+    QString name = QInputDialog::getText(this, tr("保存选择配置 (Save Selection Profile)"),
+                                         tr("配置名称: (Profile name:)"), QLineEdit::Normal, "", &ok).trimmed();
+    if (!ok || name.isEmpty()) {
+        return;
+    }
+    if (name.contains('/') || name.contains('\\')) {
+        QMessageBox::warning(this, tr("输入无效 (Invalid Input)"), tr("配置名称不能包含斜杠。 (Profile name cannot contain slashes.)"));
+        return;
+    }
+
+    if (SelectionProfiles::save(fileModel->rootPath(), name, profile)) {
+        updateStatus(tr("已保存配置 '%1' (%2 个文件)。 (Saved profile '%1' with %2 files.)").arg(name).arg(profile.relativePaths.size()));
+    } else {
+        QMessageBox::critical(this, tr("错误 (Error)"), tr("无法保存配置。 (Could not save the profile.)"));
+    }
+}
+
+void MainWindow::onApplyProfileTriggered()
+{
+    if (!fileModel) {
+        QMessageBox::information(this, tr("无模型 (No Model)"), tr("请先加载一个文件夹。 (Please load a folder first.)"));
+        return;
+    }
+
+    const QStringList names = SelectionProfiles::names(fileModel->rootPath());
+    if (names.isEmpty()) {
+        QMessageBox::information(this, tr("无配置 (No Profiles)"), tr("此文件夹没有已保存的配置。 (No profiles saved for this folder.)"));
+        return;
+    }
+
+    bool ok;
+    QString name = QInputDialog::getItem(this, tr("应用选择配置 (Apply Selection Profile)"),
+                                         tr("配置: (Profile:)"), names, 0, false, &ok);
+    if (!ok) {
+        return;
+    }
+
+    SelectionProfile profile;
+    if (!SelectionProfiles::load(fileModel->rootPath(), name, profile)) {
+        QMessageBox::critical(this, tr("错误 (Error)"), tr("无法读取配置。 (Could not read the profile.)"));
+        return;
+    }
+
+    int missing = 0;
+    int selected = fileModel->applySelection(profile.relativePaths, profile.patterns, &missing);
+    if (missing > 0) {
+        updateStatus(tr("已应用配置 '%1': %2 个文件，%3 个文件不存在。 (Applied profile '%1': %2 files, %3 missing.)").arg(name).arg(selected).arg(missing));
+    } else {
+        updateStatus(tr("已应用配置 '%1': %2 个文件。 (Applied profile '%1': %2 files.)").arg(name).arg(selected));
+    }
+}
@@ -12,6 +12,7 @@
 #include <QProgressBar>    // Added for QProgressBar
 #include <QMenu>           // Added for QMenu
 #include <QAction>         // Added for QAction
+#include "filemergerlogic.h" // For SplitUnit
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -25,9 +26,11 @@ class QPushButton;
 class QStatusBar;
 class QGroupBox; // Added missing include for QGroupBox
 class QLabel;    // Added missing include for QLabel
+class QTimer;
 class QVBoxLayout; // Added missing include for QVBoxLayout
 class QHBoxLayout; // Added missing include for QHBoxLayout
 class QProgressBar; // Added missing include for QProgressBar
+class QActionGroup;
 
 
 class MainWindow : public QMainWindow
@@ -45,30 +48,76 @@ private slots:
     void deselectAllFiles();
     void startMerge();
     void updateStatus(const QString &message);
-    void mergeProcessFinished(bool success, const QString &messageOrPath);
-    void updateProgressBar(int value);
+    void mergeJobStarted(int jobId);
+    void mergeProcessFinished(int jobId, bool success, const QString &messageOrPath, bool cancelled);
+    void updateProgressBar(int jobId, int value);
+    void updateThroughput(int jobId, qint64 bytesDone, qint64 bytesTotal, double bytesPerSecond, int etaSeconds);
     void showContextMenu(const QPoint &point);
     void handleSelectByExtensionTriggered(const QModelIndex& folderIndex, const QString& extension);
     void onRecursiveSelectByExtensionTriggered();
+    void onSelectByContentTriggered();
+    void onSelectByPredicateTriggered();
+    void contentClassificationFinished(int binaryCount);
+    void onFilterTextChanged(const QString &text);
+    void onSaveProfileTriggered();
+    void onApplyProfileTriggered();
+    void onSplitOutputTriggered();
+    void onRedactionRulesTriggered();
+    void onSizeLimitsTriggered();
+    void onConcurrentMergesTriggered();
+    void updateContentSelectionProgress(int scannedCount, int totalCount);
+    void contentSelectionFinished(int matchedCount, bool cancelled);
+    void scheduleEstimateUpdate();
+    void updateEstimate();
 
 private:
     // void setupUi(); // Helper to set up UI elements if not using .ui file
     void connectSignalsAndSlots();
+    QModelIndex selectedFolderIndex() const; // Current folder in the tree, or invalid for root
 
     // UI Elements (can be defined in a .ui file and accessed via ui->elementName)
     QLineEdit *folderPathLineEdit;
     QPushButton *browseButton;
+    QLineEdit *filterLineEdit;
     QTreeView *fileTreeView;
     QPushButton *selectAllButton;
     QPushButton *deselectAllButton;
     QPushButton *mergeButton;
     QStatusBar *statusBar; // Will use QMainWindow's default status bar
     QProgressBar *progressBar; // Added for the progress bar
+    QLabel *throughputLabel;   // MB/s and time left, shown next to the progress bar while merging
+    QLabel *estimateLabel;     // Files, size, lines and tokens of the current selection
+    QTimer *estimateTimer;     // Coalesces check-state changes into one estimate update
 
     QAction *actionRecursiveSelectByExtension; // Action for new recursive selection
+    QAction *actionSelectByContent; // Action for content-based selection
+    QAction *actionSelectByPredicate; // Action for size/date/depth selection
+    QAction *actionSkipBinaryFiles;   // Checkable: bulk selections leave binaries unchecked
+    QAction *actionSaveProfile;       // Save the current selection as a named profile
+    QAction *actionApplyProfile;      // Reapply a saved profile
+    QActionGroup *compressionGroup;   // Output compression choice (action data: OutputCompression)
+    QAction *actionSplitOutput;       // Opens the part size/token limit dialog
+    QAction *actionRedactionRules;    // Opens the literal/pattern redaction dialog
+    QAction *actionSizeLimits;        // Opens the per-file head/tail and output limit dialog
+    QAction *actionDeduplicate;       // Checkable: repeated content becomes a reference
+    QAction *actionIncremental;       // Checkable: reuse unchanged ranges of the last output
+    QAction *actionIndexFooter;       // Checkable: end the output with a section index
+    QAction *actionResumable;         // Checkable: checkpoint merges and resume interrupted ones
+    QAction *actionConcurrentMerges;  // Asks how many queued merges may run at once
+    QActionGroup *cacheModeGroup;     // Page cache use while merging (action data: CacheMode)
+    QList<QAction *> transformActions; // Checkable, one per Transform::Stage (action data)
+    QPushButton *cancelScanButton;  // Shown in the status bar while a content scan runs
+    QPushButton *cancelMergeButton; // Shown in the status bar while merges run or wait; cancels them all
 
     CustomFileModel *fileModel;
     FileMergerLogic *mergerLogic;
+    QList<int> mergeJobs; // Queued or running merges started from this window, oldest first
+    int shownJobId;       // The merge whose progress the status bar shows, 0 = none
     QString currentFolderPath;
+    qint64 splitLimit;    // Per output part, in splitUnit; 0 = single output file
+    SplitUnit splitUnit;
+    RedactionRules redactionRules; // Applied to every merge; empty = off
+    SourceCap sourceCap;  // Per source; disabled by default
+    qint64 outputLimit;   // In bytes; 0 = no limit
 };
 #endif // MAINWINDOW_H 
\ No newline at end of file
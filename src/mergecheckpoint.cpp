@@ -0,0 +1,102 @@
+// mergecheckpoint.cpp
+
+#include "mergecheckpoint.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QDebug>
+
+namespace {
+
+constexpr int CheckpointVersion = 1;
+
+// 64-bit values are stored as strings; JSON numbers are doubles.
+QString toText(qint64 value)
+{
+    return QString::number(value);
+}
+
+qint64 fromText(const QJsonValue &value)
+{
+    return value.toString().toLongLong();
+}
+
+} // namespace
+
+QString MergeCheckpoint::pathFor(const QString &outputPath)
+{
+    return outputPath + QStringLiteral(".checkpoint.json");
+}
+
+QStringList MergeCheckpoint::findAll(const QString &dir)
+{
+    // Output names carry a sortable timestamp, so reversed name order is newest first.
+    const QStringList names = QDir(dir).entryList({QStringLiteral("collated_files_*.checkpoint.json")},
+                                                  QDir::Files, QDir::Name | QDir::Reversed);
+    QStringList paths;
+    for (const QString &name : names) {
+        paths.append(QDir(dir).filePath(name));
+    }
+    return paths;
+}
+
+// Replaced atomically (and synced), so a crash leaves the previous checkpoint.
+bool MergeCheckpoint::save(const QString &path, QString *errorMessage) const
+{
+    QJsonObject root;
+    root["version"] = CheckpointVersion;
+    root["output"] = QFileInfo(outputPath).fileName(); // Relative, like the manifest
+    root["settings"] = settings;
+    root["sourceCount"] = sourceCount;
+    root["sourceListXxh64"] = QString::number(sourceListHash, 16);
+    root["sourcesDone"] = sourcesDone;
+    root["sourcesDoneXxh64"] = QString::number(sourcesDoneHash, 16);
+    root["fileBytes"] = toText(fileBytes);
+    root["bytesWritten"] = toText(bytesWritten);
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        *errorMessage = file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
+    if (!file.commit()) {
+        *errorMessage = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool MergeCheckpoint::load(const QString &path, MergeCheckpoint &checkpoint)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    const QJsonObject root = document.object();
+    if (parseError.error != QJsonParseError::NoError || root["version"].toInt() != CheckpointVersion) {
+        qWarning() << "MergeCheckpoint: ignoring unreadable checkpoint" << path << parseError.errorString();
+        return false;
+    }
+
+    checkpoint = MergeCheckpoint();
+    checkpoint.outputPath = QFileInfo(path).dir().filePath(root["output"].toString());
+    checkpoint.settings = root["settings"].toString();
+    checkpoint.sourceCount = root["sourceCount"].toInt();
+    checkpoint.sourceListHash = root["sourceListXxh64"].toString().toULongLong(nullptr, 16);
+    checkpoint.sourcesDone = root["sourcesDone"].toInt();
+    checkpoint.sourcesDoneHash = root["sourcesDoneXxh64"].toString().toULongLong(nullptr, 16);
+    checkpoint.fileBytes = fromText(root["fileBytes"]);
+    checkpoint.bytesWritten = fromText(root["bytesWritten"]);
+    if (checkpoint.sourcesDone < 0 || checkpoint.sourcesDone > checkpoint.sourceCount
+        || checkpoint.fileBytes < 0 || checkpoint.bytesWritten < 0) {
+        qWarning() << "MergeCheckpoint: values out of range in" << path;
+        return false;
+    }
+    return true;
+}
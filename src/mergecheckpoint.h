@@ -0,0 +1,36 @@
+// mergecheckpoint.h
+// Sidecar recording how far an interrupted merge got.
+
+#ifndef MERGECHECKPOINT_H
+#define MERGECHECKPOINT_H
+
+#include <QString>
+#include <QStringList>
+
+// Written as <output>.checkpoint.json while a merge with
+// MergeOptions::checkpointing runs, and removed once the output is complete.
+// The merged data lives in MergeOutput::temporaryPath(outputPath) until then.
+//
+// It stays small however many sources there are: the sources already merged
+// are the first sourcesDone of the list, recognized by a hash of their paths,
+// sizes and modification times.
+struct MergeCheckpoint
+{
+    QString outputPath;           // The final output
+    QString settings;             // Options that change the output bytes, see MergeWorker
+    int sourceCount = 0;
+    quint64 sourceListHash = 0;   // XXH64 of every source path, in order
+    int sourcesDone = 0;          // Sources completely written
+    quint64 sourcesDoneHash = 0;  // Of (path, size, mtime) of each of them
+    qint64 fileBytes = 0;         // Bytes of the output file holding them
+    qint64 bytesWritten = 0;      // The same before compression
+
+    static QString pathFor(const QString &outputPath);
+    // Checkpoints of the collated_files_* outputs in dir, newest first.
+    static QStringList findAll(const QString &dir);
+
+    bool save(const QString &path, QString *errorMessage) const;
+    static bool load(const QString &path, MergeCheckpoint &checkpoint);
+};
+
+#endif // MERGECHECKPOINT_H
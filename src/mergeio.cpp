@@ -0,0 +1,1125 @@
+// mergeio.cpp
+
+#include "mergeio.h"
+#include <QCoreApplication> // For tr
+#include <QDebug>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QSaveFile>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h> // For madvise
+#include <unistd.h>   // For pread, fsync
+#include <fcntl.h>    // For posix_fadvise, fallocate, O_DIRECT
+#include <cerrno>
+#endif
+#include <cstring> // For memchr, strerror
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h> // For copy_file_range on older C libraries
+#endif
+
+namespace {
+
+// Asks the kernel to drop length bytes of file's cached pages from offset
+// (0: to the end). Dirty pages stay; see MergeOutput::releaseWritten().
+void dropCachedPages(const QFile &file, qint64 offset = 0, qint64 length = 0)
+{
+#ifdef Q_OS_LINUX
+    ::posix_fadvise(file.handle(), off_t(offset), off_t(length), POSIX_FADV_DONTNEED);
+#else
+    Q_UNUSED(file)
+    Q_UNUSED(offset)
+    Q_UNUSED(length)
+#endif
+}
+
+// Drops a source's pages when it goes out of scope, after any mapping of it
+// was released (mapped pages are not dropped).
+struct CacheDropGuard {
+    const QFile &file;
+    bool enabled;
+    ~CacheDropGuard()
+    {
+        if (enabled && file.isOpen()) {
+            dropCachedPages(file);
+        }
+    }
+};
+
+} // namespace
+
+// --- SourceReader Implementation ---
+SourceReader::SourceReader(qint64 mapThreshold)
+    : mapThreshold(mapThreshold), lastMapped(false), lastSliced(false), dropCache(false) {}
+
+void SourceReader::setDropCache(bool drop)
+{
+    dropCache = drop;
+}
+
+bool SourceReader::read(const QString &path, const ChunkHandler &handler)
+{
+    lastError.clear();
+    lastMapped = false;
+    lastSliced = false;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        lastError = file.errorString();
+        return false;
+    }
+    const CacheDropGuard dropGuard{file, dropCache};
+
+    const qint64 size = file.size();
+    if (size <= 0) {
+        return true; // Empty file (or one whose size the system does not report)
+    }
+
+    return deliverRange(file, 0, size, handler);
+}
+
+// Hands length bytes of file from offset to handler: mapped, in one call,
+// from mapThreshold on, and otherwise through the reused buffer.
+bool SourceReader::deliverRange(QFile &file, qint64 offset, qint64 length, const ChunkHandler &handler)
+{
+    lastMapped = false;
+    lastSliced = false;
+    if (length <= 0) {
+        return true;
+    }
+
+    if (length >= mapThreshold) {
+        uchar *mapped = file.map(offset, length);
+        if (mapped) {
+#ifdef Q_OS_UNIX
+            // madvise() wants a page-aligned start; Qt mapped from the page holding offset.
+            const quintptr pageMask = quintptr(::sysconf(_SC_PAGESIZE)) - 1;
+            uchar *pageStart = reinterpret_cast<uchar *>(quintptr(mapped) & ~pageMask);
+            ::madvise(pageStart, size_t(mapped - pageStart + length), MADV_SEQUENTIAL);
+#endif
+            lastMapped = true;
+            const bool ok = handler(reinterpret_cast<const char *>(mapped), length);
+            file.unmap(mapped);
+            if (!ok) {
+                lastError = QCoreApplication::tr("读取已中止。 (Reading was aborted.)");
+            }
+            return ok;
+        }
+        qDebug() << "SourceReader: mapping failed, reading instead:" << file.fileName() << file.errorString();
+    }
+
+    return readIntoBuffer(file, offset, length, handler);
+}
+
+// Reads length bytes from offset into the reused buffer and hands them over,
+// all at once when they fit in ReadSliceBytes and otherwise one slice at a
+// time; the handler sees a cancel between slices. Stops early at the end of a
+// file that shrank since its size was taken.
+bool SourceReader::readIntoBuffer(QFile &file, qint64 offset, qint64 length, const ChunkHandler &handler)
+{
+    const qint64 sliceBytes = qMin(length, ReadSliceBytes);
+    if (buffer.size() < sliceBytes) {
+        buffer.resize(sliceBytes);
+    }
+    lastSliced = length > sliceBytes;
+
+    for (qint64 done = 0; done < length;) {
+        const qint64 wanted = qMin(sliceBytes, length - done);
+        const qint64 n = readAt(file, offset + done, buffer.data(), wanted);
+        if (n < 0) {
+            return false;
+        }
+        if (n > 0 && !handler(buffer.constData(), n)) {
+            lastError = QCoreApplication::tr("读取已中止。 (Reading was aborted.)");
+            return false;
+        }
+        if (n < wanted) {
+            break; // File shrank since we asked for its size
+        }
+        done += n;
+    }
+    return true;
+}
+
+// Positioned read of up to size bytes; returns the count read, -1 on error.
+qint64 SourceReader::readAt(QFile &file, qint64 offset, char *data, qint64 size)
+{
+    qint64 total = 0;
+#ifdef Q_OS_UNIX
+    // Positional reads on the raw descriptor skip QFile's own buffering.
+    const int fd = file.handle();
+    while (total < size) {
+        const ssize_t n = ::pread(fd, data + total, size_t(size - total), off_t(offset + total));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            lastError = QString::fromLocal8Bit(strerror(errno));
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        total += n;
+    }
+#else
+    if (!file.seek(offset) || (total = file.read(data, size)) < 0) {
+        lastError = file.errorString();
+        return -1;
+    }
+#endif
+    return total;
+}
+
+// End of the first lines lines (past the last line break), or size if the
+// file has no more lines than that, or -1 on error.
+qint64 SourceReader::headLinesEnd(QFile &file, qint64 size, qint64 lines)
+{
+    if (lines <= 0) {
+        return 0;
+    }
+    const qint64 limit = qMin(size, MaxLineEndBytes);
+    qint64 found = 0;
+    char chunk[64 * 1024];
+    for (qint64 pos = 0; pos < limit;) {
+        const qint64 n = readAt(file, pos, chunk, qMin<qint64>(sizeof(chunk), limit - pos));
+        if (n <= 0) {
+            return n < 0 ? -1 : pos;
+        }
+        for (const char *p = chunk; (p = static_cast<const char *>(std::memchr(p, '\n', size_t(chunk + n - p))));) {
+            ++p;
+            if (++found == lines) {
+                return pos + (p - chunk);
+            }
+        }
+        pos += n;
+    }
+    return limit;
+}
+
+// Start of the last lines lines (a line break at the very end does not
+// start another one), 0 if the file has no more lines, or -1 on error.
+qint64 SourceReader::tailLinesStart(QFile &file, qint64 size, qint64 lines)
+{
+    if (lines <= 0) {
+        return size;
+    }
+    const qint64 floor = qMax<qint64>(0, size - MaxLineEndBytes);
+    qint64 found = 0;
+    char chunk[64 * 1024];
+    for (qint64 pos = size; pos > floor;) {
+        const qint64 start = qMax<qint64>(floor, pos - qint64(sizeof(chunk)));
+        const qint64 n = readAt(file, start, chunk, pos - start);
+        if (n != pos - start) {
+            return -1; // Error, or the file shrank under us
+        }
+        for (qint64 i = n - 1; i >= 0; --i) {
+            if (chunk[i] != '\n' || start + i == size - 1) {
+                continue; // The break ending the last line
+            }
+            if (++found == lines) {
+                return start + i + 1;
+            }
+        }
+        pos = start;
+    }
+    return floor;
+}
+
+bool SourceReader::readEnds(const QString &path, const SourceCap &cap, Ends *ends, const ChunkHandler &head,
+                            const ChunkHandler &tail)
+{
+    lastError.clear();
+    lastMapped = false;
+    lastSliced = false;
+    *ends = Ends();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        lastError = file.errorString();
+        return false;
+    }
+    const CacheDropGuard dropGuard{file, dropCache};
+    const qint64 size = file.size();
+    qint64 headEnd = 0;
+    qint64 tailStart = size;
+    if (cap.unit == SourceCap::Bytes) {
+        if (size <= cap.head + cap.tail) {
+            return true;
+        }
+        headEnd = cap.head;
+        tailStart = size - cap.tail;
+    } else {
+        headEnd = headLinesEnd(file, size, cap.head);
+        tailStart = tailLinesStart(file, size, cap.tail);
+        if (headEnd < 0 || tailStart < 0) {
+            if (lastError.isEmpty()) {
+                lastError = QCoreApplication::tr("文件在读取时被修改。 (The file changed while being read.)");
+            }
+            return false;
+        }
+        if (headEnd >= tailStart) {
+            return true; // The ends meet: keep the whole file
+        }
+    }
+
+    ends->truncated = true;
+    ends->headLength = headEnd;
+    ends->tailOffset = tailStart;
+    ends->tailLength = size - tailStart;
+    ends->omitted = tailStart - headEnd;
+    return deliverRange(file, 0, headEnd, head) && deliverRange(file, tailStart, size - tailStart, tail);
+}
+
+QString SourceReader::errorString() const
+{
+    return lastError;
+}
+
+bool SourceReader::lastReadWasMapped() const
+{
+    return lastMapped;
+}
+
+bool SourceReader::lastReadWasSliced() const
+{
+    return lastSliced;
+}
+
+// --- MergeOutput Implementation ---
+MergeOutput::MergeOutput()
+    : compression(OutputCompression::None), compressionLevel(-1), blockSize(BufferSize), totalWritten(0),
+      cacheMode(CacheMode::Normal), direct(false), directBuffer(nullptr), directFill(0),
+      fileOffset(0), writebackStart(0), droppedUpTo(0), preallocated(false)
+{
+}
+
+MergeOutput::~MergeOutput()
+{
+    if (file.isOpen()) {
+        discard(); // Never closed: not a finished output
+    }
+    qFreeAligned(directBuffer);
+}
+
+QString MergeOutput::temporaryPath(const QString &path)
+{
+    return path + QStringLiteral(".tmp");
+}
+
+void MergeOutput::setCacheMode(CacheMode mode)
+{
+    cacheMode = mode;
+}
+
+bool MergeOutput::open(const QString &path, OutputCompression compression, int compressionLevel)
+{
+    if (!BlockCompression::isAvailable(compression)) {
+        lastError = QCoreApplication::tr("此版本不支持所选压缩格式。 (The selected compression format is not available in this build.)");
+        return false;
+    }
+    this->compression = compression;
+    this->compressionLevel = compressionLevel;
+    blockSize = compression == OutputCompression::None ? BufferSize : BlockCompression::blockSize(compression);
+
+    targetPath = path;
+    file.setFileName(temporaryPath(path));
+    totalWritten = 0;
+    buffer.clear();
+    buffer.reserve(blockSize);
+    fileOffset = writebackStart = droppedUpTo = 0;
+    directFill = 0;
+    direct = false;
+    preallocated = false;
+    if (cacheMode == CacheMode::DirectOutput && openDirect(file.fileName())) {
+        return true;
+    }
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+        lastError = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+// Continues the temporary output of an interrupted merge: the file is cut
+// back to fileBytes, the end of its last checkpoint, and written on from
+// there. A DirectOutput cache mode drops pages instead, as O_DIRECT could not
+// continue at an unaligned offset.
+bool MergeOutput::reopen(const QString &path, qint64 fileBytes, qint64 bytesWritten,
+                         OutputCompression compression, int compressionLevel)
+{
+    if (!BlockCompression::isAvailable(compression)) {
+        lastError = QCoreApplication::tr("此版本不支持所选压缩格式。 (The selected compression format is not available in this build.)");
+        return false;
+    }
+    this->compression = compression;
+    this->compressionLevel = compressionLevel;
+    blockSize = compression == OutputCompression::None ? BufferSize : BlockCompression::blockSize(compression);
+
+    targetPath = path;
+    file.setFileName(temporaryPath(path));
+    buffer.clear();
+    buffer.reserve(blockSize);
+    directFill = 0;
+    direct = false;
+    preallocated = false;
+    if (cacheMode == CacheMode::DirectOutput) {
+        cacheMode = CacheMode::DropAfterUse;
+    }
+    // ReadWrite, because WriteOnly alone would truncate the file.
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+        lastError = file.errorString();
+        return false;
+    }
+    if (file.size() < fileBytes) {
+        lastError = QCoreApplication::tr("临时输出文件比检查点短。 (The temporary output is shorter than its checkpoint.)");
+        file.close();
+        return false;
+    }
+    if (!file.resize(fileBytes) || !file.seek(fileBytes)) {
+        lastError = file.errorString();
+        file.close();
+        return false;
+    }
+    totalWritten = bytesWritten;
+    fileOffset = writebackStart = droppedUpTo = fileBytes;
+    return true;
+}
+
+bool MergeOutput::preallocate(qint64 size)
+{
+#ifdef Q_OS_LINUX
+    // KEEP_SIZE: the file still ends at the last byte written, so an
+    // interrupted merge leaves only what it wrote.
+    if (size > 0 && ::fallocate(file.handle(), FALLOC_FL_KEEP_SIZE, 0, off_t(size)) != 0) {
+        if (errno == ENOSPC) {
+            lastError = QString::fromLocal8Bit(strerror(errno));
+            return false;
+        }
+        qDebug() << "MergeOutput: not preallocating:" << strerror(errno);
+        return true;
+    }
+    preallocated = size > 0;
+#else
+    Q_UNUSED(size)
+#endif
+    return true;
+}
+
+bool MergeOutput::openDirect(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    if (!directBuffer) {
+        directBuffer = static_cast<char *>(qMallocAligned(DirectBufferSize, DirectAlignment));
+        if (!directBuffer) {
+            return false;
+        }
+    }
+    const int fd = ::open(QFile::encodeName(path).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        qDebug() << "MergeOutput: O_DIRECT refused, writing through the page cache:" << path << strerror(errno);
+        return false;
+    }
+    if (!file.open(fd, QIODevice::WriteOnly | QIODevice::Unbuffered, QFileDevice::AutoCloseHandle)) {
+        ::close(fd);
+        return false;
+    }
+    direct = true;
+    return true;
+#else
+    Q_UNUSED(path)
+    return false;
+#endif
+}
+
+bool MergeOutput::write(const char *data, qint64 size)
+{
+    if (size <= 0) {
+        return true;
+    }
+    totalWritten += size;
+
+    if (compression != OutputCompression::None) {
+        // Everything goes through whole blocks, copied out of the (possibly
+        // mapped) source because compression finishes after it is released.
+        while (size > 0) {
+            const qint64 chunk = qMin(size, blockSize - buffer.size());
+            buffer.append(data, chunk);
+            data += chunk;
+            size -= chunk;
+            if (buffer.size() == blockSize && !submitBlock()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (buffer.size() + size <= BufferSize) {
+        buffer.append(data, size);
+        return true;
+    }
+    if (!flushBuffer()) {
+        return false;
+    }
+    if (size < BufferSize) {
+        buffer.append(data, size);
+        return true;
+    }
+    return writeToFile(data, size); // Large blocks (mapped files) are written without a copy
+}
+
+bool MergeOutput::submitBlock()
+{
+    if (!buffer.isEmpty()) {
+        const OutputCompression format = compression;
+        const int level = compressionLevel;
+        pendingBlocks.push_back(QtConcurrent::run([block = buffer, format, level]() {
+            return BlockCompression::compress(block, format, level);
+        }));
+        buffer = QByteArray();
+        buffer.reserve(blockSize);
+    }
+    // Two blocks per pool thread keep every thread busy while bounding memory.
+    return writeCompletedBlocks(2 * qMax(1, QThreadPool::globalInstance()->maxThreadCount()));
+}
+
+// Writes finished blocks from the front, waiting for the oldest ones while
+// more than maxPending are outstanding.
+bool MergeOutput::writeCompletedBlocks(int maxPending)
+{
+    while (!pendingBlocks.empty()
+           && (int(pendingBlocks.size()) > maxPending || pendingBlocks.front().isFinished())) {
+        const QByteArray compressed = pendingBlocks.front().result();
+        pendingBlocks.pop_front();
+        if (compressed.isEmpty()) {
+            lastError = QCoreApplication::tr("压缩失败。 (Compression failed.)");
+            return false;
+        }
+        if (!writeToFile(compressed.constData(), compressed.size())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MergeOutput::flushBuffer()
+{
+    if (compression != OutputCompression::None) {
+        return submitBlock();
+    }
+    if (buffer.isEmpty()) {
+        return true;
+    }
+    const bool ok = writeToFile(buffer.constData(), buffer.size());
+    buffer.clear();
+    return ok;
+}
+
+bool MergeOutput::writeToFile(const char *data, qint64 size)
+{
+    if (direct) {
+        return writeDirect(data, size);
+    }
+    while (size > 0) {
+        const qint64 n = file.write(data, size);
+        if (n <= 0) {
+            lastError = file.errorString();
+            return false;
+        }
+        data += n;
+        size -= n;
+        fileOffset += n;
+    }
+    releaseWritten(false);
+    return true;
+}
+
+// Collects data in the aligned buffer and writes it whenever the buffer is
+// full; the unaligned rest is left for finishDirect().
+bool MergeOutput::writeDirect(const char *data, qint64 size)
+{
+    while (size > 0) {
+        const qint64 chunk = qMin(size, DirectBufferSize - directFill);
+        std::memcpy(directBuffer + directFill, data, size_t(chunk));
+        directFill += chunk;
+        data += chunk;
+        size -= chunk;
+        if (directFill == DirectBufferSize) {
+            if (!writeRaw(directBuffer, DirectBufferSize)) {
+                return false;
+            }
+            directFill = 0;
+        }
+    }
+    return true;
+}
+
+// Writes to the descriptor at the current offset, bypassing QFile (whose
+// position is not used in direct mode).
+bool MergeOutput::writeRaw(const char *data, qint64 size)
+{
+#ifdef Q_OS_UNIX
+    while (size > 0) {
+        const ssize_t n = ::write(file.handle(), data, size_t(size));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            lastError = QString::fromLocal8Bit(strerror(errno));
+            return false;
+        }
+        data += n;
+        size -= n;
+        fileOffset += n;
+    }
+    return true;
+#else
+    Q_UNUSED(data)
+    Q_UNUSED(size)
+    return false;
+#endif
+}
+
+// The last block is shorter than the alignment allows, so O_DIRECT is turned
+// off for it; releaseWritten() then drops the few pages it leaves cached.
+bool MergeOutput::finishDirect()
+{
+#ifdef Q_OS_LINUX
+    if (directFill > 0) {
+        const int flags = ::fcntl(file.handle(), F_GETFL);
+        if (flags < 0 || ::fcntl(file.handle(), F_SETFL, flags & ~O_DIRECT) < 0) {
+            lastError = QString::fromLocal8Bit(strerror(errno));
+            return false;
+        }
+        if (!writeRaw(directBuffer, directFill)) {
+            return false;
+        }
+        directFill = 0;
+    }
+#endif
+    return true;
+}
+
+// Dirty pages cannot be dropped, so output goes out in windows: each full
+// window has its writeback started, and the window before it, which has had
+// a window's worth of writing time to reach the disk, is waited for and
+// dropped. final waits for and drops everything that is left.
+void MergeOutput::releaseWritten(bool final)
+{
+#ifdef Q_OS_LINUX
+    if (cacheMode == CacheMode::Normal || (!final && fileOffset - writebackStart < WritebackWindow)) {
+        return;
+    }
+    const int fd = file.handle();
+    if (fileOffset > writebackStart) {
+        ::sync_file_range(fd, writebackStart, fileOffset - writebackStart, SYNC_FILE_RANGE_WRITE);
+    }
+    const qint64 dropUpTo = final ? fileOffset : writebackStart;
+    if (dropUpTo > droppedUpTo) {
+        ::sync_file_range(fd, droppedUpTo, dropUpTo - droppedUpTo,
+                          SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        dropCachedPages(file, droppedUpTo, dropUpTo - droppedUpTo);
+        droppedUpTo = dropUpTo;
+    }
+    writebackStart = fileOffset;
+#else
+    Q_UNUSED(final)
+#endif
+}
+
+bool MergeOutput::appendRange(QFile &source, qint64 offset, qint64 length)
+{
+    if (compression != OutputCompression::None) {
+        lastError = QStringLiteral("appendRange() needs uncompressed output");
+        return false;
+    }
+    if (!flushBuffer()) {
+        return false;
+    }
+    totalWritten += length;
+    const qint64 rangeOffset = offset;
+    const qint64 rangeLength = length;
+
+#ifdef Q_OS_LINUX
+    // The copy stays in the kernel: no page-cache round trip through user
+    // space, and extents are shared on btrfs/XFS (reflink) or NFS (server-side copy).
+    // An O_DIRECT output takes the copy through its aligned buffer instead.
+    if (!direct) {
+        qint64 sourceOffset = offset; // loff_t, which not every libc header exposes
+        qint64 targetOffset = fileOffset;
+        while (length > 0) {
+            const ssize_t n = ::syscall(SYS_copy_file_range, source.handle(), &sourceOffset,
+                                        file.handle(), &targetOffset, size_t(length), 0u);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                if (n < 0 && errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP) {
+                    lastError = QString::fromLocal8Bit(strerror(errno));
+                    return false;
+                }
+                break; // Unsupported here (or the source shrank): copy the rest by hand
+            }
+            length -= n;
+        }
+        // The kernel moved the descriptor's data, not QFile's idea of the position.
+        if (!file.seek(targetOffset)) {
+            lastError = file.errorString();
+            return false;
+        }
+        fileOffset = targetOffset;
+        offset = sourceOffset;
+        releaseWritten(false);
+    }
+#endif
+    const bool ok = length <= 0 || copyRangeByReading(source, offset, length);
+    if (cacheMode != CacheMode::Normal) {
+        // Readahead past the range stays; the next range usually starts there.
+        dropCachedPages(source, rangeOffset, rangeLength);
+    }
+    return ok;
+}
+
+bool MergeOutput::copyRangeByReading(QFile &source, qint64 offset, qint64 length)
+{
+    if (!source.seek(offset)) {
+        lastError = source.errorString();
+        return false;
+    }
+    QByteArray chunk(qMin<qint64>(length, 1024 * 1024), Qt::Uninitialized);
+    while (length > 0) {
+        const qint64 n = source.read(chunk.data(), qMin<qint64>(length, chunk.size()));
+        if (n <= 0) {
+            lastError = n < 0 ? source.errorString()
+                              : QCoreApplication::tr("先前的输出文件已被截断。 (The previous output file was truncated.)");
+            return false;
+        }
+        if (!writeToFile(chunk.constData(), n)) {
+            return false;
+        }
+        length -= n;
+    }
+    return true;
+}
+
+// Gets everything written so far onto the disk and reports how many bytes
+// of the file hold it; writing goes on afterwards. With compression the
+// partial block is compressed on its own, and in direct mode the unaligned
+// rest is written zero-padded without moving the write position, so the
+// next full block overwrites it.
+bool MergeOutput::sync(qint64 *fileBytes)
+{
+    if (!flushBuffer() || (compression != OutputCompression::None && !writeCompletedBlocks(0))) {
+        return false;
+    }
+#ifdef Q_OS_UNIX
+    if (direct && directFill > 0) {
+        const qint64 padded = (directFill + DirectAlignment - 1) / DirectAlignment * DirectAlignment;
+        std::memset(directBuffer + directFill, 0, size_t(padded - directFill));
+        qint64 done = 0;
+        while (done < padded) {
+            const ssize_t n = ::pwrite(file.handle(), directBuffer + done, size_t(padded - done), off_t(fileOffset + done));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                lastError = QString::fromLocal8Bit(strerror(errno));
+                return false;
+            }
+            done += n;
+        }
+    }
+    if (::fdatasync(file.handle()) != 0) {
+        lastError = QString::fromLocal8Bit(strerror(errno));
+        return false;
+    }
+#endif
+    *fileBytes = fileOffset + directFill;
+    return true;
+}
+
+// Closes the temporary file as it is, for a later reopen().
+void MergeOutput::suspend()
+{
+    buffer.clear();
+    directFill = 0;
+    for (QFuture<QByteArray> &pending : pendingBlocks) {
+        pending.waitForFinished();
+    }
+    pendingBlocks.clear();
+    file.close();
+}
+
+bool MergeOutput::close()
+{
+    bool ok = flushBuffer();
+    if (ok && compression != OutputCompression::None) {
+        ok = writeCompletedBlocks(0);
+    }
+    if (ok && direct) {
+        ok = finishDirect();
+    }
+    if (ok && file.isOpen()) {
+        releaseWritten(true);
+    }
+    for (QFuture<QByteArray> &pending : pendingBlocks) {
+        pending.waitForFinished(); // Only left over after an error
+    }
+    pendingBlocks.clear();
+    if (ok) {
+        ok = commit();
+    }
+    if (!ok) {
+        file.close();
+        file.remove();
+    }
+    return ok;
+}
+
+// Trims the unused preallocation (or the padding of a direct-mode sync()),
+// syncs the data and renames the file into place; rename() replaces an
+// existing target atomically.
+bool MergeOutput::commit()
+{
+#ifdef Q_OS_UNIX
+    const int fd = file.handle();
+    if (((preallocated || direct) && ::ftruncate(fd, off_t(fileOffset)) != 0) || ::fsync(fd) != 0) {
+        lastError = QString::fromLocal8Bit(strerror(errno));
+        return false;
+    }
+    file.close();
+    if (::rename(QFile::encodeName(file.fileName()).constData(), QFile::encodeName(targetPath).constData()) != 0) {
+        lastError = QString::fromLocal8Bit(strerror(errno));
+        return false;
+    }
+    // The rename itself is only durable once the directory is synced.
+    const int directory = ::open(QFile::encodeName(QFileInfo(targetPath).absolutePath()).constData(),
+                                 O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directory >= 0) {
+        ::fsync(directory);
+        ::close(directory);
+    }
+#else
+    file.close();
+    QFile::remove(targetPath);
+    if (!QFile::rename(file.fileName(), targetPath)) {
+        lastError = QCoreApplication::tr("无法重命名临时输出文件。 (Could not rename the temporary output file.)");
+        return false;
+    }
+#endif
+    return true;
+}
+
+void MergeOutput::discard()
+{
+    buffer.clear();
+    directFill = 0;
+    for (QFuture<QByteArray> &pending : pendingBlocks) {
+        pending.waitForFinished();
+    }
+    pendingBlocks.clear();
+    file.close();
+    if (!file.fileName().isEmpty()) {
+        file.remove();
+    }
+}
+
+qint64 MergeOutput::bytesWritten() const
+{
+    return totalWritten;
+}
+
+QString MergeOutput::fileName() const
+{
+    return targetPath;
+}
+
+QString MergeOutput::errorString() const
+{
+    return lastError;
+}
+
+// --- PartedOutput Implementation ---
+PartedOutput::PartedOutput(const QString &basePath, OutputCompression compression, int compressionLevel, qint64 partLimit)
+    : basePath(basePath), compression(compression), compressionLevel(compressionLevel),
+      partLimit(partLimit > 0 ? qMax(partLimit, MinPartLimit) : 0), cacheMode(CacheMode::Normal), expectedSize(0)
+{
+}
+
+void PartedOutput::setCacheMode(CacheMode mode)
+{
+    cacheMode = mode;
+}
+
+void PartedOutput::setExpectedSize(qint64 bytes)
+{
+    expectedSize = bytes;
+}
+
+PartedOutput::~PartedOutput()
+{
+    collectFinishedParts(true);
+}
+
+bool PartedOutput::isSplit() const
+{
+    return partLimit > 0;
+}
+
+QString PartedOutput::partPath(int number) const
+{
+    const QString suffix = ".txt" + BlockCompression::fileSuffix(compression);
+    if (!isSplit()) {
+        return basePath + suffix;
+    }
+    return basePath + QString("_part-%1").arg(number, 3, 10, QChar('0')) + suffix;
+}
+
+bool PartedOutput::open()
+{
+    return openNextPart();
+}
+
+bool PartedOutput::openNextPart()
+{
+    Part part;
+    part.path = partPath(parts.count() + 1);
+    parts.append(part);
+    current.reset(new MergeOutput);
+    current->setCacheMode(cacheMode);
+    if (!current->open(part.path, compression, compressionLevel)) {
+        lastError = current->errorString();
+        return false;
+    }
+    const qint64 remaining = expectedSize - totalBytesWritten();
+    const qint64 share = isSplit() ? qMin(partLimit, remaining) : remaining;
+    if (expectedSize > 0 && share > 0 && !current->preallocate(share)) {
+        lastError = current->errorString();
+        return false;
+    }
+    return true;
+}
+
+bool PartedOutput::resume(qint64 fileBytes, qint64 bytesWritten)
+{
+    if (isSplit()) {
+        lastError = QStringLiteral("resume() needs unsplit output");
+        return false;
+    }
+    Part part;
+    part.path = partPath(1);
+    part.bytes = bytesWritten;
+    parts.append(part);
+    current.reset(new MergeOutput);
+    current->setCacheMode(cacheMode);
+    if (!current->reopen(part.path, fileBytes, bytesWritten, compression, compressionLevel)) {
+        lastError = current->errorString();
+        return false;
+    }
+    return true;
+}
+
+bool PartedOutput::sync(qint64 *fileBytes)
+{
+    if (isSplit() || !current) {
+        lastError = QStringLiteral("sync() needs open, unsplit output");
+        return false;
+    }
+    if (!current->sync(fileBytes)) {
+        lastError = current->errorString();
+        return false;
+    }
+    return true;
+}
+
+// Hands the current part to the pool for its final flush and close.
+bool PartedOutput::finishCurrentPart()
+{
+    MergeOutput *part = current.release();
+    closingParts.push_back(QtConcurrent::run([part]() {
+        const QString error = part->close() ? QString() : part->fileName() + ": " + part->errorString();
+        delete part;
+        return error;
+    }));
+    return collectFinishedParts(false);
+}
+
+bool PartedOutput::collectFinishedParts(bool wait)
+{
+    bool ok = true;
+    while (!closingParts.empty() && (wait || closingParts.front().isFinished())) {
+        const QString error = closingParts.front().result();
+        closingParts.pop_front();
+        if (!error.isEmpty()) {
+            lastError = error;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool PartedOutput::beginSource(const QString &sourcePath, const QByteArray &header, const QByteArray &continuationHeader, qint64 contentSize)
+{
+    if (isSplit() && parts.last().bytes > 0 && parts.last().bytes + header.size() + contentSize > partLimit) {
+        if (!finishCurrentPart() || !openNextPart()) {
+            return false;
+        }
+    }
+    currentSource = sourcePath;
+    currentContinuationHeader = continuationHeader;
+    parts.last().sources.append(sourcePath);
+    return write(header);
+}
+
+bool PartedOutput::write(const char *data, qint64 size)
+{
+    while (size > 0) {
+        qint64 chunk = size;
+        if (isSplit()) {
+            const qint64 room = partLimit - parts.last().bytes;
+            if (room <= 0) {
+                // The source alone is larger than a part: continue it in the next one.
+                if (!finishCurrentPart() || !openNextPart()) {
+                    return false;
+                }
+                parts.last().sources.append(currentSource + QStringLiteral(" (continued)"));
+                if (!current->write(currentContinuationHeader)) {
+                    lastError = current->errorString();
+                    return false;
+                }
+                parts.last().bytes += currentContinuationHeader.size();
+                continue;
+            }
+            chunk = qMin(size, room);
+        }
+        if (!current->write(data, chunk)) {
+            lastError = current->errorString();
+            return false;
+        }
+        parts.last().bytes += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+bool PartedOutput::appendSourceRange(const QString &sourcePath, QFile &from, qint64 offset, qint64 length)
+{
+    if (isSplit()) {
+        lastError = QStringLiteral("appendSourceRange() needs unsplit output");
+        return false;
+    }
+    parts.last().sources.append(sourcePath);
+    if (!current->appendRange(from, offset, length)) {
+        lastError = current->errorString();
+        return false;
+    }
+    parts.last().bytes += length;
+    return true;
+}
+
+bool PartedOutput::close()
+{
+    bool ok = true;
+    if (current) {
+        ok = current->close();
+        if (!ok) {
+            lastError = current->errorString();
+        }
+        current.reset();
+    }
+    ok = collectFinishedParts(true) && ok;
+    if (ok && isSplit()) {
+        ok = writeIndex();
+    }
+    return ok;
+}
+
+// One line per part (file name, bytes, estimated tokens at BytesPerToken each),
+// followed by its sources, indented.
+bool PartedOutput::writeIndex()
+{
+    QSaveFile index(resultPath());
+    if (!index.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        lastError = index.errorString();
+        return false;
+    }
+    QTextStream out(&index);
+    for (const Part &part : parts) {
+        out << QFileInfo(part.path).fileName() << '\t' << part.bytes << " bytes\t~" << part.bytes / BytesPerToken << " tokens\n";
+        for (const QString &source : part.sources) {
+            out << "    " << source << '\n';
+        }
+    }
+    out.flush();
+    if (!index.commit()) {
+        lastError = index.errorString();
+        return false;
+    }
+    return true;
+}
+
+void PartedOutput::discard()
+{
+    if (current) {
+        current->discard();
+        current.reset();
+    }
+    collectFinishedParts(true);
+    for (const Part &part : parts) {
+        QFile::remove(part.path);
+    }
+    if (isSplit()) {
+        QFile::remove(resultPath());
+    }
+    parts.clear();
+}
+
+void PartedOutput::suspend()
+{
+    if (current) {
+        current->suspend();
+        current.reset();
+    }
+    parts.clear();
+}
+
+qint64 PartedOutput::bytesWritten() const
+{
+    return parts.isEmpty() ? 0 : parts.last().bytes;
+}
+
+qint64 PartedOutput::totalBytesWritten() const
+{
+    qint64 total = 0;
+    for (const Part &part : parts) {
+        total += part.bytes;
+    }
+    return total;
+}
+
+QString PartedOutput::resultPath() const
+{
+    return isSplit() ? basePath + QStringLiteral("_index.txt") : partPath(1);
+}
+
+QStringList PartedOutput::partPaths() const
+{
+    QStringList paths;
+    for (const Part &part : parts) {
+        paths.append(part.path);
+    }
+    return paths;
+}
+
+QString PartedOutput::fileName() const
+{
+    return parts.isEmpty() ? resultPath() : parts.last().path;
+}
+
+QString PartedOutput::errorString() const
+{
+    return lastError;
+}
@@ -0,0 +1,287 @@
+// mergeio.h
+// Input and output primitives used by MergeWorker.
+
+#ifndef MERGEIO_H
+#define MERGEIO_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QFuture>
+#include <QStringList>
+#include <deque>
+#include <functional>
+#include <memory>
+#include "blockcompression.h"
+
+// How a merge treats the page cache. A merge reads every source and writes
+// the output once, so by default it fills the cache with pages nobody will
+// read again and pushes out other processes' working sets.
+enum class CacheMode {
+    Normal,
+    // Drop a source's pages once it has been read and output pages once they
+    // have been written back (posix_fadvise DONTNEED; Linux only).
+    DropAfterUse,
+    // DropAfterUse, and the output is written with O_DIRECT from aligned
+    // buffers, so it never enters the cache. Falls back to DropAfterUse where
+    // the file system refuses O_DIRECT (e.g. tmpfs).
+    DirectOutput,
+};
+
+// Limits a source to its first head and last tail bytes or lines; a file
+// that is not longer than both together is kept whole.
+struct SourceCap {
+    enum Unit { Bytes, Lines };
+
+    qint64 head = 0;
+    qint64 tail = 0;
+    Unit unit = Bytes;
+
+    bool isEnabled() const { return head > 0 || tail > 0; }
+};
+
+// Reads a source file and hands its bytes to a callback without decoding or
+// copying them into an intermediate string. Large files are memory-mapped with
+// a sequential-access hint; small files are read with a single pread() into a
+// buffer that is reused across files. A large file that cannot be mapped is
+// read into that buffer a slice at a time, so it never grows past a slice.
+class SourceReader
+{
+public:
+    // Crossover measured with tst_mergeworker's benchSourceReader (warm page
+    // cache, Linux/ext4): one pread into a reused buffer beats map + munmap up
+    // to about 2-4 MiB, above that the mapping avoids the extra copy and wins.
+    static constexpr qint64 DefaultMapThreshold = 4 * 1024 * 1024;
+    // Unmapped files larger than this are delivered in slices of this size.
+    static constexpr qint64 ReadSliceBytes = 8 * 1024 * 1024;
+
+    // Returns false to stop reading.
+    using ChunkHandler = std::function<bool(const char *data, qint64 size)>;
+
+    explicit SourceReader(qint64 mapThreshold = DefaultMapThreshold);
+
+    // Advise the kernel to drop each file's cached pages once read() or
+    // readEnds() is done with it. Pages that were cached before are dropped
+    // too; merge inputs are rarely someone else's hot set.
+    void setDropCache(bool drop);
+
+    // Delivers the content of path to handler (nothing for an empty file): in
+    // a single call when it is mapped or fits in ReadSliceBytes, otherwise in
+    // consecutive slices of ReadSliceBytes, see lastReadWasSliced(). Returns
+    // false on an I/O error or when the handler asked to stop; errorString()
+    // tells which.
+    bool read(const QString &path, const ChunkHandler &handler);
+
+    // Where readEnds() cut a file. When the file is not longer than the cap,
+    // truncated is false and nothing has been read.
+    struct Ends {
+        bool truncated = false;
+        qint64 headLength = 0; // From the start of the file
+        qint64 tailOffset = 0; // In the file
+        qint64 tailLength = 0;
+        qint64 omitted = 0;    // Bytes between head and tail
+    };
+
+    // In Lines mode each end also stops after this many bytes, so a file
+    // without line breaks is capped as well.
+    static constexpr qint64 MaxLineEndBytes = 4 * 1024 * 1024;
+
+    // Delivers only the ends of path that cap keeps, the head to head and
+    // then the tail to tail, each the way read() delivers a file; the middle
+    // is never read. Bytes mode finds the ends from the size alone, Lines
+    // mode by a scan for line breaks from either end. ends is filled in
+    // before the first delivery. Returns false on an I/O error or when a
+    // handler asked to stop.
+    bool readEnds(const QString &path, const SourceCap &cap, Ends *ends, const ChunkHandler &head, const ChunkHandler &tail);
+
+    QString errorString() const;
+    bool lastReadWasMapped() const;
+    bool lastReadWasSliced() const; // Already set when the first slice arrives
+
+private:
+    bool deliverRange(QFile &file, qint64 offset, qint64 length, const ChunkHandler &handler);
+    bool readIntoBuffer(QFile &file, qint64 offset, qint64 length, const ChunkHandler &handler);
+    qint64 readAt(QFile &file, qint64 offset, char *data, qint64 size);
+    qint64 headLinesEnd(QFile &file, qint64 size, qint64 lines);
+    qint64 tailLinesStart(QFile &file, qint64 size, qint64 lines);
+
+    qint64 mapThreshold;
+    QByteArray buffer; // Reused for all files that are not mapped, at most ReadSliceBytes
+    QString lastError;
+    bool lastMapped;
+    bool lastSliced;
+    bool dropCache;
+};
+
+// The merged output file. Small writes (section headers) are coalesced in a
+// buffer; large writes go straight to the file.
+//
+// The data goes to temporaryPath(path) next to the target; close() syncs it
+// to disk and renames it into place, so a crash or a cancelled merge never
+// leaves a partial file under the final name. Destroying an output that was
+// not closed discards it.
+//
+// With compression the data is cut into blocks that are compressed on the
+// global thread pool while the merge keeps reading; finished blocks are
+// written in order, with a bounded number in flight.
+class MergeOutput
+{
+public:
+    static constexpr qint64 BufferSize = 256 * 1024;
+
+    // Writeback is started for every WritebackWindow bytes written and the
+    // window before it is waited for and dropped, so with a CacheMode other
+    // than Normal the dirty and cached output stays under two windows.
+    static constexpr qint64 WritebackWindow = 8 * 1024 * 1024;
+    // O_DIRECT staging buffer; its address, size and every write offset are
+    // multiples of DirectAlignment.
+    static constexpr qint64 DirectBufferSize = 1024 * 1024;
+    static constexpr qint64 DirectAlignment = 4096;
+
+    MergeOutput();
+    ~MergeOutput();
+
+    void setCacheMode(CacheMode mode); // Before open()
+
+    static QString temporaryPath(const QString &path);
+
+    bool open(const QString &path, OutputCompression compression = OutputCompression::None, int compressionLevel = -1);
+    // Opens the temporary file of an earlier, interrupted output of path and
+    // continues it after its first fileBytes bytes, which hold bytesWritten
+    // bytes before compression (see sync()).
+    bool reopen(const QString &path, qint64 fileBytes, qint64 bytesWritten,
+                OutputCompression compression = OutputCompression::None, int compressionLevel = -1);
+    // Reserves size bytes ahead of the writes (fallocate, Linux only) so the
+    // file system can lay the output out in one piece instead of extending
+    // it write by write; close() releases what was not used. Returns false
+    // only when the space is not there.
+    bool preallocate(qint64 size);
+    bool write(const char *data, qint64 size);
+    bool write(const QByteArray &data) { return write(data.constData(), data.size()); }
+    // Appends length bytes of source starting at offset, in the kernel where
+    // possible (copy_file_range, which reflinks on file systems that share
+    // extents). Uncompressed output only.
+    bool appendRange(QFile &source, qint64 offset, qint64 length);
+    // Makes everything written so far durable and stores in fileBytes how
+    // much of the file it takes, for a checkpoint. The output stays open.
+    bool sync(qint64 *fileBytes);
+    bool close();
+    void discard(); // Closes and removes a partial output
+    void suspend(); // Closes and keeps a partial output, see reopen()
+
+    qint64 bytesWritten() const;
+    QString fileName() const;
+    QString errorString() const;
+
+private:
+    bool flushBuffer();
+    bool writeToFile(const char *data, qint64 size);
+    bool copyRangeByReading(QFile &source, qint64 offset, qint64 length);
+    bool submitBlock();
+    bool writeCompletedBlocks(int maxPending);
+    bool openDirect(const QString &path);
+    bool writeDirect(const char *data, qint64 size);
+    bool writeRaw(const char *data, qint64 size);
+    bool finishDirect();
+    void releaseWritten(bool final);
+    bool commit();
+
+    QFile file;
+    QString targetPath;
+    QByteArray buffer;
+    OutputCompression compression;
+    int compressionLevel;
+    qint64 blockSize;                        // Buffer size: BufferSize, or the compression block size
+    std::deque<QFuture<QByteArray>> pendingBlocks; // In output order
+    qint64 totalWritten;
+    QString lastError;
+
+    CacheMode cacheMode;
+    bool direct;              // The descriptor was opened with O_DIRECT
+    char *directBuffer;       // DirectBufferSize bytes, aligned
+    qint64 directFill;
+    qint64 fileOffset;        // Bytes in the file, i.e. after compression
+    qint64 writebackStart;    // Start of the window being written back
+    qint64 droppedUpTo;       // Everything before this was dropped
+    bool preallocated;
+};
+
+// Where the merge goes: a single MergeOutput, or numbered parts of at most
+// partLimit bytes each (before compression) plus an index file listing which
+// sources landed in which part.
+//
+// A source starts a new part when it would not fit into the current one, so
+// sources are only cut when they exceed the limit on their own; the piece in
+// the following part starts with a continuation header. A finished part is
+// flushed and closed on the thread pool while the next one is being written.
+class PartedOutput
+{
+public:
+    static constexpr qint64 MinPartLimit = 64 * 1024; // Keeps room for headers in every part
+    // Bytes per estimated token, for token split limits and the index.
+    static constexpr qint64 BytesPerToken = 4;
+
+    // basePath is the output path without extension, e.g. .../collated_files_<timestamp>.
+    PartedOutput(const QString &basePath, OutputCompression compression = OutputCompression::None,
+                 int compressionLevel = -1, qint64 partLimit = 0);
+    ~PartedOutput();
+
+    void setCacheMode(CacheMode mode); // Before open(), applies to every part
+    // Upper bound of the whole output, before compression; each part
+    // preallocates its share of it when opened. Before open().
+    void setExpectedSize(qint64 bytes);
+    bool open();
+    // Continues an interrupted output instead of open(), see
+    // MergeOutput::reopen(). Unsplit output only, like sync() and suspend().
+    bool resume(qint64 fileBytes, qint64 bytesWritten);
+    // Writes header for the next source, first moving to a new part when the
+    // header plus contentSize would overflow a non-empty current part.
+    bool beginSource(const QString &sourcePath, const QByteArray &header, const QByteArray &continuationHeader, qint64 contentSize);
+    bool write(const char *data, qint64 size);
+    bool write(const QByteArray &data) { return write(data.constData(), data.size()); }
+    // Appends an already merged source (header included) copied from a
+    // previous output. Uncompressed, unsplit output only.
+    bool appendSourceRange(const QString &sourcePath, QFile &from, qint64 offset, qint64 length);
+    bool close(); // Waits for every part and writes the index
+    void discard(); // Removes every part written so far
+    bool sync(qint64 *fileBytes); // See MergeOutput::sync()
+    void suspend(); // Keeps the temporary output for resume()
+
+    bool isSplit() const;
+    qint64 bytesWritten() const; // Into the current part, before compression
+    qint64 totalBytesWritten() const; // Into all parts, before compression
+    QString resultPath() const; // The output file, or the index when split
+    QStringList partPaths() const;
+    QString fileName() const;   // Current part
+    QString errorString() const;
+
+private:
+    Q_DISABLE_COPY(PartedOutput)
+
+    struct Part {
+        QString path;
+        QStringList sources; // Continued pieces are marked, see close()
+        qint64 bytes = 0;
+    };
+
+    QString partPath(int number) const;
+    bool openNextPart();
+    bool finishCurrentPart();
+    bool collectFinishedParts(bool wait);
+    bool writeIndex();
+
+    QString basePath;
+    OutputCompression compression;
+    int compressionLevel;
+    qint64 partLimit; // 0 = single file
+    CacheMode cacheMode;
+    qint64 expectedSize; // 0 = unknown
+    std::unique_ptr<MergeOutput> current;
+    QList<Part> parts;
+    QByteArray currentContinuationHeader; // Of the source being written
+    QString currentSource;
+    std::deque<QFuture<QString>> closingParts; // Error message per part, empty on success
+    QString lastError;
+};
+
+#endif // MERGEIO_H
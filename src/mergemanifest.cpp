@@ -0,0 +1,142 @@
+// mergemanifest.cpp
+
+#include "mergemanifest.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QDebug>
+
+namespace {
+
+constexpr int ManifestVersion = 2;
+
+// 64-bit values are stored as decimal strings; JSON numbers are doubles.
+QString toText(quint64 value)
+{
+    return QString::number(value);
+}
+
+quint64 fromText(const QJsonValue &value)
+{
+    return value.toString().toULongLong();
+}
+
+QJsonObject identityToJson(const FileIdentity &identity)
+{
+    QJsonObject object;
+    object["device"] = toText(identity.device);
+    object["inode"] = toText(identity.inode);
+    object["size"] = toText(quint64(identity.size));
+    object["mtime"] = toText(quint64(identity.lastModified));
+    return object;
+}
+
+FileIdentity identityFromJson(const QJsonObject &object)
+{
+    FileIdentity identity;
+    identity.device = fromText(object["device"]);
+    identity.inode = fromText(object["inode"]);
+    identity.size = qint64(fromText(object["size"]));
+    identity.lastModified = qint64(fromText(object["mtime"]));
+    return identity;
+}
+
+} // namespace
+
+QString MergeManifest::pathFor(const QString &outputPath)
+{
+    return outputPath + QStringLiteral(".manifest.json");
+}
+
+QString MergeManifest::findLatest(const QString &dir)
+{
+    // Output names carry a sortable timestamp, so the last one is the newest.
+    const QStringList names = QDir(dir).entryList({QStringLiteral("collated_files_*.manifest.json")},
+                                                  QDir::Files, QDir::Name);
+    return names.isEmpty() ? QString() : QDir(dir).filePath(names.last());
+}
+
+bool MergeManifest::save(const QString &path, QString *errorMessage) const
+{
+    QJsonArray sources;
+    for (const Entry &entry : entries) {
+        QJsonObject source;
+        source["path"] = entry.path;
+        source["identity"] = identityToJson(entry.identity);
+        source["xxh64"] = QString::number(entry.hash, 16);
+        source["offset"] = toText(quint64(entry.offset));
+        source["length"] = toText(quint64(entry.length));
+        source["headerLength"] = toText(quint64(entry.headerLength));
+        source["contentXxh64"] = QString::number(entry.contentHash, 16);
+        sources.append(source);
+    }
+    QJsonObject root;
+    root["version"] = ManifestVersion;
+    root["output"] = QFileInfo(outputPath).fileName(); // Relative: the pair can be moved together
+    root["outputIdentity"] = identityToJson(outputIdentity);
+    root["settings"] = settings;
+    root["sources"] = sources;
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        *errorMessage = file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
+    if (!file.commit()) {
+        *errorMessage = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool MergeManifest::load(const QString &path, MergeManifest &manifest)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    const QJsonObject root = document.object();
+    if (parseError.error != QJsonParseError::NoError || root["version"].toInt() != ManifestVersion) {
+        qWarning() << "MergeManifest: ignoring unreadable manifest" << path << parseError.errorString();
+        return false;
+    }
+
+    manifest = MergeManifest();
+    manifest.outputPath = QFileInfo(path).dir().filePath(root["output"].toString());
+    manifest.outputIdentity = identityFromJson(root["outputIdentity"].toObject());
+    manifest.settings = root["settings"].toString();
+    const QJsonArray sources = root["sources"].toArray();
+    manifest.entries.reserve(sources.size());
+    for (const QJsonValue &value : sources) {
+        const QJsonObject source = value.toObject();
+        Entry entry;
+        entry.path = source["path"].toString();
+        entry.identity = identityFromJson(source["identity"].toObject());
+        entry.hash = source["xxh64"].toString().toULongLong(nullptr, 16);
+        entry.offset = qint64(fromText(source["offset"]));
+        entry.length = qint64(fromText(source["length"]));
+        entry.headerLength = qint64(fromText(source["headerLength"]));
+        entry.contentHash = source["contentXxh64"].toString().toULongLong(nullptr, 16);
+        if (entry.offset < 0 || entry.length < 0 || entry.offset + entry.length > manifest.outputIdentity.size
+            || entry.headerLength < 0 || entry.headerLength > entry.length) {
+            qWarning() << "MergeManifest: range out of bounds in" << path;
+            return false;
+        }
+        manifest.indexByPath.insert(entry.path, manifest.entries.size());
+        manifest.entries.append(entry);
+    }
+    return true;
+}
+
+const MergeManifest::Entry *MergeManifest::find(const QString &sourcePath) const
+{
+    const auto it = indexByPath.constFind(sourcePath);
+    return it == indexByPath.constEnd() ? nullptr : &entries.at(it.value());
+}
@@ -0,0 +1,46 @@
+// mergemanifest.h
+// Sidecar manifest describing where each source landed in a merge output.
+
+#ifndef MERGEMANIFEST_H
+#define MERGEMANIFEST_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include "fileidentity.h"
+
+// Written next to an uncompressed, unsplit output as <output>.manifest.json.
+// An incremental re-merge copies the byte range of every source whose
+// identity is unchanged straight from the previous output instead of reading
+// the source again.
+struct MergeManifest
+{
+    struct Entry {
+        QString path;
+        FileIdentity identity; // Of the source when it was merged
+        quint64 hash = 0;      // XXH64 of the source bytes as read
+        qint64 offset = 0;     // Output range: header plus content
+        qint64 length = 0;
+        qint64 headerLength = 0;
+        quint64 contentHash = 0; // XXH64 of the content as written, see BundleIndex
+    };
+
+    QString outputPath;
+    FileIdentity outputIdentity; // The ranges are only valid for this exact file
+    QString settings;            // Options that change the output bytes, see MergeWorker
+    QList<Entry> entries;
+
+    static QString pathFor(const QString &outputPath);
+    // Newest manifest of a collated_files_* output in dir, or an empty string.
+    static QString findLatest(const QString &dir);
+
+    bool save(const QString &path, QString *errorMessage) const;
+    static bool load(const QString &path, MergeManifest &manifest);
+
+    const Entry *find(const QString &sourcePath) const;
+
+private:
+    QHash<QString, qsizetype> indexByPath; // Built by load()
+};
+
+#endif // MERGEMANIFEST_H
@@ -0,0 +1,570 @@
+// redaction.cpp
+
+#include "redaction.h"
+#include <QCoreApplication> // For tr
+#include <QDebug>
+#include <algorithm>
+#include <cctype> // For isxdigit
+#include <cstring> // For memchr
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define REDACTION_HAVE_SSE2
+#include <emmintrin.h>
+#include <QtAlgorithms> // For qCountTrailingZeroBits
+#endif
+
+namespace {
+
+const QString PatternPrefix = QStringLiteral("re:");
+
+// Patterns with an anchor each own one bit of the per-state anchor mask.
+constexpr int MaxAnchoredPatterns = 64;
+
+// With more distinct two-byte keyword prefixes than this, the scan falls
+// back to checking first bytes one at a time.
+constexpr int MaxVectorPrefixes = 8;
+
+bool isAsciiAlnum(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// Index of the last character of the escape whose letter is at p[i] (the
+// character after the backslash), skipping its operands, or -1 when the
+// escape is not one requiredLiteral() knows.
+qsizetype escapeEnd(const QByteArray &p, qsizetype i)
+{
+    // Skips a delimited operand starting at p[at], or returns -1.
+    const auto skipDelimited = [&p](qsizetype at) -> qsizetype {
+        if (at >= p.size()) {
+            return -1;
+        }
+        const char open = p.at(at);
+        const char close = open == '{' ? '}' : open == '<' ? '>' : open == '\'' ? '\'' : 0;
+        if (!close) {
+            return -1;
+        }
+        return p.indexOf(close, at + 1);
+    };
+    const auto skipWhile = [&p](qsizetype at, qsizetype max, bool (*accept)(char)) {
+        while (max-- > 0 && at + 1 < p.size() && accept(p.at(at + 1))) {
+            ++at;
+        }
+        return at;
+    };
+    const char c = p.at(i);
+    switch (c) {
+    case 'd': case 'D': case 'w': case 'W': case 's': case 'S': case 'h': case 'H':
+    case 'v': case 'V': case 'R': case 'X': case 'b': case 'B': case 'A': case 'z':
+    case 'Z': case 'G': case 'K': case 'n': case 'r': case 't': case 'f': case 'e':
+    case 'a': case 'E':
+        return i; // No operands
+    case 'x':
+        if (i + 1 < p.size() && p.at(i + 1) == '{') {
+            return skipDelimited(i + 1);
+        }
+        return skipWhile(i, 2, [](char d) { return std::isxdigit(uchar(d)) != 0; });
+    case 'o':
+        return skipDelimited(i + 1);
+    case 'c':
+        return i + 1 < p.size() ? i + 1 : -1;
+    case 'p':
+    case 'P':
+        if (i + 1 < p.size() && p.at(i + 1) == '{') {
+            return skipDelimited(i + 1);
+        }
+        return i + 1 < p.size() ? i + 1 : -1; // One-letter property, e.g. \pL
+    case 'N':
+        if (i + 1 < p.size() && p.at(i + 1) == '{') {
+            return skipDelimited(i + 1);
+        }
+        return i; // Any character but a newline
+    case 'Q': {
+        const qsizetype end = p.indexOf("\\E", i + 1);
+        return end < 0 ? p.size() - 1 : end + 1;
+    }
+    case 'g':
+        if (i + 1 < p.size() && (p.at(i + 1) == '{' || p.at(i + 1) == '<' || p.at(i + 1) == '\'')) {
+            return skipDelimited(i + 1);
+        }
+        if (i + 1 < p.size() && (p.at(i + 1) == '-' || p.at(i + 1) == '+')) {
+            ++i;
+        }
+        return skipWhile(i, 3, [](char d) { return d >= '0' && d <= '9'; });
+    case 'k':
+        return skipDelimited(i + 1);
+    default:
+        if (c >= '0' && c <= '9') {
+            // Back reference or octal code
+            return skipWhile(i, 2, [](char d) { return d >= '0' && d <= '9'; });
+        }
+        return -1;
+    }
+}
+
+} // namespace
+
+// --- RedactionRules ---
+
+bool RedactionRules::parse(const QString &text, RedactionRules *rules, QString *errorMessage)
+{
+    RedactionRules parsed;
+    parsed.replacement = rules->replacement;
+    const QStringList lines = text.split(QLatin1Char('\n'));
+    for (int i = 0; i < lines.count(); ++i) {
+        QString line = lines.at(i);
+        if (line.endsWith(QLatin1Char('\r'))) {
+            line.chop(1);
+        }
+        if (line.trimmed().isEmpty() || line.startsWith(QLatin1Char('#'))) {
+            continue;
+        }
+        if (!line.startsWith(PatternPrefix)) {
+            parsed.literals.append(line.toUtf8());
+            continue;
+        }
+        const QString pattern = line.mid(PatternPrefix.size());
+        const QRegularExpression regex(pattern);
+        if (pattern.isEmpty() || !regex.isValid()) {
+            if (errorMessage) {
+                *errorMessage = QCoreApplication::tr("第 %1 行的正则表达式无效: (Invalid regular expression on line %1:) %2")
+                                    .arg(i + 1).arg(regex.errorString());
+            }
+            return false;
+        }
+        parsed.patterns.append(pattern);
+    }
+    *rules = parsed;
+    return true;
+}
+
+QString RedactionRules::toText() const
+{
+    QStringList lines;
+    for (const QByteArray &literal : literals) {
+        lines.append(QString::fromUtf8(literal));
+    }
+    for (const QString &pattern : patterns) {
+        lines.append(PatternPrefix + pattern);
+    }
+    return lines.join(QLatin1Char('\n'));
+}
+
+// --- Redactor ---
+
+Redactor::Redactor(const RedactionRules &rules)
+    : replacement(rules.replacement)
+{
+    QList<QByteArray> keywords;
+    QList<quint64> keywordBits; // 0 for a literal, the pattern's bit for an anchor
+    for (const QByteArray &literal : rules.literals) {
+        if (!literal.isEmpty() && !literal.contains('\n')) {
+            keywords.append(literal);
+            keywordBits.append(0);
+        }
+    }
+
+    int anchored = 0;
+    for (const QString &source : rules.patterns) {
+        Pattern pattern;
+        pattern.regex = QRegularExpression(source);
+        if (!pattern.regex.isValid()) {
+            qWarning() << "Redactor: skipping invalid pattern" << source << pattern.regex.errorString();
+            continue;
+        }
+        pattern.regex.optimize();
+        const QByteArray anchor = requiredLiteral(source);
+        if (!anchor.isEmpty() && anchored < MaxAnchoredPatterns) {
+            pattern.anchorBit = quint64(1) << anchored++;
+            keywords.append(anchor);
+            keywordBits.append(pattern.anchorBit);
+        } else {
+            hasUnanchoredPattern = true;
+        }
+        patterns.append(pattern);
+    }
+    if (!keywords.isEmpty()) {
+        buildAutomaton(keywords, keywordBits);
+    }
+}
+
+bool Redactor::isActive() const
+{
+    return !transitions.isEmpty() || !patterns.isEmpty();
+}
+
+QByteArray Redactor::requiredLiteral(const QString &pattern)
+{
+    for (QChar c : pattern) {
+        if (c.unicode() > 0x7f) {
+            return QByteArray(); // Would never match a Latin-1 view of UTF-8 anyway
+        }
+    }
+    const QByteArray p = pattern.toLatin1();
+    for (qsizetype i = p.indexOf("(?"); i >= 0; i = p.indexOf("(?", i + 1)) {
+        if (i + 2 < p.size() && (isAsciiAlnum(p.at(i + 2)) || p.at(i + 2) == '-')) {
+            return QByteArray(); // Inline options such as (?i) change what a literal matches
+        }
+    }
+
+    // Runs of literal characters outside groups, minus any character a
+    // quantifier makes optional; the longest run is required by every match.
+    QByteArray best;
+    QByteArray run;
+    const auto endRun = [&]() {
+        if (run.size() > best.size()) {
+            best = run;
+        }
+        run.clear();
+    };
+    int depth = 0;
+    for (qsizetype i = 0; i < p.size(); ++i) {
+        char c = p.at(i);
+        switch (c) {
+        case '|':
+            return QByteArray(); // Alternation: no single literal is required
+        case '(':
+            ++depth;
+            endRun();
+            continue;
+        case ')':
+            --depth;
+            endRun();
+            continue;
+        case '[':
+            endRun();
+            ++i;
+            if (i < p.size() && p.at(i) == '^') {
+                ++i;
+            }
+            if (i < p.size() && p.at(i) == ']') {
+                ++i; // A leading ']' is literal
+            }
+            while (i < p.size() && p.at(i) != ']') {
+                if (p.at(i) == '[' && i + 1 < p.size() && (p.at(i + 1) == ':' || p.at(i + 1) == '.' || p.at(i + 1) == '=')) {
+                    // A POSIX class such as [:upper:] ends at its own ":]"
+                    const qsizetype end = p.indexOf(QByteArray(1, p.at(i + 1)) + ']', i + 2);
+                    if (end < 0) {
+                        return QByteArray();
+                    }
+                    i = end + 2;
+                } else if (p.at(i) == '\\') {
+                    if (i + 1 >= p.size() || p.at(i + 1) == 'Q') {
+                        return QByteArray(); // Quoted text may hold the closing ']'
+                    }
+                    const qsizetype end = isAsciiAlnum(p.at(i + 1)) ? escapeEnd(p, i + 1) : i + 1;
+                    if (end < 0) {
+                        return QByteArray();
+                    }
+                    i = end + 1;
+                } else {
+                    ++i;
+                }
+            }
+            if (i >= p.size()) {
+                return QByteArray(); // Unterminated class
+            }
+            continue;
+        case '.':
+        case '^':
+        case '$':
+        case '+':
+            endRun(); // After '+' the character repeats, so the run ends with it
+            continue;
+        case '*':
+        case '?':
+            run.chop(1); // The preceding character is optional
+            endRun();
+            continue;
+        case '{':
+            if (i + 1 < p.size() && p.at(i + 1) >= '0' && p.at(i + 1) <= '9') {
+                if (p.at(i + 1) == '0') {
+                    run.chop(1);
+                }
+                endRun();
+                while (i < p.size() && p.at(i) != '}') {
+                    ++i;
+                }
+                continue;
+            }
+            break; // A literal '{'
+        case '\\':
+            if (i + 1 >= p.size()) {
+                return QByteArray();
+            }
+            c = p.at(++i);
+            if (isAsciiAlnum(c)) {
+                // \d, \w, \b, back references, \x41, \p{Lu}, \Q...\E: none of
+                // them adds to a run, and their operands are skipped with them.
+                i = escapeEnd(p, i);
+                if (i < 0) {
+                    return QByteArray(); // Unknown escape: let the pattern always run
+                }
+                endRun();
+                continue;
+            }
+            break; // An escaped literal
+        default:
+            break;
+        }
+        if (depth == 0) {
+            run.append(c); // Inside a group the literal may be optional
+        }
+    }
+    endRun();
+    return best;
+}
+
+void Redactor::buildAutomaton(const QList<QByteArray> &keywords, const QList<quint64> &keywordBits)
+{
+    // Trie first, with -1 for missing edges
+    transitions = QList<qint32>(256, -1);
+    longestLiteral = QList<qint32>(1, 0);
+    anchorBits = QList<quint64>(1, 0);
+    for (qsizetype k = 0; k < keywords.count(); ++k) {
+        const QByteArray &keyword = keywords.at(k);
+        qint32 state = 0;
+        for (char c : keyword) {
+            qint32 &next = transitions[qsizetype(state) * 256 + uchar(c)];
+            if (next < 0) {
+                next = qint32(longestLiteral.count());
+                transitions.resize(transitions.size() + 256, -1);
+                longestLiteral.append(0);
+                anchorBits.append(0);
+            }
+            state = transitions.at(qsizetype(state) * 256 + uchar(c));
+        }
+        if (keywordBits.at(k) == 0) {
+            longestLiteral[state] = qMax(longestLiteral.at(state), qint32(keyword.size()));
+        } else {
+            anchorBits[state] |= keywordBits.at(k);
+        }
+        startByte[uchar(keyword.at(0))] = true;
+    }
+    for (const QByteArray &keyword : keywords) {
+        const bool isShort = keyword.size() == 1;
+        const char second = isShort ? 0 : keyword.at(1);
+        bool known = false;
+        for (qsizetype n = 0; n < prefixFirst.size() && !known; ++n) {
+            known = prefixFirst.at(n) == keyword.at(0)
+                    && (((shortPrefixes >> n) & 1) || (!isShort && prefixSecond.at(n) == second));
+        }
+        if (!known) {
+            if (isShort) {
+                shortPrefixes |= quint32(1) << prefixFirst.size();
+            }
+            prefixFirst.append(keyword.at(0));
+            prefixSecond.append(second);
+        }
+    }
+
+    // Breadth-first: fill missing edges from the failure state and inherit
+    // its outputs, turning the trie into a complete automaton.
+    QList<qint32> fail(longestLiteral.count(), 0);
+    QList<qint32> queue;
+    for (int b = 0; b < 256; ++b) {
+        qint32 &next = transitions[b];
+        if (next < 0) {
+            next = 0;
+        } else {
+            queue.append(next);
+        }
+    }
+    for (qsizetype head = 0; head < queue.count(); ++head) {
+        const qint32 state = queue.at(head);
+        const qint32 failState = fail.at(state);
+        longestLiteral[state] = qMax(longestLiteral.at(state), longestLiteral.at(failState));
+        anchorBits[state] |= anchorBits.at(failState);
+        for (int b = 0; b < 256; ++b) {
+            const qsizetype edge = qsizetype(state) * 256 + b;
+            const qint32 fallback = transitions.at(qsizetype(failState) * 256 + b);
+            if (transitions.at(edge) < 0) {
+                transitions[edge] = fallback;
+            } else {
+                fail[transitions.at(edge)] = fallback;
+                queue.append(transitions.at(edge));
+            }
+        }
+    }
+}
+
+// Position at or after pos where a keyword may start, or size.
+qsizetype Redactor::skipToCandidate(const uchar *data, qsizetype pos, qsizetype size) const
+{
+#ifdef REDACTION_HAVE_SSE2
+    const int count = int(prefixFirst.size());
+    if (count <= MaxVectorPrefixes) {
+        __m128i firstBytes[MaxVectorPrefixes];
+        __m128i secondBytes[MaxVectorPrefixes];
+        for (int n = 0; n < count; ++n) {
+            firstBytes[n] = _mm_set1_epi8(prefixFirst.at(n));
+            secondBytes[n] = _mm_set1_epi8(prefixSecond.at(n));
+        }
+        for (; pos + 17 <= size; pos += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+            const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos + 1));
+            __m128i hits = _mm_setzero_si128();
+            for (int n = 0; n < count; ++n) {
+                __m128i hit = _mm_cmpeq_epi8(block, firstBytes[n]);
+                if (!((shortPrefixes >> n) & 1)) {
+                    hit = _mm_and_si128(hit, _mm_cmpeq_epi8(next, secondBytes[n]));
+                }
+                hits = _mm_or_si128(hits, hit);
+            }
+            const quint32 mask = quint32(_mm_movemask_epi8(hits));
+            if (mask != 0) {
+                return pos + qCountTrailingZeroBits(mask);
+            }
+        }
+    }
+#endif
+    while (pos < size && !startByte[data[pos]]) {
+        ++pos;
+    }
+    return pos;
+}
+
+void Redactor::matchPattern(const Pattern &pattern, const char *data, qsizetype lineStart, qsizetype lineEnd)
+{
+    const QString line = QString::fromLatin1(data + lineStart, lineEnd - lineStart);
+    QRegularExpressionMatchIterator it = pattern.regex.globalMatch(line);
+    while (it.hasNext()) {
+        const QRegularExpressionMatch match = it.next();
+        if (match.capturedLength() > 0) {
+            spans.append({lineStart + match.capturedStart(), lineStart + match.capturedEnd()});
+        }
+    }
+}
+
+// Redacts data, which ends at a line end (or is part of an overlong line).
+void Redactor::redactLines(const char *data, qsizetype size, QByteArray &out)
+{
+    spans.clear();
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+
+    if (!transitions.isEmpty()) {
+        // The line holding the latest anchor hit; its patterns run once the
+        // scan has left it, so several hits on one line cost one match each.
+        qsizetype lineStart = 0;
+        qsizetype lineEnd = -1;
+        quint64 lineBits = 0;
+        const auto runAnchoredPatterns = [&]() {
+            for (const Pattern &pattern : std::as_const(patterns)) {
+                if (pattern.anchorBit & lineBits) {
+                    matchPattern(pattern, data, lineStart, lineEnd);
+                }
+            }
+        };
+
+        const qint32 *table = transitions.constData();
+        qint32 state = 0;
+        for (qsizetype i = 0; i < size; ++i) {
+            if (state == 0) {
+                i = skipToCandidate(bytes, i, size);
+                if (i >= size) {
+                    break;
+                }
+            }
+            state = table[qsizetype(state) * 256 + bytes[i]];
+            if (const qint32 length = longestLiteral.at(state)) {
+                spans.append({i + 1 - length, i + 1});
+            }
+            if (const quint64 bits = anchorBits.at(state)) {
+                if (i >= lineEnd) {
+                    if (lineBits) {
+                        runAnchoredPatterns();
+                    }
+                    lineStart = i;
+                    while (lineStart > 0 && data[lineStart - 1] != '\n') {
+                        --lineStart;
+                    }
+                    const void *newline = std::memchr(data + i, '\n', size_t(size - i));
+                    lineEnd = newline ? static_cast<const char *>(newline) - data : size;
+                    lineBits = 0;
+                }
+                lineBits |= bits;
+            }
+        }
+        if (lineBits) {
+            runAnchoredPatterns();
+        }
+    }
+
+    if (hasUnanchoredPattern) {
+        for (qsizetype lineStart = 0; lineStart < size;) {
+            const void *newline = std::memchr(data + lineStart, '\n', size_t(size - lineStart));
+            const qsizetype lineEnd = newline ? static_cast<const char *>(newline) - data : size;
+            for (const Pattern &pattern : std::as_const(patterns)) {
+                if (pattern.anchorBit == 0) {
+                    matchPattern(pattern, data, lineStart, lineEnd);
+                }
+            }
+            lineStart = lineEnd + 1;
+        }
+    }
+
+    if (spans.isEmpty()) {
+        out.append(data, size);
+        return;
+    }
+    std::sort(spans.begin(), spans.end());
+    qsizetype written = 0;
+    qsizetype start = spans.first().first;
+    qsizetype end = spans.first().second;
+    const auto replace = [&]() {
+        out.append(data + written, start - written);
+        out.append(replacement);
+        written = end;
+        ++matches;
+    };
+    for (const auto &span : std::as_const(spans)) {
+        if (span.first > end) {
+            replace();
+            start = span.first;
+        }
+        end = qMax(end, span.second);
+    }
+    replace();
+    out.append(data + written, size - written);
+}
+
+void Redactor::process(const char *data, qsizetype size, QByteArray &out)
+{
+    if (!isActive()) {
+        out.append(data, size);
+        return;
+    }
+    if (!pendingLine.isEmpty()) {
+        // Complete the line left over from the previous piece.
+        const void *newline = std::memchr(data, '\n', size_t(size));
+        const qsizetype head = newline ? static_cast<const char *>(newline) - data + 1 : size;
+        pendingLine.append(data, head);
+        data += head;
+        size -= head;
+        if (newline || pendingLine.size() >= MaxLineLength) {
+            redactLines(pendingLine.constData(), pendingLine.size(), out);
+            pendingLine.clear();
+        }
+        if (size == 0) {
+            return;
+        }
+    }
+    // Complete lines go through now; the last partial one waits for the next piece.
+    qsizetype tail = 0;
+    while (tail < size && tail < MaxLineLength && data[size - 1 - tail] != '\n') {
+        ++tail;
+    }
+    if (tail == MaxLineLength) {
+        tail = 0; // Inside an overlong line: redact what is here
+    }
+    redactLines(data, size - tail, out);
+    pendingLine.append(data + size - tail, tail);
+}
+
+void Redactor::finish(QByteArray &out)
+{
+    if (!pendingLine.isEmpty()) {
+        redactLines(pendingLine.constData(), pendingLine.size(), out);
+        pendingLine.clear();
+    }
+}
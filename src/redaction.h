@@ -0,0 +1,87 @@
+// redaction.h
+// Streaming redaction of secrets and personal data in merged content.
+
+#ifndef REDACTION_H
+#define REDACTION_H
+
+#include <QByteArray>
+#include <QList>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+#include <utility>
+
+// What to redact. Neither literals nor matches of patterns span lines.
+struct RedactionRules {
+    QList<QByteArray> literals; // Exact, case-sensitive byte strings
+    QStringList patterns;       // QRegularExpression syntax; see Redactor
+    QByteArray replacement = "[REDACTED]";
+
+    bool isEmpty() const { return literals.isEmpty() && patterns.isEmpty(); }
+
+    // One rule per line: "re:<pattern>" is a regular expression, anything
+    // else a literal. Empty lines and lines starting with '#' are skipped.
+    // Returns false (and names the line) if a pattern does not compile.
+    static bool parse(const QString &text, RedactionRules *rules, QString *errorMessage = nullptr);
+    QString toText() const;
+};
+
+// Replaces every match of a rule set in a stream delivered in pieces of any
+// size. Literals are found with one Aho-Corasick pass, which also looks for
+// a literal each pattern requires (e.g. "AKIA" in "AKIA[0-9A-Z]{16}"), so a
+// pattern only runs on lines where that literal occurs; patterns without one
+// run on every line. Outside a match the automaton sits in its root state,
+// where the scan skips ahead with SSE2 to the next position whose first two
+// bytes begin a literal. Patterns see a line as Latin-1, one character per byte, so keep
+// them ASCII. Overlapping matches are merged into one replacement.
+class Redactor
+{
+public:
+    // Longer lines are redacted in pieces of this size; a match straddling
+    // two pieces can be missed.
+    static constexpr qsizetype MaxLineLength = 64 * 1024;
+
+    explicit Redactor(const RedactionRules &rules = RedactionRules());
+
+    bool isActive() const;
+    void process(const char *data, qsizetype size, QByteArray &out); // Appends to out
+    void finish(QByteArray &out); // End of a source
+    qint64 matchCount() const { return matches; }
+
+    // The literal every match of pattern contains (the longest one found),
+    // or empty if there is none, the pattern uses alternation, or it holds
+    // syntax the scan does not know (the pattern then runs on every line).
+    static QByteArray requiredLiteral(const QString &pattern);
+
+private:
+    struct Pattern {
+        QRegularExpression regex;
+        quint64 anchorBit = 0; // 0: runs on every line
+    };
+
+    void buildAutomaton(const QList<QByteArray> &keywords, const QList<quint64> &keywordBits);
+    qsizetype skipToCandidate(const uchar *data, qsizetype pos, qsizetype size) const;
+    void redactLines(const char *data, qsizetype size, QByteArray &out);
+    void matchPattern(const Pattern &pattern, const char *data, qsizetype lineStart, qsizetype lineEnd);
+
+    // Dense automaton: transitions[state * 256 + byte]. State 0 is the root.
+    QList<qint32> transitions;
+    QList<qint32> longestLiteral; // Per state: longest literal ending there (0: none)
+    QList<quint64> anchorBits;    // Per state: patterns whose anchor ends there
+    bool startByte[256] = {};
+    // Distinct first two bytes of all keywords (the second is ignored where
+    // the bit in shortPrefixes is set: a one-byte keyword).
+    QByteArray prefixFirst;
+    QByteArray prefixSecond;
+    quint32 shortPrefixes = 0;
+
+    QList<Pattern> patterns;
+    bool hasUnanchoredPattern = false;
+    QByteArray replacement;
+
+    QByteArray pendingLine; // Incomplete last line of the previous piece
+    QList<std::pair<qsizetype, qsizetype>> spans; // Reused: [start, end) to replace
+    qint64 matches = 0;
+};
+
+#endif // REDACTION_H
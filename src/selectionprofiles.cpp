@@ -0,0 +1,134 @@
+// selectionprofiles.cpp
+
+#include "selectionprofiles.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QSettings>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+const quint32 ProfileMagic = 0x464d5031; // "FMP1"
+
+QSettings &profileSettings()
+{
+    static QSettings settings(QSettings::IniFormat, QSettings::UserScope,
+                              QStringLiteral("FileMergerApp"), QStringLiteral("SelectionProfiles"));
+    return settings;
+}
+
+// One settings group per root folder; the path itself is hashed because
+// separators have a meaning in settings keys.
+QString groupForRoot(const QString &rootPath)
+{
+    const QByteArray cleaned = QDir::cleanPath(rootPath).toUtf8();
+    return QStringLiteral("root_") + QString::fromLatin1(QCryptographicHash::hash(cleaned, QCryptographicHash::Sha1).toHex());
+}
+
+} // namespace
+
+QStringList SelectionProfiles::names(const QString &rootPath)
+{
+    QSettings &settings = profileSettings();
+    settings.beginGroup(groupForRoot(rootPath));
+    settings.beginGroup(QStringLiteral("profiles"));
+    QStringList result = settings.childKeys();
+    settings.endGroup();
+    settings.endGroup();
+    result.sort(Qt::CaseInsensitive);
+    return result;
+}
+
+bool SelectionProfiles::save(const QString &rootPath, const QString &name, const SelectionProfile &profile)
+{
+    QSettings &settings = profileSettings();
+    settings.beginGroup(groupForRoot(rootPath));
+    settings.setValue(QStringLiteral("rootPath"), QDir::cleanPath(rootPath)); // For humans reading the file
+    settings.setValue(QStringLiteral("profiles/") + name, serialize(profile));
+    settings.endGroup();
+    settings.sync();
+    return settings.status() == QSettings::NoError;
+}
+
+bool SelectionProfiles::load(const QString &rootPath, const QString &name, SelectionProfile &profile)
+{
+    QSettings &settings = profileSettings();
+    const QVariant value = settings.value(groupForRoot(rootPath) + QStringLiteral("/profiles/") + name);
+    if (!value.isValid())
+        return false;
+    return deserialize(value.toByteArray(), profile);
+}
+
+void SelectionProfiles::remove(const QString &rootPath, const QString &name)
+{
+    QSettings &settings = profileSettings();
+    settings.remove(groupForRoot(rootPath) + QStringLiteral("/profiles/") + name);
+    settings.sync();
+}
+
+QByteArray SelectionProfiles::serialize(const SelectionProfile &profile)
+{
+    // Front coding: each path stores how many leading bytes it shares with the
+    // previous one, which removes most of the repeated directory prefixes.
+    QList<QByteArray> paths;
+    paths.reserve(profile.relativePaths.size());
+    for (const QString &path : profile.relativePaths)
+        paths.append(path.toUtf8());
+    std::sort(paths.begin(), paths.end());
+
+    QByteArray encoded;
+    QDataStream pathStream(&encoded, QIODevice::WriteOnly);
+    QByteArray previous;
+    for (const QByteArray &path : std::as_const(paths)) {
+        qsizetype shared = 0;
+        const qsizetype limit = qMin(previous.size(), path.size());
+        while (shared < limit && previous.at(shared) == path.at(shared))
+            ++shared;
+        pathStream << quint32(shared) << path.mid(shared);
+        previous = path;
+    }
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << ProfileMagic << quint32(paths.size()) << profile.patterns << qCompress(encoded);
+    return data;
+}
+
+bool SelectionProfiles::deserialize(const QByteArray &data, SelectionProfile &profile)
+{
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 pathCount = 0;
+    QByteArray compressed;
+    QStringList patterns;
+    in >> magic >> pathCount >> patterns >> compressed;
+    if (in.status() != QDataStream::Ok || magic != ProfileMagic) {
+        qWarning() << "SelectionProfiles: Unrecognized profile data.";
+        return false;
+    }
+
+    const QByteArray encoded = qUncompress(compressed);
+    QDataStream pathStream(encoded);
+    QStringList paths;
+    paths.reserve(pathCount);
+    QByteArray previous;
+    for (quint32 i = 0; i < pathCount; ++i) {
+        quint32 shared = 0;
+        QByteArray suffix;
+        pathStream >> shared >> suffix;
+        if (pathStream.status() != QDataStream::Ok || shared > quint32(previous.size())) {
+            qWarning() << "SelectionProfiles: Corrupt path list.";
+            return false;
+        }
+        previous = previous.left(shared) + suffix;
+        paths.append(QString::fromUtf8(previous));
+    }
+
+    profile.relativePaths = paths;
+    profile.patterns = patterns;
+    return true;
+}
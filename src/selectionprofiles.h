@@ -0,0 +1,31 @@
+// selectionprofiles.h
+// Named selection profiles, stored per root folder.
+
+#ifndef SELECTIONPROFILES_H
+#define SELECTIONPROFILES_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+struct SelectionProfile
+{
+    QStringList relativePaths; // '/'-separated, relative to the root folder
+    QStringList patterns;      // Wildcards, see CustomFileModel::applySelection()
+};
+
+class SelectionProfiles
+{
+public:
+    static QStringList names(const QString &rootPath);
+    static bool save(const QString &rootPath, const QString &name, const SelectionProfile &profile);
+    static bool load(const QString &rootPath, const QString &name, SelectionProfile &profile);
+    static void remove(const QString &rootPath, const QString &name);
+
+    // Compact binary form: sorted paths, front-coded and zlib-compressed, so
+    // a 100k-file profile stays small in the settings file.
+    static QByteArray serialize(const SelectionProfile &profile);
+    static bool deserialize(const QByteArray &data, SelectionProfile &profile);
+};
+
+#endif // SELECTIONPROFILES_H
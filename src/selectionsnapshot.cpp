@@ -0,0 +1,56 @@
+// selectionsnapshot.cpp
+
+#include "selectionsnapshot.h"
+#include <QtAlgorithms> // For qCountTrailingZeroBits
+
+SelectionSnapshot::SelectionSnapshot(const QBitArray &checked, const QStringList &paths, const QList<qint64> &sizes, int count)
+    : checked(checked), pathTable(paths), sizeTable(sizes), fileCount(count)
+{
+}
+
+int SelectionSnapshot::count() const
+{
+    return fileCount;
+}
+
+bool SelectionSnapshot::isEmpty() const
+{
+    return fileCount == 0;
+}
+
+QStringList SelectionSnapshot::paths(QList<qint64> *sizes) const
+{
+    QStringList result;
+    result.reserve(fileCount);
+    if (sizes) {
+        sizes->reserve(sizes->size() + fileCount);
+    }
+    // Byte by byte, skipping unselected stretches eight nodes at a time.
+    const uchar *bits = reinterpret_cast<const uchar *>(checked.bits());
+    const qsizetype byteCount = (checked.size() + 7) / 8;
+    for (qsizetype byte = 0; byte < byteCount; ++byte) {
+        for (uint set = bits[byte]; set; set &= set - 1) {
+            const qsizetype id = byte * 8 + qCountTrailingZeroBits(set);
+            if (id >= pathTable.size()) {
+                break;
+            }
+            result.append(pathTable.at(id));
+            if (sizes) {
+                sizes->append(sizeTable.at(id));
+            }
+        }
+    }
+    return result;
+}
+
+SelectionSnapshot SelectionSnapshot::filtered(const std::function<bool(const QString &path, qint64 size)> &keep) const
+{
+    SelectionSnapshot result(*this);
+    for (qsizetype id = 0; id < checked.size() && id < pathTable.size(); ++id) {
+        if (checked.testBit(id) && !keep(pathTable.at(id), sizeTable.at(id))) {
+            result.checked.clearBit(id); // Detaches from this snapshot's bits
+            --result.fileCount;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,45 @@
+// selectionsnapshot.h
+// The checked files of a CustomFileModel at one moment, for a merge to use
+// while the selection keeps changing.
+
+#ifndef SELECTIONSNAPSHOT_H
+#define SELECTIONSNAPSHOT_H
+
+#include <QBitArray>
+#include <QList>
+#include <QStringList>
+#include <functional>
+
+// Taking and copying a snapshot costs a few reference counts: the bits are
+// the model's implicitly shared bitset, which the model copies only when it
+// next changes the selection, and the path and size tables are built once
+// per scan and shared by every snapshot of it. A snapshot does not point into
+// the model, so it stays valid after the model is gone, and it can be read
+// from any thread.
+class SelectionSnapshot
+{
+public:
+    SelectionSnapshot() = default;
+    // All three are indexed by node id; paths is empty for folders.
+    SelectionSnapshot(const QBitArray &checked, const QStringList &paths, const QList<qint64> &sizes, int count);
+
+    int count() const; // Selected files
+    bool isEmpty() const;
+
+    // The selected files in tree order, with their sizes from the scan
+    // appended to sizes. Linear in the size of the tree; meant for the
+    // thread that uses the selection.
+    QStringList paths(QList<qint64> *sizes = nullptr) const;
+
+    // The selected files for which keep returns true, again sharing the path
+    // and size tables; the bits are copied only if a file is dropped.
+    SelectionSnapshot filtered(const std::function<bool(const QString &path, qint64 size)> &keep) const;
+
+private:
+    QBitArray checked;
+    QStringList pathTable;
+    QList<qint64> sizeTable;
+    int fileCount = 0;
+};
+
+#endif // SELECTIONSNAPSHOT_H
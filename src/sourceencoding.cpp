@@ -0,0 +1,146 @@
+// sourceencoding.cpp
+
+#include "sourceencoding.h"
+#include "utf8.h"
+#include <QStringDecoder>
+#include <QByteArrayView>
+#include <cstring> // For memchr
+
+namespace SourceEncoding {
+
+namespace {
+
+bool startsWith(const char *data, qint64 size, const char *bom, qint64 bomSize)
+{
+    return size >= bomSize && std::memcmp(data, bom, size_t(bomSize)) == 0;
+}
+
+// Text in UTF-16 is mostly ASCII in practice, so one byte of each pair is
+// zero. Binary data has NULs too, but not in such a regular pattern.
+Kind guessUtf16(const char *data, qint64 size)
+{
+    const qint64 sample = qMin(size, SniffSize) & ~qint64(1);
+    if (sample < 4)
+        return Kind::Fallback;
+    qint64 evenZeros = 0;
+    qint64 oddZeros = 0;
+    for (qint64 i = 0; i < sample; i += 2) {
+        evenZeros += data[i] == 0;
+        oddZeros += data[i + 1] == 0;
+    }
+    const qint64 pairs = sample / 2;
+    if (oddZeros * 10 >= pairs * 4 && evenZeros * 20 <= pairs)
+        return Kind::Utf16LE;
+    if (evenZeros * 10 >= pairs * 4 && oddZeros * 20 <= pairs)
+        return Kind::Utf16BE;
+    return Kind::Fallback;
+}
+
+// Cuts only before a byte that starts a sequence (a valid one has at most
+// three continuation bytes), so the windows agree with a single pass.
+bool isValidUtf8(const char *data, qint64 size, const std::atomic_bool *cancelled)
+{
+    if (!cancelled)
+        return Utf8::isValid(data, size);
+    while (size > 0) {
+        if (cancelled->load(std::memory_order_relaxed))
+            return false;
+        qint64 end = qMin(size, ValidationWindow);
+        for (int i = 0; i < 3 && end < size && (uchar(data[end]) & 0xC0) == 0x80; ++i)
+            --end;
+        if (!Utf8::isValid(data, end))
+            return false;
+        data += end;
+        size -= end;
+    }
+    return true;
+}
+
+// The encoding a source of kind is decoded with.
+QStringConverter::Encoding encodingOf(Kind kind, QStringConverter::Encoding fallback)
+{
+    switch (kind) {
+    case Kind::Utf16LE:
+        return QStringConverter::Utf16LE;
+    case Kind::Utf16BE:
+        return QStringConverter::Utf16BE;
+    case Kind::Fallback:
+        return fallback;
+    default:
+        return QStringConverter::Utf8;
+    }
+}
+
+// Length of the BOM data starts with that decoding a source of kind skips.
+qint64 bomLength(const char *data, qint64 size, Kind kind)
+{
+    switch (kind) {
+    case Kind::Utf16LE:
+        return startsWith(data, size, "\xFF\xFE", 2) ? 2 : 0;
+    case Kind::Utf16BE:
+        return startsWith(data, size, "\xFE\xFF", 2) ? 2 : 0;
+    case Kind::Utf8WithBom:
+    case Kind::Fallback:
+        // A UTF-8 BOM in front of invalid UTF-8 would decode as "ï»¿"
+        return startsWith(data, size, "\xEF\xBB\xBF", 3) ? 3 : 0;
+    default:
+        return 0;
+    }
+}
+
+} // namespace
+
+Kind detect(const char *data, qint64 size, bool detectUtf16WithoutBom, const std::atomic_bool *cancelled)
+{
+    if (startsWith(data, size, "\xEF\xBB\xBF", 3))
+        return isValidUtf8(data + 3, size - 3, cancelled) ? Kind::Utf8WithBom : Kind::Fallback;
+    if (startsWith(data, size, "\xFF\xFE", 2))
+        return Kind::Utf16LE;
+    if (startsWith(data, size, "\xFE\xFF", 2))
+        return Kind::Utf16BE;
+
+    // NUL is valid UTF-8, so UTF-16 that happens to validate is caught first.
+    if (detectUtf16WithoutBom && std::memchr(data, 0, size_t(qMin(size, SniffSize)))) {
+        const Kind guess = guessUtf16(data, size);
+        if (guess != Kind::Fallback)
+            return guess;
+    }
+
+    return isValidUtf8(data, size, cancelled) ? Kind::Utf8 : Kind::Fallback;
+}
+
+QByteArray toUtf8(const char *data, qint64 size, Kind kind, QStringConverter::Encoding fallback)
+{
+    switch (kind) {
+    case Kind::Utf8:
+        return QByteArray(data, size);
+    case Kind::Utf8WithBom:
+        return QByteArray(data + 3, size - 3);
+    default:
+        break;
+    }
+
+    const qint64 skip = bomLength(data, size, kind);
+    QStringDecoder decoder(encodingOf(kind, fallback), QStringConverter::Flag::Stateless);
+    const QString text = decoder(QByteArrayView(data + skip, size - skip));
+    return text.toUtf8();
+}
+
+Decoder::Decoder(Kind kind, QStringConverter::Encoding fallback)
+    : kind(kind), decoder(encodingOf(kind, fallback)), atStart(true)
+{
+}
+
+QByteArray Decoder::toUtf8(const char *data, qint64 size)
+{
+    if (atStart) {
+        atStart = false;
+        const qint64 skip = bomLength(data, size, kind);
+        data += skip;
+        size -= skip;
+    }
+    const QString text = decoder(QByteArrayView(data, size));
+    return text.toUtf8();
+}
+
+} // namespace SourceEncoding
@@ -0,0 +1,57 @@
+// sourceencoding.h
+// Decides how a source file's bytes get into the UTF-8 merge output.
+
+#ifndef SOURCEENCODING_H
+#define SOURCEENCODING_H
+
+#include <QByteArray>
+#include <QStringConverter>
+#include <QStringDecoder>
+#include <atomic>
+
+namespace SourceEncoding {
+
+enum class Kind {
+    Utf8,        // Valid UTF-8, copied as is
+    Utf8WithBom, // Valid UTF-8 after a BOM, copied without the BOM
+    Utf16LE,     // From a BOM or a NUL-byte pattern
+    Utf16BE,
+    Fallback     // Anything else: decoded with the configured fallback encoding
+};
+
+// Number of leading bytes the UTF-16 heuristic looks at.
+constexpr qint64 SniffSize = 4096;
+
+// With a cancel flag, UTF-8 validation runs window by window so a huge
+// source can be abandoned part way.
+constexpr qint64 ValidationWindow = 8 * 1024 * 1024;
+
+// BOMs win; then, if the start of the data contains NUL bytes and
+// detectUtf16WithoutBom is set, a mostly-ASCII UTF-16 layout (every other byte
+// zero) is recognized; then the data is validated as UTF-8. Once *cancelled
+// is set the result is meaningless and the caller is expected to stop.
+Kind detect(const char *data, qint64 size, bool detectUtf16WithoutBom = true,
+            const std::atomic_bool *cancelled = nullptr);
+
+// Converts data of the given kind (anything but Utf8/Utf8WithBom) to UTF-8,
+// dropping a BOM. Unconvertible sequences become U+FFFD.
+QByteArray toUtf8(const char *data, qint64 size, Kind kind, QStringConverter::Encoding fallback);
+
+// toUtf8() for data that arrives in pieces: the BOM is dropped from the first
+// piece, and a character cut between two pieces is completed by the next one
+// (one left incomplete at the very end is dropped).
+class Decoder
+{
+public:
+    Decoder(Kind kind, QStringConverter::Encoding fallback);
+    QByteArray toUtf8(const char *data, qint64 size);
+
+private:
+    Kind kind;
+    QStringDecoder decoder;
+    bool atStart;
+};
+
+} // namespace SourceEncoding
+
+#endif // SOURCEENCODING_H
@@ -0,0 +1,211 @@
+// textstats.cpp
+
+#include "textstats.h"
+#include "fileidentity.h"
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QDebug>
+#include <QtAlgorithms> // For qPopulationCount
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTSTATS_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+// As in utf8.cpp, the AVX2 kernel is picked at run time.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TEXTSTATS_HAVE_AVX2_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace {
+
+inline bool isWhitespace(uchar c)
+{
+    return c == ' ' || uchar(c - 9) <= 4; // \t \n \v \f \r
+}
+
+// Bit i of the masks describes byte i of the block. A word starts at every
+// non-whitespace byte whose predecessor is whitespace; carry holds whether
+// the byte before the block was.
+struct BlockTotals
+{
+    qint64 newlines = 0;
+    qint64 wordStarts = 0;
+    qint64 nonWhitespace = 0;
+};
+
+#ifdef TEXTSTATS_HAVE_SSE2
+qsizetype countSse2(const uchar *data, qsizetype size, bool &previousWhitespace, BlockTotals &totals)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8(9);
+    const __m128i four = _mm_set1_epi8(4);
+    quint32 carry = previousWhitespace ? 1 : 0;
+    qsizetype i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i control = _mm_sub_epi8(v, tab); // 0..4 for \t..\r
+        const __m128i isControl = _mm_cmpeq_epi8(_mm_min_epu8(control, four), control);
+        const quint32 ws = quint32(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, space), isControl)));
+        const quint32 nonWs = ~ws & 0xFFFFu;
+        totals.newlines += qPopulationCount(quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline))));
+        totals.nonWhitespace += qPopulationCount(nonWs);
+        totals.wordStarts += qPopulationCount(nonWs & ((ws << 1) | carry));
+        carry = ws >> 15;
+    }
+    previousWhitespace = carry != 0;
+    return i;
+}
+#endif
+
+#ifdef TEXTSTATS_HAVE_AVX2_DISPATCH
+__attribute__((target("avx2,popcnt"))) qsizetype countAvx2(const uchar *data, qsizetype size,
+                                                           bool &previousWhitespace, BlockTotals &totals)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8(9);
+    const __m256i four = _mm256_set1_epi8(4);
+    quint64 carry = previousWhitespace ? 1 : 0;
+    qsizetype i = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        const __m256i control = _mm256_sub_epi8(v, tab);
+        const __m256i isControl = _mm256_cmpeq_epi8(_mm256_min_epu8(control, four), control);
+        const quint64 ws = quint32(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, space), isControl)));
+        const quint64 nonWs = ~ws & 0xFFFFFFFFu;
+        totals.newlines += _mm_popcnt_u32(quint32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline))));
+        totals.nonWhitespace += _mm_popcnt_u64(nonWs);
+        totals.wordStarts += _mm_popcnt_u64(nonWs & ((ws << 1) | carry));
+        carry = ws >> 31;
+    }
+    previousWhitespace = carry != 0;
+    return i;
+}
+
+bool cpuHasAvx2()
+{
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    return supported;
+}
+#endif
+
+QMutex cacheMutex;
+QHash<FileIdentity, TextCounts> countsCache;
+
+} // namespace
+
+void TextCounter::add(const char *data, qsizetype size)
+{
+    if (size <= 0)
+        return;
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    BlockTotals totals;
+    qsizetype done = 0;
+#ifdef TEXTSTATS_HAVE_AVX2_DISPATCH
+    if (size >= 64 && cpuHasAvx2())
+        done = countAvx2(p, size, previousWhitespace, totals);
+#endif
+#ifdef TEXTSTATS_HAVE_SSE2
+    done += countSse2(p + done, size - done, previousWhitespace, totals);
+#endif
+    for (qsizetype i = done; i < size; ++i) {
+        const bool ws = isWhitespace(p[i]);
+        if (p[i] == '\n')
+            ++totals.newlines;
+        if (!ws) {
+            ++totals.nonWhitespace;
+            if (previousWhitespace)
+                ++totals.wordStarts;
+        }
+        previousWhitespace = ws;
+    }
+
+    bytes += size;
+    newlines += totals.newlines;
+    words += totals.wordStarts;
+    nonWhitespace += totals.nonWhitespace;
+    endsWithNewline = p[size - 1] == '\n';
+}
+
+TextCounts TextCounter::counts() const
+{
+    TextCounts result;
+    result.ok = true;
+    result.bytes = bytes;
+    result.lines = newlines + (endsWithNewline ? 0 : 1);
+    result.words = words;
+    result.nonWhitespace = nonWhitespace;
+    return result;
+}
+
+TextCounts TextCounter::countScalar(const char *data, qsizetype size)
+{
+    TextCounts result;
+    result.ok = true;
+    result.bytes = size;
+    bool previousWhitespace = true;
+    for (qsizetype i = 0; i < size; ++i) {
+        const uchar c = uchar(data[i]);
+        const bool ws = isWhitespace(c);
+        if (c == '\n')
+            ++result.lines;
+        if (!ws) {
+            ++result.nonWhitespace;
+            if (previousWhitespace)
+                ++result.words;
+        }
+        previousWhitespace = ws;
+    }
+    if (size > 0 && data[size - 1] != '\n')
+        ++result.lines;
+    return result;
+}
+
+namespace TextStats {
+
+TextCounts countFile(const QString &path)
+{
+    FileIdentity key;
+    const bool haveKey = FileIdentity::forPath(path, key);
+    if (haveKey) {
+        QMutexLocker locker(&cacheMutex);
+        auto it = countsCache.constFind(key);
+        if (it != countsCache.constEnd())
+            return it.value();
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "TextStats: could not open" << path << file.errorString();
+        return TextCounts();
+    }
+    thread_local QByteArray buffer; // One per pool thread, reused across files
+    buffer.resize(1024 * 1024);
+    TextCounter counter;
+    qint64 n;
+    while ((n = file.read(buffer.data(), buffer.size())) > 0)
+        counter.add(buffer.constData(), n);
+    if (n < 0) {
+        qWarning() << "TextStats: could not read" << path << file.errorString();
+        return TextCounts();
+    }
+
+    const TextCounts counts = counter.counts();
+    if (haveKey) {
+        QMutexLocker locker(&cacheMutex);
+        countsCache.insert(key, counts);
+    }
+    return counts;
+}
+
+void clearCache()
+{
+    QMutexLocker locker(&cacheMutex);
+    countsCache.clear();
+}
+
+} // namespace TextStats
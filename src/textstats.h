@@ -0,0 +1,53 @@
+// textstats.h
+// Line, word and token counts used for the pre-merge size estimate.
+
+#ifndef TEXTSTATS_H
+#define TEXTSTATS_H
+
+#include <QString>
+
+struct TextCounts
+{
+    bool ok = false;          // False when the file could not be read
+    qint64 bytes = 0;
+    qint64 lines = 0;         // A last line without '\n' counts too
+    qint64 words = 0;         // Runs of non-whitespace bytes
+    qint64 nonWhitespace = 0;
+
+    // Rough LLM token estimate: about four non-whitespace bytes per token,
+    // but at least one token per word.
+    qint64 estimatedTokens() const { return qMax(words, (nonWhitespace + 3) / 4); }
+};
+
+// Counts a stream of bytes delivered in pieces of any size. Whitespace is
+// ASCII space, \t, \n, \v, \f and \r. Uses an AVX2 kernel when the CPU has
+// one and SSE2 otherwise.
+class TextCounter
+{
+public:
+    void add(const char *data, qsizetype size);
+    TextCounts counts() const;
+
+    // Same result without SIMD; for tests.
+    static TextCounts countScalar(const char *data, qsizetype size);
+
+private:
+    qint64 bytes = 0;
+    qint64 newlines = 0;
+    qint64 words = 0;
+    qint64 nonWhitespace = 0;
+    bool previousWhitespace = true; // Start of input counts as whitespace
+    bool endsWithNewline = true;
+};
+
+namespace TextStats {
+
+// Counts a whole file, reading it in 1 MiB pieces. Results are cached
+// process-wide by FileIdentity, so re-estimating an unchanged selection
+// reads nothing again.
+TextCounts countFile(const QString &path);
+void clearCache();
+
+} // namespace TextStats
+
+#endif // TEXTSTATS_H
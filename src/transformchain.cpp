@@ -0,0 +1,298 @@
+// transformchain.cpp
+
+#include "transformchain.h"
+#include <QtAlgorithms> // For qCountTrailingZeroBits
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORMCHAIN_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Transform {
+
+namespace {
+
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+// End of the line starting at pos (past its '\n'), or size.
+qsizetype nextLine(const char *data, qsizetype size, qsizetype pos)
+{
+    while (pos < size && data[pos] != '\n')
+        ++pos;
+    return pos < size ? pos + 1 : size;
+}
+
+// Position of the first non-blank character of the line at pos.
+qsizetype skipBlanks(const char *data, qsizetype size, qsizetype pos)
+{
+    while (pos < size && isBlank(data[pos]))
+        ++pos;
+    return pos;
+}
+
+bool isLineEnd(const char *data, qsizetype size, qsizetype pos)
+{
+    return pos >= size || data[pos] == '\n' || data[pos] == '\r';
+}
+
+bool mentionsLicense(const char *data, qsizetype size)
+{
+    const QByteArray text = QByteArray::fromRawData(data, size).toLower();
+    return text.contains("license") || text.contains("licence") || text.contains("copyright");
+}
+
+// True when the '#' at pos starts a C/C++/Objective-C preprocessor
+// directive rather than a comment, e.g. "#include" or "# define".
+bool isPreprocessorDirective(const char *data, qsizetype size, qsizetype pos)
+{
+    qsizetype i = skipBlanks(data, size, pos + 1);
+    const qsizetype wordStart = i;
+    while (i < size && ((data[i] >= 'a' && data[i] <= 'z') || data[i] == '_'))
+        ++i;
+    if (i < size && !isBlank(data[i]) && !isLineEnd(data, size, i) && data[i] != '<' && data[i] != '"' && data[i] != '(')
+        return false; // Not a whole word, e.g. "#includes"
+    static const QByteArray directives[] = {
+        "include", "include_next", "import", "define", "undef", "if", "ifdef", "ifndef", "elif",
+        "elifdef", "elifndef", "else", "endif", "pragma", "error", "warning", "line", "region", "endregion",
+    };
+    const QByteArray word = QByteArray::fromRawData(data + wordStart, i - wordStart);
+    for (const QByteArray &directive : directives) {
+        if (word == directive)
+            return true;
+    }
+    return false;
+}
+
+// --- Line stages ---
+// Scalar state machine for one byte; every stage test is resolved at compile
+// time for the kernel's stage combination.
+template <Stages S>
+inline void emitContent(Chain::State &state, char c, QByteArray &out)
+{
+    if constexpr ((S & TrimTrailingWhitespace) != 0) {
+        if (!state.pendingSpace.isEmpty()) {
+            out.append(state.pendingSpace);
+            state.pendingSpace.clear();
+        }
+    }
+    out.append(c);
+    state.lineHasContent = true;
+    state.blankLines = 0;
+}
+
+template <Stages S>
+inline void endLine(Chain::State &state, QByteArray &out)
+{
+    if constexpr ((S & TrimTrailingWhitespace) != 0)
+        state.pendingSpace.clear();
+    if constexpr ((S & CollapseBlankLines) != 0) {
+        if (!state.lineHasContent && ++state.blankLines > 1)
+            return; // Drop the extra empty line
+    }
+    out.append('\n');
+    state.lineHasContent = false;
+}
+
+template <Stages S>
+inline void processByte(Chain::State &state, char c, QByteArray &out)
+{
+    if constexpr ((S & NormalizeLineEndings) != 0) {
+        if (state.pendingCr) {
+            state.pendingCr = false;
+            if (c == '\n') {
+                endLine<S>(state, out);
+                return;
+            }
+            emitContent<S>(state, '\r', out); // Lone CR
+        }
+        if (c == '\r') {
+            state.pendingCr = true;
+            return;
+        }
+    }
+    if (c == '\n') {
+        endLine<S>(state, out);
+        return;
+    }
+    if constexpr ((S & TrimTrailingWhitespace) != 0) {
+        if (isBlank(c)) {
+            if (state.pendingSpace.size() == MaxPendingBlanks) {
+                out.append(state.pendingSpace); // Too long to hold: kept, as content
+                state.pendingSpace.clear();
+                state.lineHasContent = true;
+                state.blankLines = 0;
+            }
+            state.pendingSpace.append(c);
+            return;
+        }
+    }
+    emitContent<S>(state, c, out);
+}
+
+#ifdef TRANSFORMCHAIN_HAVE_SSE2
+// Length of the prefix of data that no enabled stage would change, given a
+// state with nothing pending. Each 16-byte block is checked at once for a CR,
+// a blank directly before a newline, two newlines in a row and a trailing
+// blank at the block end (which may turn out to be trailing whitespace); the
+// prefix stops at the first such byte, minus the blanks leading up to it.
+// Reads one byte past each block, so the last 16 bytes go to the scalar path.
+template <Stages S>
+qsizetype plainPrefix(const Chain::State &state, const uchar *data, qsizetype size)
+{
+    if constexpr ((S & CollapseBlankLines) != 0) {
+        if (!state.lineHasContent && size > 0 && data[0] == '\n')
+            return 0; // Would continue a run of empty lines
+    }
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+
+    qsizetype i = 0;
+    for (; i + 17 <= size; i += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 1));
+        const __m128i newlineNext = _mm_cmpeq_epi8(next, newline);
+        __m128i bad = _mm_setzero_si128();
+        quint32 lastIsBlank = 0;
+        if constexpr ((S & NormalizeLineEndings) != 0)
+            bad = _mm_or_si128(bad, _mm_cmpeq_epi8(block, carriageReturn));
+        if constexpr ((S & TrimTrailingWhitespace) != 0) {
+            const __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, tab));
+            bad = _mm_or_si128(bad, _mm_and_si128(blank, newlineNext));
+            lastIsBlank = quint32(_mm_movemask_epi8(blank)) & 0x8000;
+        }
+        if constexpr ((S & CollapseBlankLines) != 0)
+            bad = _mm_or_si128(bad, _mm_and_si128(_mm_cmpeq_epi8(block, newline), newlineNext));
+        const quint32 mask = quint32(_mm_movemask_epi8(bad)) | lastIsBlank;
+        if (mask != 0) {
+            qsizetype end = i + qCountTrailingZeroBits(mask);
+            if constexpr ((S & TrimTrailingWhitespace) != 0) {
+                while (end > 0 && isBlank(char(data[end - 1])))
+                    --end;
+            }
+            return end;
+        }
+    }
+    return i;
+}
+#endif
+
+template <Stages S>
+void runLineStages(Chain::State &state, const uchar *data, qsizetype size, QByteArray &out)
+{
+    qsizetype i = 0;
+    while (i < size) {
+#ifdef TRANSFORMCHAIN_HAVE_SSE2
+        if (!state.pendingCr && state.pendingSpace.isEmpty()) {
+            const qsizetype plain = plainPrefix<S>(state, data + i, size - i);
+            if (plain > 0) {
+                out.append(reinterpret_cast<const char *>(data + i), plain);
+                i += plain;
+                // A plain run always holds content and never ends a line
+                // with an empty one.
+                state.lineHasContent = data[i - 1] != '\n';
+                state.blankLines = 0;
+                if (i == size)
+                    break;
+            }
+        }
+#endif
+        // Scalar steps over the byte that stopped the fast path, and on until
+        // nothing is held back.
+        do {
+            processByte<S>(state, char(data[i++]), out);
+        } while (i < size && (state.pendingCr || !state.pendingSpace.isEmpty()));
+    }
+}
+
+} // namespace
+
+qsizetype licenseHeaderLength(const char *data, qsizetype size)
+{
+    const qsizetype limit = qMin(size, LicenseScanLimit);
+    qsizetype pos = 0;
+    while (pos < limit && isLineEnd(data, limit, skipBlanks(data, limit, pos)))
+        pos = nextLine(data, limit, pos); // Leading empty lines
+    const qsizetype start = skipBlanks(data, limit, pos);
+    qsizetype end = -1;
+
+    if (start + 1 < limit && data[start] == '/' && data[start + 1] == '*') {
+        for (qsizetype i = start + 2; i + 1 < limit; ++i) {
+            if (data[i] == '*' && data[i + 1] == '/') {
+                end = nextLine(data, limit, i + 2);
+                break;
+            }
+        }
+    } else {
+        // A run of line comments in the style of the first one.
+        QByteArray marker;
+        if (start + 1 < limit && data[start] == '/' && data[start + 1] == '/')
+            marker = "//";
+        else if (start + 1 < limit && data[start] == '-' && data[start + 1] == '-')
+            marker = "--";
+        else if (start < limit && data[start] == '#' && !(start + 1 < limit && data[start + 1] == '!')
+                 && !isPreprocessorDirective(data, limit, start))
+            marker = "#";
+        if (!marker.isEmpty()) {
+            end = pos;
+            while (end < limit) {
+                const qsizetype first = skipBlanks(data, limit, end);
+                if (!QByteArray::fromRawData(data + first, limit - first).startsWith(marker))
+                    break;
+                if (marker == "#" && isPreprocessorDirective(data, limit, first))
+                    break; // Code follows a shell-style comment block
+                end = nextLine(data, limit, end);
+            }
+            if (end == limit && limit < size)
+                return 0; // Runs past the scan limit
+        }
+    }
+    if (end <= start || !mentionsLicense(data + start, end - start))
+        return 0;
+
+    // Drop the empty lines separating the header from the code as well.
+    while (end < size && isLineEnd(data, size, skipBlanks(data, size, end)))
+        end = nextLine(data, size, end);
+    return end;
+}
+
+Chain::Chain(Stages stages)
+    : lineStages(stages & ~Stages(StripLicenseHeader))
+{
+    // One kernel per combination of the stage bits above StripLicenseHeader.
+    static constexpr Kernel kernels[] = {
+        runLineStages<0>, runLineStages<2>, runLineStages<4>, runLineStages<6>,
+        runLineStages<8>, runLineStages<10>, runLineStages<12>, runLineStages<14>,
+    };
+    kernel = kernels[(lineStages >> 1) & 7];
+}
+
+bool Chain::isIdentity() const
+{
+    return lineStages == 0;
+}
+
+void Chain::process(const char *data, qsizetype size, QByteArray &out)
+{
+    if (isIdentity()) {
+        out.append(data, size);
+        return;
+    }
+    kernel(state, reinterpret_cast<const uchar *>(data), size, out);
+}
+
+void Chain::finish(QByteArray &out)
+{
+    if (state.pendingCr) {
+        out.append(state.pendingSpace); // Not trailing: a lone CR follows
+        out.append('\r');
+    }
+    // Blanks still pending are trailing whitespace at the end of the file.
+    state = State();
+}
+
+} // namespace Transform
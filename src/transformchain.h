@@ -0,0 +1,68 @@
+// transformchain.h
+// Streaming per-source transformations applied while merging.
+
+#ifndef TRANSFORMCHAIN_H
+#define TRANSFORMCHAIN_H
+
+#include <QByteArray>
+
+namespace Transform {
+
+// Stages are combined as flags and always run in this order.
+enum Stage : unsigned {
+    StripLicenseHeader = 1,     // Leading comment block mentioning a license or copyright
+    NormalizeLineEndings = 2,   // CRLF to LF (a lone CR is kept)
+    TrimTrailingWhitespace = 4, // Spaces and tabs before a line end or the end of the file
+    CollapseBlankLines = 8      // At most one empty line in a row
+};
+using Stages = unsigned;
+constexpr Stages AllStages = StripLicenseHeader | NormalizeLineEndings | TrimTrailingWhitespace | CollapseBlankLines;
+
+// Only this much of a source is searched for the end of a license header.
+constexpr qsizetype LicenseScanLimit = 64 * 1024;
+
+// TrimTrailingWhitespace holds back at most this many blanks. A longer run
+// is written out in pieces of this size as if content followed, and only
+// its last piece can still be trimmed, so a source of nothing but blanks is
+// never buffered whole.
+constexpr qsizetype MaxPendingBlanks = 64 * 1024;
+
+// Length of the license header at the start of data, including the blank
+// lines after it, or 0 if the first comment block (/* */, //, # or --
+// lines) does not mention a license or copyright. Preprocessor directives
+// such as #include or #define are code, not # comments.
+qsizetype licenseHeaderLength(const char *data, qsizetype size);
+
+// Applies the line stages of a chain to a source delivered in pieces of any
+// size, carrying partial lines from one piece to the next. The stage
+// combination picks one of eight kernels specialized at compile time, so a
+// disabled stage costs nothing; runs of plain text are copied 16 bytes at a
+// time after an SSE2 check. StripLicenseHeader is applied by the caller
+// (with licenseHeaderLength()) because it only concerns the first bytes.
+class Chain
+{
+public:
+    explicit Chain(Stages stages);
+
+    bool isIdentity() const; // No line stage enabled
+    void process(const char *data, qsizetype size, QByteArray &out); // Appends to out
+    void finish(QByteArray &out); // End of the source
+
+    struct State {
+        bool pendingCr = false;      // A '\r' waiting to see whether '\n' follows
+        QByteArray pendingSpace;     // Spaces/tabs that are trailing unless content follows, see MaxPendingBlanks
+        bool lineHasContent = false;
+        int blankLines = 0;          // Empty lines emitted in a row
+    };
+
+private:
+    using Kernel = void (*)(State &state, const uchar *data, qsizetype size, QByteArray &out);
+
+    State state;
+    Kernel kernel;
+    Stages lineStages;
+};
+
+} // namespace Transform
+
+#endif // TRANSFORMCHAIN_H
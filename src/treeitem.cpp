@@ -5,7 +5,9 @@
 #include <QtGlobal> // For qWarning, Q_ASSERT
 
 TreeItem::TreeItem(const QString &name, ItemType type, TreeItem *parent)
-    : itemName(name), itemPath(), itemType(type), itemCheckState(Qt::Unchecked), parentItm(parent)
+    : itemName(name), itemPath(), itemType(type), itemId(0), itemCheckState(Qt::Unchecked),
+      itemSize(0), itemLastModified(0), itemContentKind(FileClassifier::Unknown),
+      itemLineCount(-1), itemTokenCount(-1), parentItm(parent)
 {
     // itemPath can be set later using setPath()
 }
@@ -79,10 +81,59 @@ TreeItem::ItemType TreeItem::type() const {
     return itemType; // Uses itemType
 }
 
+quint32 TreeItem::id() const {
+    return itemId;
+}
+
+void TreeItem::setId(quint32 id) {
+    itemId = id;
+}
+
 Qt::CheckState TreeItem::checkState() const {
     return itemCheckState; // Uses itemCheckState
 }
 
 void TreeItem::setCheckState(Qt::CheckState state) {
     itemCheckState = state; // Uses itemCheckState
-}
\ No newline at end of file
+}
+
+qint64 TreeItem::size() const {
+    return itemSize;
+}
+
+void TreeItem::setSize(qint64 size) {
+    itemSize = size;
+}
+
+qint64 TreeItem::lastModified() const {
+    return itemLastModified;
+}
+
+void TreeItem::setLastModified(qint64 msecsSinceEpoch) {
+    itemLastModified = msecsSinceEpoch;
+}
+
+FileClassifier::Kind TreeItem::contentKind() const {
+    return itemContentKind;
+}
+
+void TreeItem::setContentKind(FileClassifier::Kind kind) {
+    itemContentKind = kind;
+}
+
+qint64 TreeItem::lineCount() const {
+    return itemLineCount;
+}
+
+qint64 TreeItem::tokenCount() const {
+    return itemTokenCount;
+}
+
+bool TreeItem::hasTextStats() const {
+    return itemLineCount >= 0;
+}
+
+void TreeItem::setTextStats(qint64 lines, qint64 tokens) {
+    itemLineCount = lines;
+    itemTokenCount = tokens;
+}
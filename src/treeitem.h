@@ -7,6 +7,7 @@
 #include <QList>
 #include <QVariant>
 #include <QString>
+#include "fileclassifier.h"
 #include <QCoreApplication> // For tr // Retained if QCoreApplication::translate is used elsewhere, or for general Qt types
 
 class TreeItem
@@ -34,15 +35,40 @@ public:
 
     ItemType type() const;
 
+    // Position in the model's pre-order node table (assigned during the scan)
+    quint32 id() const;
+    void setId(quint32 id);
+
     Qt::CheckState checkState() const;
     void setCheckState(Qt::CheckState state);
 
+    // Metadata captured from the directory scan (files only)
+    qint64 size() const;
+    void setSize(qint64 size);
+    qint64 lastModified() const; // Milliseconds since epoch (UTC)
+    void setLastModified(qint64 msecsSinceEpoch);
+
+    // Text/binary classification, Unknown until the background classifier ran
+    FileClassifier::Kind contentKind() const;
+    void setContentKind(FileClassifier::Kind kind);
+
+    // Line and token counts for the size estimate, -1 until counted
+    qint64 lineCount() const;
+    qint64 tokenCount() const;
+    bool hasTextStats() const;
+    void setTextStats(qint64 lines, qint64 tokens);
 
 private:
     QString itemName;
     QString itemPath;
     ItemType itemType;
+    quint32 itemId;
     Qt::CheckState itemCheckState;
+    qint64 itemSize;
+    qint64 itemLastModified;
+    FileClassifier::Kind itemContentKind;
+    qint64 itemLineCount;
+    qint64 itemTokenCount;
 
     QList<TreeItem*> childItems;
     TreeItem *parentItm;
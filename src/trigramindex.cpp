@@ -0,0 +1,57 @@
+// trigramindex.cpp
+
+#include "trigramindex.h"
+#include <algorithm>
+#include <iterator>
+
+quint64 TrigramIndex::gramKey(const QChar *gram)
+{
+    // Three UTF-16 code units packed into one integer key.
+    return (quint64(gram[0].unicode()) << 32) | (quint64(gram[1].unicode()) << 16) | quint64(gram[2].unicode());
+}
+
+void TrigramIndex::addName(quint32 id, const QString &name)
+{
+    const QString folded = name.toCaseFolded();
+    for (qsizetype i = 0; i + GramLength <= folded.size(); ++i) {
+        QList<quint32> &list = postings[gramKey(folded.constData() + i)];
+        if (list.isEmpty() || list.last() != id) // Repeated trigram within the same name
+            list.append(id);
+    }
+}
+
+void TrigramIndex::clear()
+{
+    postings.clear();
+}
+
+QList<quint32> TrigramIndex::candidates(const QString &query) const
+{
+    const QString folded = query.toCaseFolded();
+    if (folded.size() < GramLength)
+        return {};
+
+    QList<const QList<quint32> *> lists;
+    for (qsizetype i = 0; i + GramLength <= folded.size(); ++i) {
+        auto it = postings.constFind(gramKey(folded.constData() + i));
+        if (it == postings.constEnd())
+            return {}; // Some trigram occurs in no name at all
+        lists.append(&it.value());
+    }
+
+    // Intersect starting from the shortest list so the working set only shrinks.
+    std::sort(lists.begin(), lists.end(), [](const QList<quint32> *a, const QList<quint32> *b) {
+        return a->size() < b->size();
+    });
+    QList<quint32> result = *lists.first();
+    QList<quint32> intersection;
+    for (qsizetype i = 1; i < lists.size() && !result.isEmpty(); ++i) {
+        if (lists.at(i) == lists.at(i - 1))
+            continue; // Same trigram twice in the query
+        intersection.clear();
+        std::set_intersection(result.cbegin(), result.cend(), lists.at(i)->cbegin(), lists.at(i)->cend(),
+                              std::back_inserter(intersection));
+        result.swap(intersection);
+    }
+    return result;
+}
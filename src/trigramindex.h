@@ -0,0 +1,34 @@
+// trigramindex.h
+// Trigram index over node names, used by the incremental name filter.
+
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+class TrigramIndex
+{
+public:
+    static constexpr int GramLength = 3;
+
+    // Indexes name under id. Ids must be added in ascending order, which keeps
+    // every posting list sorted without an extra pass.
+    void addName(quint32 id, const QString &name);
+    void clear();
+
+    // Queries shorter than GramLength cannot be answered from the index.
+    static bool canQuery(const QString &query) { return query.size() >= GramLength; }
+
+    // Sorted ids of all names containing every trigram of query (case-insensitive).
+    // This is a superset of the names containing query itself; callers verify.
+    QList<quint32> candidates(const QString &query) const;
+
+private:
+    static quint64 gramKey(const QChar *gram);
+
+    QHash<quint64, QList<quint32>> postings;
+};
+
+#endif // TRIGRAMINDEX_H
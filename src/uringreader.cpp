@@ -0,0 +1,406 @@
+// uringreader.cpp
+
+#include "uringreader.h"
+#include <QDebug>
+
+#ifdef FILEMERGER_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+
+// liburing is not required: the three system calls and the ring layout are
+// all that is used, so they are driven directly.
+namespace {
+
+int sysSetup(unsigned entries, io_uring_params *params)
+{
+    return int(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sysEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return int(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int sysRegister(int fd, unsigned opcode, void *arg, unsigned count)
+{
+    return int(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// user_data layout: slot index in the upper bits, operation in the lowest two.
+enum Operation : quint64 { OpOpen = 0, OpRead = 1, OpClose = 2 };
+
+quint64 makeUserData(int slot, Operation op)
+{
+    return (quint64(slot) << 2) | op;
+}
+
+bool probeKernel()
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    const int fd = sysSetup(4, &params);
+    if (fd < 0) {
+        qDebug() << "UringBatchReader: io_uring unavailable:" << strerror(errno);
+        return false;
+    }
+
+    // IORING_REGISTER_PROBE lists the supported opcodes (Linux 5.6+, the
+    // same release that added OPENAT, READ and CLOSE).
+    const unsigned opCount = 256;
+    std::vector<char> storage(sizeof(io_uring_probe) + opCount * sizeof(io_uring_probe_op), 0);
+    auto *probe = reinterpret_cast<io_uring_probe *>(storage.data());
+    bool supported = sysRegister(fd, IORING_REGISTER_PROBE, probe, opCount) >= 0;
+    for (unsigned op : {unsigned(IORING_OP_OPENAT), unsigned(IORING_OP_READ), unsigned(IORING_OP_CLOSE)}) {
+        supported = supported && op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    }
+    ::close(fd);
+    if (!supported) {
+        qDebug() << "UringBatchReader: kernel lacks the required io_uring operations";
+    }
+    return supported;
+}
+
+} // namespace
+#endif // FILEMERGER_HAVE_IO_URING
+
+bool UringBatchReader::isSupported()
+{
+#ifdef FILEMERGER_HAVE_IO_URING
+    static std::once_flag probed;
+    static bool supported = false;
+    std::call_once(probed, [] { supported = probeKernel(); });
+    return supported;
+#else
+    return false;
+#endif
+}
+
+#ifndef FILEMERGER_HAVE_IO_URING
+
+UringBatchReader::UringBatchReader(unsigned queueDepth, qint64 bufferSize)
+    : queueDepth(queueDepth), bufferSize(bufferSize), valid(false),
+      lastError(QStringLiteral("io_uring is not available on this platform"))
+{
+}
+
+UringBatchReader::~UringBatchReader() {}
+
+bool UringBatchReader::run(const QList<QByteArray> &, const ResultHandler &)
+{
+    return false;
+}
+
+#else
+
+UringBatchReader::UringBatchReader(unsigned queueDepth, qint64 bufferSize)
+    : ringFd(-1), sqRingPtr(nullptr), sqRingSize(0), cqRingPtr(nullptr), cqRingSize(0),
+      sqesPtr(nullptr), sqesSize(0), sqHead(nullptr), sqTail(nullptr), sqMask(0), sqEntries(0),
+      sqArray(nullptr), cqHead(nullptr), cqTail(nullptr), cqMask(0), cqEntries(0), cqes(nullptr),
+      sqLocalTail(0), inFlight(0),
+      queueDepth(qMax(1u, queueDepth)), bufferSize(qMax<qint64>(4096, bufferSize)), valid(false)
+{
+    // Every slot can have one open or read in flight plus one close whose
+    // slot was already reused, so twice the depth always fits.
+    valid = isSupported() && setupRing(this->queueDepth * 2);
+    if (valid) {
+        slots.resize(this->queueDepth);
+        buffers.resize(size_t(this->queueDepth) * size_t(this->bufferSize));
+    }
+}
+
+UringBatchReader::~UringBatchReader()
+{
+    teardownRing();
+}
+
+bool UringBatchReader::setupRing(unsigned entries)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ringFd = sysSetup(entries, &params);
+    if (ringFd < 0) {
+        lastError = QString::fromLocal8Bit(strerror(errno));
+        return false;
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap) {
+        sqRingSize = cqRingSize = qMax(sqRingSize, cqRingSize);
+    }
+
+    sqRingPtr = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRingPtr == MAP_FAILED) {
+        sqRingPtr = nullptr;
+        lastError = QString::fromLocal8Bit(strerror(errno));
+        teardownRing();
+        return false;
+    }
+    if (singleMap) {
+        cqRingPtr = sqRingPtr;
+    } else {
+        cqRingPtr = ::mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRingPtr == MAP_FAILED) {
+            cqRingPtr = nullptr;
+            lastError = QString::fromLocal8Bit(strerror(errno));
+            teardownRing();
+            return false;
+        }
+    }
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqesPtr = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqesPtr == MAP_FAILED) {
+        sqesPtr = nullptr;
+        lastError = QString::fromLocal8Bit(strerror(errno));
+        teardownRing();
+        return false;
+    }
+
+    char *sq = static_cast<char *>(sqRingPtr);
+    sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    char *cq = static_cast<char *>(cqRingPtr);
+    cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqEntries = params.cq_entries;
+    cqes = cq + params.cq_off.cqes;
+    sqLocalTail = *sqTail;
+    return true;
+}
+
+void UringBatchReader::teardownRing()
+{
+    if (sqesPtr) {
+        ::munmap(sqesPtr, sqesSize);
+        sqesPtr = nullptr;
+    }
+    if (cqRingPtr && cqRingPtr != sqRingPtr) {
+        ::munmap(cqRingPtr, cqRingSize);
+    }
+    cqRingPtr = nullptr;
+    if (sqRingPtr) {
+        ::munmap(sqRingPtr, sqRingSize);
+        sqRingPtr = nullptr;
+    }
+    if (ringFd >= 0) {
+        ::close(ringFd);
+        ringFd = -1;
+    }
+}
+
+char *UringBatchReader::slotBuffer(int slot)
+{
+    return buffers.data() + size_t(slot) * size_t(bufferSize);
+}
+
+// The submission queue never overflows: each slot has at most one open or
+// read queued, and at most queueDepth closes are queued between two submits,
+// while the ring has twice queueDepth entries.
+io_uring_sqe *UringBatchReader::nextSqe()
+{
+    const unsigned index = sqLocalTail++ & sqMask; // Only this thread advances the tail
+    sqArray[index] = index;
+    io_uring_sqe *sqe = static_cast<io_uring_sqe *>(sqesPtr) + index;
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+void UringBatchReader::queueOpen(int slot, const char *path)
+{
+    io_uring_sqe *sqe = nextSqe();
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<quint64>(path);
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    sqe->user_data = makeUserData(slot, OpOpen);
+    slots[slot].state = SlotState::Opening;
+}
+
+void UringBatchReader::queueRead(int slot)
+{
+    io_uring_sqe *sqe = nextSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = slots[slot].fd;
+    sqe->addr = reinterpret_cast<quint64>(slotBuffer(slot));
+    sqe->len = unsigned(bufferSize);
+    sqe->off = 0;
+    sqe->user_data = makeUserData(slot, OpRead);
+    slots[slot].state = SlotState::Reading;
+}
+
+void UringBatchReader::queueClose(int fd)
+{
+    io_uring_sqe *sqe = nextSqe();
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = fd;
+    sqe->user_data = makeUserData(0, OpClose);
+}
+
+bool UringBatchReader::submitAndWait(unsigned minComplete)
+{
+    unsigned toSubmit = sqLocalTail - *sqTail;
+    if (toSubmit > 0) {
+        __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+    }
+    while (toSubmit > 0 || minComplete > 0) {
+        const int ret = sysEnter(ringFd, toSubmit, minComplete, minComplete ? IORING_ENTER_GETEVENTS : 0);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EBUSY || errno == EAGAIN) {
+                // Completion queue is full; make room and retry. Anything this
+                // queues is published by the next call.
+                reapCompletions(false);
+                minComplete = 0;
+                continue;
+            }
+            lastError = QString::fromLocal8Bit(strerror(errno));
+            return false;
+        }
+        inFlight += unsigned(ret);
+        toSubmit -= unsigned(ret);
+        minComplete = 0;
+    }
+    return true;
+}
+
+void UringBatchReader::reapCompletions(bool draining)
+{
+    unsigned head = *cqHead;
+    const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const io_uring_cqe &cqe = static_cast<io_uring_cqe *>(cqes)[head & cqMask];
+        --inFlight;
+        const Operation op = Operation(cqe.user_data & 3);
+        if (op == OpClose) {
+            continue;
+        }
+        Slot &slot = slots[size_t(cqe.user_data >> 2)];
+        if (op == OpOpen) {
+            if (cqe.res < 0) {
+                slot.error = -cqe.res;
+                slot.state = SlotState::Done;
+            } else if (draining) {
+                ::close(cqe.res);
+                slot.state = SlotState::Done;
+            } else {
+                slot.fd = cqe.res;
+                queueRead(int(&slot - slots.data()));
+            }
+        } else {
+            // One read, which may return less than the file holds even short
+            // of the buffer size; the caller compares the size it expected.
+            if (cqe.res < 0) {
+                slot.error = -cqe.res;
+            } else {
+                slot.bytes = cqe.res;
+            }
+            if (draining) {
+                ::close(slot.fd);
+            } else {
+                queueClose(slot.fd);
+            }
+            slot.fd = -1;
+            slot.state = SlotState::Done;
+        }
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+}
+
+bool UringBatchReader::run(const QList<QByteArray> &paths, const ResultHandler &handler)
+{
+    if (!valid) {
+        return false;
+    }
+    lastError.clear();
+    for (Slot &slot : slots) {
+        slot = Slot();
+    }
+
+    const int fileCount = int(paths.size());
+    const int depth = int(queueDepth);
+    int nextToOpen = 0;
+    int nextToDeliver = 0;
+    bool ok = true;
+
+    while (ok && nextToDeliver < fileCount) {
+        // Keep the window of in-flight files full.
+        while (nextToOpen < fileCount && nextToOpen - nextToDeliver < depth) {
+            Slot &slot = slots[size_t(nextToOpen % depth)];
+            slot = Slot();
+            slot.fileIndex = nextToOpen;
+            queueOpen(nextToOpen % depth, paths.at(nextToOpen).constData());
+            ++nextToOpen;
+        }
+
+        Slot &head = slots[size_t(nextToDeliver % depth)];
+        if (head.state != SlotState::Done) {
+            // Submit whatever is queued and wait for at least one completion.
+            if (!submitAndWait(1)) {
+                ok = false;
+                break;
+            }
+            reapCompletions(false);
+            continue;
+        }
+
+        // Hand out every finished file at the front of the window.
+        while (nextToDeliver < nextToOpen) {
+            Slot &slot = slots[size_t(nextToDeliver % depth)];
+            if (slot.state != SlotState::Done) {
+                break;
+            }
+            Result result;
+            result.index = slot.fileIndex;
+            result.data = slotBuffer(nextToDeliver % depth);
+            result.size = slot.error ? 0 : slot.bytes;
+            result.error = slot.error;
+            result.truncated = !slot.error && slot.bytes == bufferSize;
+            slot.state = SlotState::Free;
+            ++nextToDeliver;
+            if (!handler(result)) {
+                lastError = QStringLiteral("Reading was aborted");
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    // Flush queued closes and let every outstanding request finish so no
+    // descriptor or buffer reference outlives this call.
+    if (!submitAndWait(0)) {
+        qWarning() << "UringBatchReader: could not submit final requests:" << lastError;
+    }
+    while (inFlight > 0) {
+        if (sysEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            qWarning() << "UringBatchReader: waiting for completions failed:" << strerror(errno);
+            break;
+        }
+        reapCompletions(true);
+    }
+    return ok;
+}
+
+#endif // FILEMERGER_HAVE_IO_URING
+
+bool UringBatchReader::isValid() const
+{
+    return valid;
+}
+
+QString UringBatchReader::errorString() const
+{
+    return lastError;
+}
@@ -0,0 +1,113 @@
+// uringreader.h
+// Batched open/read/close of many small files through Linux io_uring.
+
+#ifndef URINGREADER_H
+#define URINGREADER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <functional>
+#include <vector>
+
+#if defined(Q_OS_LINUX) && __has_include(<linux/io_uring.h>)
+#define FILEMERGER_HAVE_IO_URING
+#endif
+
+// Keeps up to queueDepth files in flight: each one is opened, read into its
+// own slot buffer with a single read and closed, all as io_uring requests
+// submitted in batches. Results are handed out strictly in input order so
+// they can be appended to the merge output as they arrive.
+//
+// Only the first bufferSize bytes of a file are read. Larger files are
+// reported as truncated and the caller reads them another way. A read can
+// also come back short without reaching the end of the file, so a caller
+// that knows the file size checks it and reads such a file another way too.
+class UringBatchReader
+{
+public:
+    static constexpr unsigned DefaultQueueDepth = 64;
+    static constexpr qint64 DefaultBufferSize = 64 * 1024;
+
+    struct Result {
+        int index;        // Position in the list passed to run()
+        const char *data; // Valid only during the handler call
+        qint64 size;      // What the single read returned
+        int error;        // 0, or the errno of the failed open/read
+        bool truncated;   // The file filled the buffer and may hold more
+    };
+    // Returns false to stop reading.
+    using ResultHandler = std::function<bool(const Result &result)>;
+
+    // True if the running kernel provides io_uring with the needed operations.
+    // Probed once per process; always false on other platforms.
+    static bool isSupported();
+
+    explicit UringBatchReader(unsigned queueDepth = DefaultQueueDepth, qint64 bufferSize = DefaultBufferSize);
+    ~UringBatchReader();
+
+    bool isValid() const;
+
+    // Reads the files (paths in local 8-bit encoding, see QFile::encodeName)
+    // and calls handler once per file in input order. Returns false on a ring
+    // error or when the handler asked to stop; all descriptors are closed
+    // either way.
+    bool run(const QList<QByteArray> &paths, const ResultHandler &handler);
+
+    QString errorString() const;
+
+private:
+    Q_DISABLE_COPY(UringBatchReader)
+
+#ifdef FILEMERGER_HAVE_IO_URING
+    enum class SlotState { Free, Opening, Reading, Done };
+    struct Slot {
+        int fileIndex = -1;
+        SlotState state = SlotState::Free;
+        int fd = -1;
+        qint64 bytes = 0;
+        int error = 0;
+    };
+
+    bool setupRing(unsigned entries);
+    void teardownRing();
+    struct io_uring_sqe *nextSqe();
+    void queueOpen(int slot, const char *path);
+    void queueRead(int slot);
+    void queueClose(int fd);
+    bool submitAndWait(unsigned minComplete);
+    void reapCompletions(bool draining);
+    char *slotBuffer(int slot);
+
+    int ringFd;
+    void *sqRingPtr;
+    size_t sqRingSize;
+    void *cqRingPtr;
+    size_t cqRingSize;
+    void *sqesPtr;
+    size_t sqesSize;
+
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned *sqArray;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned cqMask;
+    unsigned cqEntries;
+    void *cqes;
+
+    unsigned sqLocalTail;        // Tail including entries not yet published to the kernel
+    unsigned inFlight;           // Submitted and not yet completed
+    std::vector<Slot> slots;
+    std::vector<char> buffers;
+#endif
+
+    unsigned queueDepth;
+    qint64 bufferSize;
+    bool valid;
+    QString lastError;
+};
+
+#endif // URINGREADER_H
@@ -0,0 +1,256 @@
+// utf8.cpp
+
+#include "utf8.h"
+#include <cstring> // For memcpy
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTF8_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+// The AVX2 kernel is compiled with a target attribute and picked at run time,
+// so the binary still runs on CPUs without AVX2.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UTF8_HAVE_AVX2_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace Utf8 {
+
+bool isValidScalar(const char *data, qsizetype size, bool allowTruncatedTail)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    const uchar *end = p + size;
+
+    while (p < end) {
+#ifdef UTF8_HAVE_SSE2
+        // ASCII fast path: skip sixteen bytes at a time while no high bit is set.
+        while (end - p >= 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            if (_mm_movemask_epi8(block))
+                break;
+            p += 16;
+        }
+#endif
+        // Same for eight bytes (the tail, or the whole buffer without SSE2).
+        while (end - p >= 8) {
+            quint64 word;
+            std::memcpy(&word, p, sizeof(word));
+            if (word & 0x8080808080808080ULL)
+                break;
+            p += 8;
+        }
+        if (p == end)
+            break;
+
+        const uchar lead = *p;
+        if (lead < 0x80) {
+            ++p;
+            continue;
+        }
+
+        qsizetype length;
+        if (lead >= 0xC2 && lead <= 0xDF)
+            length = 2;
+        else if ((lead & 0xF0) == 0xE0)
+            length = 3;
+        else if (lead >= 0xF0 && lead <= 0xF4)
+            length = 4;
+        else
+            return false; // Continuation byte, overlong 2-byte lead (C0/C1) or F5..FF
+
+        const qsizetype available = qMin<qsizetype>(length, end - p);
+        if (available < length && !allowTruncatedTail)
+            return false;
+
+        if (available >= 2) {
+            const uchar second = p[1];
+            if ((second & 0xC0) != 0x80)
+                return false;
+            if (lead == 0xE0 && second < 0xA0)
+                return false; // Overlong 3-byte form
+            if (lead == 0xED && second > 0x9F)
+                return false; // UTF-16 surrogate
+            if (lead == 0xF0 && second < 0x90)
+                return false; // Overlong 4-byte form
+            if (lead == 0xF4 && second > 0x8F)
+                return false; // Above U+10FFFF
+        }
+        for (qsizetype i = 2; i < available; ++i) {
+            if ((p[i] & 0xC0) != 0x80)
+                return false;
+        }
+        p += available;
+    }
+    return true;
+}
+
+#ifdef UTF8_HAVE_AVX2_DISPATCH
+
+namespace {
+
+// Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte"
+// (2021): every error shows up as a bit that is set in all three lookups
+// indexed by the high and low nibble of the previous byte and the high nibble
+// of the current one. Runs of three and four byte sequences are checked
+// separately against the bytes two and three positions back.
+enum : quint8 {
+    TooShort = 1 << 0,     // Lead byte followed by a lead or ASCII byte
+    TooLong = 1 << 1,      // ASCII followed by a continuation byte
+    Overlong3 = 1 << 2,    // E0 80..9F
+    TooLarge = 1 << 3,     // F4 90..BF, F5..FF
+    Surrogate = 1 << 4,    // ED A0..BF
+    Overlong2 = 1 << 5,    // C0, C1
+    TooLarge1000 = 1 << 6, // F5..FF followed by 80..8F
+    Overlong4 = 1 << 6,    // F0 80..8F
+    TwoConts = 1 << 7,     // Two continuation bytes in a row
+    Carry = TooShort | TooLong | TwoConts
+};
+
+__attribute__((target("avx2"))) inline __m256i lookup16(__m256i nibbles, __m256i table)
+{
+    return _mm256_shuffle_epi8(table, nibbles);
+}
+
+__attribute__((target("avx2"))) inline __m256i table16(quint8 t0, quint8 t1, quint8 t2, quint8 t3, quint8 t4, quint8 t5,
+                                                        quint8 t6, quint8 t7, quint8 t8, quint8 t9, quint8 t10, quint8 t11,
+                                                        quint8 t12, quint8 t13, quint8 t14, quint8 t15)
+{
+    return _mm256_setr_epi8(char(t0), char(t1), char(t2), char(t3), char(t4), char(t5), char(t6), char(t7),
+                            char(t8), char(t9), char(t10), char(t11), char(t12), char(t13), char(t14), char(t15),
+                            char(t0), char(t1), char(t2), char(t3), char(t4), char(t5), char(t6), char(t7),
+                            char(t8), char(t9), char(t10), char(t11), char(t12), char(t13), char(t14), char(t15));
+}
+
+// Bytes of input shifted right by N positions, with the last N bytes of prev shifted in.
+template <int N>
+__attribute__((target("avx2"))) inline __m256i previous(__m256i input, __m256i prev)
+{
+    return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - N);
+}
+
+__attribute__((target("avx2"))) inline __m256i shiftRight4(__m256i v)
+{
+    return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
+
+__attribute__((target("avx2"))) __m256i blockErrors(__m256i input, __m256i prevInput)
+{
+    const __m256i prev1 = previous<1>(input, prevInput);
+
+    const __m256i byte1High = lookup16(shiftRight4(prev1), table16(
+        TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong,
+        TwoConts, TwoConts, TwoConts, TwoConts,
+        TooShort | Overlong2,
+        TooShort,
+        TooShort | Overlong3 | Surrogate,
+        TooShort | TooLarge | TooLarge1000 | Overlong4));
+    const __m256i byte1Low = lookup16(_mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)), table16(
+        Carry | Overlong3 | Overlong2 | Overlong4,
+        Carry | Overlong2,
+        Carry,
+        Carry,
+        Carry | TooLarge,
+        Carry | TooLarge | TooLarge1000,
+        Carry | TooLarge | TooLarge1000,
+        Carry | TooLarge | TooLarge1000,
+        Carry | TooLarge | TooLarge1000,
+        Carry | TooLarge | TooLarge1000,
+        Carry | TooLarge | TooLarge1000,
+        Carry | TooLarge | TooLarge1000,
+        Carry | TooLarge | TooLarge1000,
+        Carry | TooLarge | TooLarge1000 | Surrogate,
+        Carry | TooLarge | TooLarge1000,
+        Carry | TooLarge | TooLarge1000));
+    const __m256i byte2High = lookup16(shiftRight4(input), table16(
+        TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort,
+        TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge1000 | Overlong4,
+        TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge,
+        TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,
+        TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,
+        TooShort, TooShort, TooShort, TooShort));
+    const __m256i special = _mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+
+    // A byte two (three) positions after an E0..EF (F0..FF) lead must be a
+    // continuation; exactly those positions may carry the TwoConts bit. The
+    // saturating subtraction leaves bit 7 set only for such leads.
+    const __m256i prev2 = previous<2>(input, prevInput);
+    const __m256i prev3 = previous<3>(input, prevInput);
+    const __m256i isThird = _mm256_subs_epu8(prev2, _mm256_set1_epi8(char(0xE0 - 0x80)));
+    const __m256i isFourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(char(0xF0 - 0x80)));
+    const __m256i must23 = _mm256_and_si256(_mm256_or_si256(isThird, isFourth), _mm256_set1_epi8(char(0x80)));
+    return _mm256_xor_si256(must23, special);
+}
+
+// Non-zero where the block ends inside a multi-byte sequence.
+__attribute__((target("avx2"))) inline __m256i incompleteTail(__m256i input)
+{
+    const __m256i maxValue = _mm256_setr_epi8(
+        char(255), char(255), char(255), char(255), char(255), char(255), char(255), char(255),
+        char(255), char(255), char(255), char(255), char(255), char(255), char(255), char(255),
+        char(255), char(255), char(255), char(255), char(255), char(255), char(255), char(255),
+        char(255), char(255), char(255), char(255), char(255),
+        char(0xF0 - 1), char(0xE0 - 1), char(0xC0 - 1));
+    return _mm256_subs_epu8(input, maxValue);
+}
+
+// Validates all whole 32-byte blocks and returns how many bytes from the
+// start are known to be good, or -1 on an error. Whatever follows (the tail
+// plus any sequence that runs across the last block boundary) is left to the
+// scalar code.
+__attribute__((target("avx2"))) qsizetype validatedPrefixAvx2(const uchar *data, qsizetype size)
+{
+    const qsizetype blocksEnd = size & ~qsizetype(31);
+    __m256i error = _mm256_setzero_si256();
+    __m256i prevInput = _mm256_setzero_si256();
+    __m256i prevIncomplete = _mm256_setzero_si256();
+
+    for (qsizetype i = 0; i < blocksEnd; i += 32) {
+        const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        if (_mm256_movemask_epi8(input) == 0) {
+            // All ASCII: fine unless the previous block ended mid-sequence.
+            error = _mm256_or_si256(error, prevIncomplete);
+            prevInput = _mm256_setzero_si256();
+            prevIncomplete = _mm256_setzero_si256();
+            continue;
+        }
+        error = _mm256_or_si256(error, blockErrors(input, prevInput));
+        prevIncomplete = incompleteTail(input);
+        prevInput = input;
+    }
+    if (!_mm256_testz_si256(error, error))
+        return -1;
+
+    // Back up to the start of the last sequence so the scalar pass sees it whole.
+    qsizetype boundary = blocksEnd;
+    for (int back = 0; back < 3 && boundary > 0 && (data[boundary - 1] & 0xC0) == 0x80; ++back)
+        --boundary;
+    if (boundary > 0 && data[boundary - 1] >= 0xC0)
+        --boundary;
+    return boundary;
+}
+
+bool cpuHasAvx2()
+{
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+} // namespace
+
+#endif // UTF8_HAVE_AVX2_DISPATCH
+
+bool isValid(const char *data, qsizetype size, bool allowTruncatedTail)
+{
+#ifdef UTF8_HAVE_AVX2_DISPATCH
+    if (size >= 64 && cpuHasAvx2()) {
+        const qsizetype prefix = validatedPrefixAvx2(reinterpret_cast<const uchar *>(data), size);
+        if (prefix < 0)
+            return false;
+        return isValidScalar(data + prefix, size - prefix, allowTruncatedTail);
+    }
+#endif
+    return isValidScalar(data, size, allowTruncatedTail);
+}
+
+} // namespace Utf8
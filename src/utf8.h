@@ -0,0 +1,23 @@
+// utf8.h
+// UTF-8 well-formedness checks shared by the file classifier and the merge.
+
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <QtGlobal>
+
+namespace Utf8 {
+
+// True if data is well-formed UTF-8: no overlong forms, no surrogates and
+// nothing above U+10FFFF. With allowTruncatedTail an incomplete (but so far
+// valid) sequence at the very end is accepted, which is what a check of the
+// first few KB of a longer file needs.
+// Uses an AVX2 kernel when the CPU has one and an SSE2 ASCII fast path otherwise.
+bool isValid(const char *data, qsizetype size, bool allowTruncatedTail = false);
+
+// Same result without the AVX2 kernel; also used for the tail of a buffer.
+bool isValidScalar(const char *data, qsizetype size, bool allowTruncatedTail = false);
+
+} // namespace Utf8
+
+#endif // UTF8_H
@@ -0,0 +1,56 @@
+QT       += core testlib concurrent
+CONFIG   += console testcase # testcase auto-generates main() for tests
+CONFIG   += c++20 # Coroutines, see asynctask.h
+TARGET   = tst_mergeworker
+
+# Input
+HEADERS += \
+    ../src/filemergerlogic.h \
+    ../src/mergeio.h \
+    ../src/blockcompression.h \
+    ../src/uringreader.h \
+    ../src/sourceencoding.h \
+    ../src/fileidentity.h \
+    ../src/contenthash.h \
+    ../src/mergecheckpoint.h \
+    ../src/mergemanifest.h \
+    ../src/selectionsnapshot.h \
+    ../src/asynctask.h \
+    ../src/bundleindex.h \
+    ../src/transformchain.h \
+    ../src/redaction.h \
+    ../src/fileclassifier.h \
+    ../src/utf8.h
+
+SOURCES += \
+    ../src/filemergerlogic.cpp \
+    ../src/mergeio.cpp \
+    ../src/blockcompression.cpp \
+    ../src/uringreader.cpp \
+    ../src/sourceencoding.cpp \
+    ../src/fileidentity.cpp \
+    ../src/contenthash.cpp \
+    ../src/mergecheckpoint.cpp \
+    ../src/mergemanifest.cpp \
+    ../src/selectionsnapshot.cpp \
+    ../src/bundleindex.cpp \
+    ../src/transformchain.cpp \
+    ../src/redaction.cpp \
+    ../src/fileclassifier.cpp \
+    ../src/utf8.cpp \
+    tst_mergeworker.cpp
+
+# Compressed output, see filemerger.pro
+CONFIG += link_pkgconfig
+packagesExist(zlib) {
+    PKGCONFIG += zlib
+} else {
+    LIBS += -lz
+}
+packagesExist(libzstd) {
+    PKGCONFIG += libzstd
+    DEFINES += FILEMERGER_HAVE_ZSTD
+}
+
+# Benchmarks (functions named bench*) can be run on their own, e.g.:
+#   ./tst_mergeworker benchSourceReader
@@ -1,15 +1,31 @@
-QT       += core testlib # REMOVED gui
+QT       += core testlib concurrent # REMOVED gui
 CONFIG   += console testcase # testcase auto-generates main() for tests
 TARGET   = tst_customfilemodel
 
 # Input
 HEADERS += \
     ../src/customfilemodel.h \
-    ../src/treeitem.h
+    ../src/treeitem.h \
+    ../src/contentsearch.h \
+    ../src/fileclassifier.h \
+    ../src/fileidentity.h \
+    ../src/textstats.h \
+    ../src/utf8.h \
+    ../src/trigramindex.h \
+    ../src/selectionprofiles.h \
+    ../src/selectionsnapshot.h
 
 SOURCES += \
     ../src/customfilemodel.cpp \
     ../src/treeitem.cpp \
+    ../src/contentsearch.cpp \
+    ../src/fileclassifier.cpp \
+    ../src/fileidentity.cpp \
+    ../src/textstats.cpp \
+    ../src/utf8.cpp \
+    ../src/trigramindex.cpp \
+    ../src/selectionprofiles.cpp \
+    ../src/selectionsnapshot.cpp \
     tst_customfilemodel.cpp
 
 # If your customfilemodel.cpp or treeitem.cpp use tr() for strings that should be translated,
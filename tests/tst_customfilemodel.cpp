@@ -6,10 +6,16 @@
 #include <QFile>            // For creating dummy files
 #include <QSignalSpy>       // For testing signal emissions
 #include <QStandardPaths>   // For robust temporary path handling if needed
+#include <algorithm>        // For std::sort
 
 // Include the class to be tested
 // Adjust the path as necessary if your test file is in a different directory
 #include "customfilemodel.h"
+#include "fileclassifier.h"
+#include "selectionprofiles.h"
+#include "selectionsnapshot.h"
+#include "textstats.h"
+#include <QRandomGenerator>
 // You might also need to include treeitem.h if it's not fully opaque
 // #include "treeitem.h"
 
@@ -69,6 +75,33 @@ private slots:
     void testSelectFilesByExtensionRecursive_FromRoot();
     void testSelectFilesByExtensionRecursive_FromSubfolder();
 
+    // Content-based Selection
+    void testSelectFilesByContent_MatchesAnyPattern();
+    void testSelectFilesByContent_LargeFileBoundaryMatch();
+
+    // Metadata / Predicate Selection
+    void testMetadataRoles_CapturedDuringScan();
+    void testSelectFilesByPredicate_SizeMtimeDepth();
+
+    // Text/Binary Classification
+    void testContentClassification_TextAndBinaryRoles();
+    void testSkipBinaryFiles_BulkSelections();
+
+    // Name Filter
+    void testNameFilter_ShowsMatchesAndAncestors();
+    void testNameFilter_CheckOperationsApplyToFilteredSet();
+
+    // Selection Profiles
+    void testSelectionProfile_SerializeRoundTrip();
+    void testApplySelection_ReplacesSelection();
+
+    // Selection Estimate
+    void testSelectionTotals_TrackChecksAndTextStatistics();
+    void testTextCounter_VectorizedMatchesScalar();
+
+    // Selection Snapshot
+    void testSelectionSnapshot_MatchesCheckedFilesAndStaysFixed();
+
 
 private:
     CustomFileModel *model;
@@ -78,6 +111,7 @@ private:
     // Helper to create a common populated directory structure
     void createPopulatedTestDirectory(const QString& basePath);
     void createExtensionTestDirectory(const QString& basePath);
+    void createClassificationTestDirectory(const QString& basePath);
 
     // Helper to find item by name
     QModelIndex findItem(const QString& name, const QModelIndex& parent = QModelIndex()) const;
@@ -1061,6 +1095,453 @@ void TestCustomFileModel::testSelectFilesByExtensionRecursive_FromSubfolder()
     QCOMPARE(model->data(fileTxtIndex, Qt::CheckStateRole).toInt(), Qt::Unchecked);
 }
 
+// ---- Content-based Selection Tests ----
+void TestCustomFileModel::testSelectFilesByContent_MatchesAnyPattern()
+{
+    // ARRANGE
+    QDir dir(originalModelRootPath);
+    QVERIFY(dir.mkpath("src"));
+    auto createFile = [&](const QString& name, const QByteArray& content){
+        QFile file(dir.filePath(name));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(content);
+        file.close();
+    };
+    createFile("a.txt", "nothing to see here");
+    createFile("b.txt", "fatal: ERR_4711 while loading");
+    createFile("src/c.cpp", "int main() { return ERR_0815; }");
+    createFile("src/d.cpp", "ERR_ without a code");
+    delete model; model = new CustomFileModel(originalModelRootPath);
+
+    QSignalSpy finishedSpy(model, &CustomFileModel::contentSelectionFinished);
+    QSignalSpy changedSpy(model, &CustomFileModel::dataChanged);
+
+    // ACT
+    QVERIFY(model->selectFilesByContent(QModelIndex(), {"ERR_4711", "ERR_0815"}));
+    QVERIFY(model->isContentSelectionRunning());
+    QVERIFY(!model->selectFilesByContent(QModelIndex(), {"other"})); // Only one scan at a time
+    QVERIFY(finishedSpy.wait(5000));
+
+    // ASSERT
+    QCOMPARE(finishedSpy.first().at(0).toInt(), 2);
+    QCOMPARE(finishedSpy.first().at(1).toBool(), false);
+    QVERIFY(!model->isContentSelectionRunning());
+
+    QStringList paths = model->getCheckedFilesPaths();
+    QCOMPARE(paths.count(), 2);
+    QVERIFY(paths.contains(dir.filePath("b.txt")));
+    QVERIFY(paths.contains(dir.filePath("src/c.cpp")));
+
+    // Results are applied as one range per touched parent: root level and src/
+    QCOMPARE(changedSpy.count(), 2);
+    QModelIndex srcIndex = findItem("src");
+    QCOMPARE(model->data(srcIndex, Qt::CheckStateRole).toInt(), static_cast<int>(Qt::PartiallyChecked));
+}
+
+void TestCustomFileModel::testSelectFilesByContent_LargeFileBoundaryMatch()
+{
+    // ARRANGE: a file above the mmap threshold whose only match straddles
+    // the boundary between two scan windows.
+    QByteArray content(2 * 1024 * 1024, 'x');
+    const QByteArray needle("NEEDLE_IN_HAYSTACK");
+    content.replace(256 * 1024 - 5, needle.size(), needle);
+    QFile file(QDir(originalModelRootPath).filePath("big.log"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(content);
+    file.close();
+    QFile other(QDir(originalModelRootPath).filePath("small.log"));
+    QVERIFY(other.open(QIODevice::WriteOnly));
+    other.write("NEEDLE_IN_HAY");
+    other.close();
+    delete model; model = new CustomFileModel(originalModelRootPath);
+
+    QSignalSpy finishedSpy(model, &CustomFileModel::contentSelectionFinished);
+
+    // ACT
+    QVERIFY(model->selectFilesByContent(QModelIndex(), {QString::fromLatin1(needle)}));
+    QVERIFY(finishedSpy.wait(5000));
+
+    // ASSERT
+    QCOMPARE(model->getCheckedFilesPaths(), QStringList{file.fileName()});
+}
+
+// ---- Metadata / Predicate Selection Tests ----
+void TestCustomFileModel::testMetadataRoles_CapturedDuringScan()
+{
+    // ARRANGE
+    createPopulatedTestDirectory(originalModelRootPath);
+    delete model; model = new CustomFileModel(originalModelRootPath);
+
+    // ACT
+    QModelIndex fileIndex = findItem("file_root1.txt");
+    QModelIndex folderIndex = findItem("folderA");
+
+    // ASSERT
+    QVERIFY(fileIndex.isValid());
+    QCOMPARE(model->data(fileIndex, CustomFileModel::FileSizeRole).toLongLong(), qint64(strlen("content_root1")));
+    QCOMPARE(model->data(fileIndex, CustomFileModel::LastModifiedRole).toDateTime(),
+             QFileInfo(QDir(originalModelRootPath).filePath("file_root1.txt")).lastModified());
+    QVERIFY(!model->data(folderIndex, CustomFileModel::FileSizeRole).isValid()); // Folders carry no size
+}
+
+void TestCustomFileModel::testSelectFilesByPredicate_SizeMtimeDepth()
+{
+    // ARRANGE
+    QDir dir(originalModelRootPath);
+    QVERIFY(dir.mkpath("deep/nested"));
+    auto createFile = [&](const QString& name, int size, const QDateTime& modified = QDateTime()) {
+        QFile file(dir.filePath(name));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(QByteArray(size, 'a'));
+        file.close();
+        if (modified.isValid()) {
+            QVERIFY(file.open(QIODevice::Append));
+            QVERIFY(file.setFileTime(modified, QFileDevice::FileModificationTime));
+            file.close();
+        }
+    };
+    createFile("small_recent.txt", 10);
+    createFile("big_recent.txt", 2000);
+    createFile("small_old.txt", 10, QDateTime::currentDateTime().addDays(-3));
+    createFile("deep/nested/small_recent_deep.txt", 10);
+    delete model; model = new CustomFileModel(originalModelRootPath);
+
+    FilePredicate predicate;
+    predicate.maxSize = 1000;
+    predicate.modifiedAfter = QDateTime::currentDateTime().addSecs(-24 * 3600);
+
+    // Files touched after the scan must not affect the result: metadata is from the scan.
+    createFile("big_recent.txt", 5);
+
+    // ACT
+    int selected = model->selectFilesByPredicate(QModelIndex(), predicate);
+
+    // ASSERT
+    QCOMPARE(selected, 2);
+    QStringList paths = model->getCheckedFilesPaths();
+    QCOMPARE(paths.count(), 2);
+    QVERIFY(paths.contains(dir.filePath("small_recent.txt")));
+    QVERIFY(paths.contains(dir.filePath("deep/nested/small_recent_deep.txt")));
+
+    // Depth limit: only files directly in the start folder
+    model->setAllCheckStates(Qt::Unchecked);
+    predicate.maxDepth = 1;
+    QCOMPARE(model->selectFilesByPredicate(QModelIndex(), predicate), 1);
+    QCOMPARE(model->getCheckedFilesPaths(), QStringList{dir.filePath("small_recent.txt")});
+}
+
+// ---- Text/Binary Classification Tests ----
+void TestCustomFileModel::createClassificationTestDirectory(const QString& basePath)
+{
+    QDir dir(basePath);
+    QVERIFY(dir.mkpath("mixed"));
+    auto createFile = [&](const QString& name, const QByteArray& content){
+        QFile file(dir.filePath(name));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(content);
+        file.close();
+    };
+    createFile("readme.txt", "plain text\n");
+    createFile("utf8.txt", "gr\xc3\xbc\xc3\x9f dich\n");
+    createFile("latin1.txt", "gr\xfc\xdf dich\n"); // Not UTF-8, but MIME says text
+    createFile("mixed/code.cpp", "int main() {}\n");
+    createFile("mixed/object.o", QByteArray("\x7f" "ELF\x02\x01\x01\x00\x00\x00", 10));
+}
+
+void TestCustomFileModel::testContentClassification_TextAndBinaryRoles()
+{
+    // ARRANGE
+    createClassificationTestDirectory(originalModelRootPath);
+    delete model; model = new CustomFileModel(originalModelRootPath);
+    QModelIndex readme = findItem("readme.txt");
+    QCOMPARE(model->data(readme, CustomFileModel::ContentKindRole).toInt(), static_cast<int>(FileClassifier::Unknown));
+
+    QSignalSpy finishedSpy(model, &CustomFileModel::contentClassificationFinished);
+
+    // ACT
+    model->startContentClassification();
+    QVERIFY(finishedSpy.wait(5000));
+
+    // ASSERT
+    QCOMPARE(finishedSpy.first().at(0).toInt(), 1);
+    QVERIFY(!model->isContentClassificationRunning());
+    QCOMPARE(model->data(readme, CustomFileModel::ContentKindRole).toInt(), static_cast<int>(FileClassifier::Text));
+    QCOMPARE(model->data(findItem("utf8.txt"), CustomFileModel::ContentKindRole).toInt(), static_cast<int>(FileClassifier::Text));
+    QCOMPARE(model->data(findItem("latin1.txt"), CustomFileModel::ContentKindRole).toInt(), static_cast<int>(FileClassifier::Text));
+    QModelIndex mixed = findItem("mixed");
+    QCOMPARE(model->data(findItem("object.o", mixed), CustomFileModel::ContentKindRole).toInt(), static_cast<int>(FileClassifier::Binary));
+}
+
+void TestCustomFileModel::testSkipBinaryFiles_BulkSelections()
+{
+    // ARRANGE
+    createClassificationTestDirectory(originalModelRootPath);
+    delete model; model = new CustomFileModel(originalModelRootPath);
+    QSignalSpy finishedSpy(model, &CustomFileModel::contentClassificationFinished);
+    model->startContentClassification();
+    QVERIFY(finishedSpy.wait(5000));
+    model->setSkipBinaryFiles(true);
+    QDir dir(originalModelRootPath);
+
+    // ACT & ASSERT: select all leaves the binary out
+    model->setAllCheckStates(Qt::Checked);
+    QStringList paths = model->getCheckedFilesPaths();
+    QCOMPARE(paths.count(), 4);
+    QVERIFY(!paths.contains(dir.filePath("mixed/object.o")));
+    QModelIndex mixed = findItem("mixed");
+    QCOMPARE(model->data(mixed, Qt::CheckStateRole).toInt(), static_cast<int>(Qt::PartiallyChecked));
+
+    // Checking the folder itself does not pull the binary in either
+    model->setAllCheckStates(Qt::Unchecked);
+    QVERIFY(model->setData(mixed, Qt::Checked, Qt::CheckStateRole));
+    QCOMPARE(model->getCheckedFilesPaths(), QStringList{dir.filePath("mixed/code.cpp")});
+    QCOMPARE(model->data(mixed, Qt::CheckStateRole).toInt(), static_cast<int>(Qt::PartiallyChecked));
+
+    // An explicit click on the binary still checks it
+    QModelIndex object = findItem("object.o", mixed);
+    QVERIFY(model->setData(object, Qt::Checked, Qt::CheckStateRole));
+    QCOMPARE(model->data(mixed, Qt::CheckStateRole).toInt(), static_cast<int>(Qt::Checked));
+
+    // Without skipping, select all includes it again
+    model->setSkipBinaryFiles(false);
+    model->setAllCheckStates(Qt::Unchecked);
+    model->setAllCheckStates(Qt::Checked);
+    QCOMPARE(model->getCheckedFilesPaths().count(), 5);
+}
+
+// ---- Name Filter Tests ----
+void TestCustomFileModel::testNameFilter_ShowsMatchesAndAncestors()
+{
+    // ARRANGE
+    createExtensionTestDirectory(originalModelRootPath);
+    delete model; model = new CustomFileModel(originalModelRootPath);
+    QVERIFY(!model->isFiltered());
+
+    // ACT: trigram path ("doc" is 3 characters), case-insensitive
+    model->setNameFilter("DOC");
+
+    // ASSERT: doc.log at root, subfolder2/old_doc.log with its ancestor
+    QVERIFY(model->isFiltered());
+    QCOMPARE(model->filterMatchCount(), 2);
+    QCOMPARE(model->rowCount(QModelIndex()), 2);
+    QModelIndex subfolder2 = findItem("subfolder2");
+    QVERIFY(subfolder2.isValid());
+    QVERIFY(findItem("doc.log").isValid());
+    QVERIFY(!findItem("file.txt").isValid());
+    QCOMPARE(model->rowCount(subfolder2), 1);
+    QModelIndex oldDoc = model->index(0, 0, subfolder2);
+    QCOMPARE(model->data(oldDoc, Qt::DisplayRole).toString(), QString("old_doc.log"));
+    QCOMPARE(model->parent(oldDoc), subfolder2);
+
+    // Narrowing and short (non-trigram) queries
+    model->setNameFilter("old_d");
+    QCOMPARE(model->filterMatchCount(), 1);
+    model->setNameFilter("sh");
+    QCOMPARE(model->filterMatchCount(), 1); // script.sh
+    model->setNameFilter("no such name");
+    QCOMPARE(model->rowCount(QModelIndex()), 0);
+
+    // Clearing restores the full tree
+    model->setNameFilter("");
+    QVERIFY(!model->isFiltered());
+    QCOMPARE(model->rowCount(QModelIndex()), 7); // 2 folders + 5 root files
+}
+
+void TestCustomFileModel::testNameFilter_CheckOperationsApplyToFilteredSet()
+{
+    // ARRANGE
+    createExtensionTestDirectory(originalModelRootPath);
+    delete model; model = new CustomFileModel(originalModelRootPath);
+    QDir dir(originalModelRootPath);
+    model->setNameFilter(".log");
+
+    // ACT & ASSERT: select all only checks the visible files
+    model->setAllCheckStates(Qt::Checked);
+    QStringList paths = model->getCheckedFilesPaths();
+    QCOMPARE(paths.count(), 3);
+    QVERIFY(paths.contains(dir.filePath("doc.log")));
+    QVERIFY(paths.contains(dir.filePath("subfolder1/config.LOG")));
+    QVERIFY(paths.contains(dir.filePath("subfolder2/old_doc.log")));
+
+    // Folders reflect all of their children, including hidden ones
+    QModelIndex subfolder1 = findItem("subfolder1");
+    QCOMPARE(model->data(subfolder1, Qt::CheckStateRole).toInt(), static_cast<int>(Qt::PartiallyChecked));
+
+    // Unchecking a folder only unchecks its visible children
+    model->setAllCheckStates(Qt::Unchecked);
+    model->setNameFilter("");
+    model->setAllCheckStates(Qt::Checked);
+    model->setNameFilter("another");
+    subfolder1 = findItem("subfolder1");
+    QVERIFY(model->setData(subfolder1, Qt::Unchecked, Qt::CheckStateRole));
+    model->setNameFilter("");
+    paths = model->getCheckedFilesPaths();
+    QCOMPARE(paths.count(), 9);
+    QVERIFY(!paths.contains(dir.filePath("subfolder1/another.txt")));
+    QCOMPARE(model->data(findItem("subfolder1"), Qt::CheckStateRole).toInt(), static_cast<int>(Qt::PartiallyChecked));
+}
+
+// ---- Selection Profile Tests ----
+void TestCustomFileModel::testSelectionProfile_SerializeRoundTrip()
+{
+    SelectionProfile profile;
+    profile.relativePaths << "src/b.cpp" << "src/a.cpp" << QString::fromUtf8("doc/\xc3\xbcbersicht.md") << "README";
+    profile.patterns << "*.h";
+
+    QByteArray data = SelectionProfiles::serialize(profile);
+    SelectionProfile restored;
+    QVERIFY(SelectionProfiles::deserialize(data, restored));
+
+    QStringList expected = profile.relativePaths;
+    std::sort(expected.begin(), expected.end(), [](const QString &a, const QString &b) { return a.toUtf8() < b.toUtf8(); });
+    QCOMPARE(restored.relativePaths, expected);
+    QCOMPARE(restored.patterns, profile.patterns);
+
+    QVERIFY(!SelectionProfiles::deserialize(QByteArray("garbage"), restored));
+}
+
+void TestCustomFileModel::testApplySelection_ReplacesSelection()
+{
+    // ARRANGE
+    createExtensionTestDirectory(originalModelRootPath);
+    delete model; model = new CustomFileModel(originalModelRootPath);
+    QDir dir(originalModelRootPath);
+    model->selectFilesByExtensionRecursive(QModelIndex(), ".txt");
+    QStringList saved = model->checkedRelativePaths();
+    QCOMPARE(saved.count(), 4);
+    QVERIFY(saved.contains("subfolder1/another.txt"));
+
+    // ACT: a different selection, then reapply the saved one plus a pattern and a stale path
+    model->setAllCheckStates(Qt::Unchecked);
+    model->selectFilesByExtensionRecursive(QModelIndex(), ".log");
+    int missing = -1;
+    int selected = model->applySelection(saved + QStringList{"gone/away.txt"}, {"*.sh"}, &missing);
+
+    // ASSERT: exactly the saved files plus the pattern match; .log files were unchecked
+    QCOMPARE(selected, 5);
+    QCOMPARE(missing, 1);
+    QStringList paths = model->getCheckedFilesPaths();
+    QCOMPARE(paths.count(), 5);
+    QVERIFY(paths.contains(dir.filePath("subfolder1/script.sh")));
+    QVERIFY(!paths.contains(dir.filePath("doc.log")));
+    QCOMPARE(model->data(findItem("subfolder2"), Qt::CheckStateRole).toInt(), static_cast<int>(Qt::PartiallyChecked));
+}
+
+
+// ---- Selection Snapshot Tests ----
+void TestCustomFileModel::testSelectionSnapshot_MatchesCheckedFilesAndStaysFixed()
+{
+    // ARRANGE: one file gets a different size so the sizes can be told apart
+    createExtensionTestDirectory(originalModelRootPath);
+    QFile longer(originalModelRootPath + "/subfolder1/another.txt");
+    QVERIFY(longer.open(QIODevice::WriteOnly));
+    longer.write("a longer text");
+    longer.close();
+    delete model; model = new CustomFileModel(originalModelRootPath);
+    QVERIFY(model->selectionSnapshot().isEmpty());
+    QList<qint64> snapshotSizes;
+    QList<qint64> modelSizes;
+
+    // ACT + ASSERT: after each kind of change the snapshot lists the same
+    // files and sizes, in the same order, as the tree walk
+    QVERIFY(model->setData(findItem("file.txt"), Qt::Checked, Qt::CheckStateRole));
+    const SelectionSnapshot single = model->selectionSnapshot();
+    const QStringList singlePaths = single.paths(&snapshotSizes);
+    QCOMPARE(singlePaths, model->getCheckedFilesPaths(&modelSizes));
+    QCOMPARE(snapshotSizes, modelSizes);
+    QCOMPARE(single.count(), 1);
+
+    model->setAllCheckStates(Qt::Checked);
+    const SelectionSnapshot all = model->selectionSnapshot();
+    snapshotSizes.clear();
+    modelSizes.clear();
+    const QStringList allPaths = all.paths(&snapshotSizes);
+    QCOMPARE(allPaths, model->getCheckedFilesPaths(&modelSizes));
+    QCOMPARE(snapshotSizes, modelSizes);
+    QCOMPARE(all.count(), 10);
+    QVERIFY(snapshotSizes.contains(13));
+
+    QCOMPARE(model->applySelection({"subfolder1/another.txt", "doc.log"}), 2);
+    const SelectionSnapshot applied = model->selectionSnapshot();
+    snapshotSizes.clear();
+    modelSizes.clear();
+    QCOMPARE(applied.paths(&snapshotSizes), model->getCheckedFilesPaths(&modelSizes));
+    QCOMPARE(snapshotSizes, modelSizes);
+    QCOMPARE(applied.count(), 2);
+
+    // ASSERT: snapshots taken earlier still hold their own selection
+    model->setAllCheckStates(Qt::Unchecked);
+    QCOMPARE(single.paths(), singlePaths);
+    QCOMPARE(all.paths(), allPaths);
+    QCOMPARE(all.count(), 10);
+    QCOMPARE(applied.count(), 2);
+    QVERIFY(model->selectionSnapshot().isEmpty());
+}
+
+// ---- Selection Estimate Tests ----
+void TestCustomFileModel::testSelectionTotals_TrackChecksAndTextStatistics()
+{
+    // ARRANGE
+    createClassificationTestDirectory(originalModelRootPath);
+    TextStats::clearCache();
+    delete model; model = new CustomFileModel(originalModelRootPath);
+    QCOMPARE(model->selectionTotals().fileCount, 0);
+
+    // ACT: sizes are summed as files are checked, before anything is read
+    model->setAllCheckStates(Qt::Checked);
+    SelectionTotals totals = model->selectionTotals();
+    QCOMPARE(totals.fileCount, 5);
+    QCOMPARE(totals.bytes, qint64(11 + 12 + 10 + 14 + 10));
+    QCOMPARE(totals.countedFiles, 0);
+
+    QSignalSpy finishedSpy(model, &CustomFileModel::textStatisticsFinished);
+    QVERIFY(model->startTextStatistics());
+    QVERIFY(finishedSpy.wait(5000));
+
+    // ASSERT: one line each; tokens are max(words, ceil(non-whitespace bytes / 4))
+    totals = model->selectionTotals();
+    QCOMPARE(totals.countedFiles, 5);
+    QCOMPARE(totals.lines, qint64(5));
+    QCOMPARE(totals.tokens, qint64(3 + 3 + 2 + 3 + 3));
+    QVERIFY(!model->startTextStatistics()); // Nothing left to count
+
+    // Unchecking subtracts the counted file again
+    QVERIFY(model->setData(findItem("readme.txt"), Qt::Unchecked, Qt::CheckStateRole));
+    totals = model->selectionTotals();
+    QCOMPARE(totals.fileCount, 4);
+    QCOMPARE(totals.bytes, qint64(12 + 10 + 14 + 10));
+    QCOMPARE(totals.lines, qint64(4));
+    QCOMPARE(totals.tokens, qint64(3 + 2 + 3 + 3));
+    model->setAllCheckStates(Qt::Unchecked);
+    QCOMPARE(model->selectionTotals().fileCount, 0);
+    QCOMPARE(model->selectionTotals().tokens, qint64(0));
+}
+
+void TestCustomFileModel::testTextCounter_VectorizedMatchesScalar()
+{
+    // Random mixes of whitespace and text, fed in random pieces so word and
+    // line state has to carry across every SIMD block and call boundary.
+    const char alphabet[] = "ab \n\t\r\v\fxyz\x80\xff  \n";
+    QRandomGenerator rng(4711);
+    for (int round = 0; round < 2000; ++round) {
+        QByteArray data(rng.bounded(600), Qt::Uninitialized);
+        for (char &c : data)
+            c = alphabet[rng.bounded(int(sizeof(alphabet) - 1))];
+        const TextCounts expected = TextCounter::countScalar(data.constData(), data.size());
+
+        TextCounter counter;
+        for (qsizetype pos = 0; pos < data.size();) {
+            const qsizetype piece = qMin<qsizetype>(rng.bounded(1, 130), data.size() - pos);
+            counter.add(data.constData() + pos, piece);
+            pos += piece;
+        }
+        const TextCounts actual = counter.counts();
+        QCOMPARE(actual.bytes, expected.bytes);
+        QCOMPARE(actual.lines, expected.lines);
+        QCOMPARE(actual.words, expected.words);
+        QCOMPARE(actual.nonWhitespace, expected.nonWhitespace);
+    }
+}
 
 // QTEST_APPLESS_MAIN(TestCustomFileModel) // Can be used if no GUI, no event loop needed for tests
 QTEST_MAIN(TestCustomFileModel) // Or QTEST_GUILESS_MAIN if some Qt features need an event loop but no GUI